@@ -7,6 +7,7 @@
  */
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +25,32 @@ typedef uint64_t helix_timestamp_t;
  */
 typedef uint64_t helix_price_t;
 
+/*!
+ * @typedef  helix_price_level_t
+ * @abstract Aggregate price and size of a price level.
+ */
+typedef struct {
+    helix_price_t price;
+    uint64_t      size;
+} helix_price_level_t;
+
+/*!
+ * @typedef  helix_latency_t
+ * @abstract Summary of a latency histogram in nanoseconds.
+ */
+typedef struct {
+    /*! Number of samples. */
+    uint64_t count;
+    /*! Median. */
+    uint64_t p50;
+    /*! 99th percentile. */
+    uint64_t p99;
+    /*! 99.9th percentile. */
+    uint64_t p999;
+    /*! Maximum. */
+    uint64_t max;
+} helix_latency_t;
+
 /*!
  * @typedef  helix_protocol_t
  * @abstract Type of a protocol descriptor.
@@ -66,6 +93,166 @@ typedef struct helix_opaque_order_book *helix_order_book_t;
  */
 typedef struct helix_opaque_trade *helix_trade_t;
 
+/*!
+ * @typedef  helix_udp_receiver_t
+ * @abstract Type of a UDP multicast receiver.
+ */
+typedef struct helix_opaque_udp_receiver *helix_udp_receiver_t;
+
+/*!
+ * @typedef  helix_snapshot_t
+ * @abstract Type of a snapshot of session state.
+ */
+typedef struct helix_opaque_snapshot *helix_snapshot_t;
+
+/*!
+ * @typedef  helix_index_t
+ * @abstract Type of an ITCH 5.0 BinaryFILE index.
+ */
+typedef struct helix_opaque_index *helix_index_t;
+
+/*!
+ * @typedef  helix_aggregator_t
+ * @abstract Type of a multi-venue order book aggregator.
+ */
+typedef struct helix_opaque_aggregator *helix_aggregator_t;
+
+/*!
+ * @typedef  helix_consolidated_book_t
+ * @abstract Type of a consolidated order book of an instrument across venues.
+ */
+typedef struct helix_opaque_consolidated_book *helix_consolidated_book_t;
+
+/*!
+ * @typedef  helix_published_book_t
+ * @abstract Type of the published top price levels of an order book.
+ */
+typedef struct helix_opaque_published_book *helix_published_book_t;
+
+/*!
+ * @typedef  helix_bus_t
+ * @abstract Type of a shared memory market data bus publisher.
+ */
+typedef struct helix_opaque_bus *helix_bus_t;
+
+/*!
+ * @typedef  helix_bus_reader_t
+ * @abstract Type of a consumer attached to a shared memory market data bus.
+ */
+typedef struct helix_opaque_bus_reader *helix_bus_reader_t;
+
+/*!
+ * @typedef  helix_moldudp_sender_t
+ * @abstract Type of a MoldUDP multicast sender.
+ */
+typedef struct helix_opaque_moldudp_sender *helix_moldudp_sender_t;
+
+/*!
+ * @enum     helix_feed_line_t
+ * @abstract Redundant feed line of a sequenced transport protocol.
+ */
+typedef enum {
+    /*! Primary feed line. */
+    HELIX_FEED_LINE_A,
+    /*! Secondary feed line. */
+    HELIX_FEED_LINE_B,
+} helix_feed_line_t;
+
+/*!
+ * @typedef  helix_udp_config_t
+ * @abstract Configuration of a UDP multicast receiver.
+ */
+typedef struct {
+    /*! Multicast group to join. */
+    const char *multicast_addr;
+    /*! Local interface address to join the group on, or NULL. */
+    const char *interface_addr;
+    /*! UDP port to bind to. */
+    uint16_t    port;
+    /*! Maximum number of datagrams per receive call, or zero for the default. */
+    size_t      batch_size;
+    /*! Socket receive buffer size in bytes, or zero for the system default. */
+    int         rcvbuf_size;
+    /*! SO_BUSY_POLL timeout in microseconds, or zero to disable busy polling. */
+    int         busy_poll_usec;
+    /*! Non-zero to record kernel receive timestamps. */
+    int         timestamps;
+    /*! Feed line that the multicast group carries. */
+    helix_feed_line_t line;
+} helix_udp_config_t;
+
+/*!
+ * @typedef  helix_moldudp_sender_config_t
+ * @abstract Configuration of a MoldUDP multicast sender.
+ */
+typedef struct {
+    /*! Multicast group to send to. */
+    const char *multicast_addr;
+    /*! Local interface address to send from, or NULL. */
+    const char *interface_addr;
+    /*! UDP port to send to. */
+    uint16_t    port;
+    /*! Time-to-live of multicast datagrams, or zero for the default of one. */
+    int         ttl;
+    /*! Non-zero to deliver datagrams to receivers on the local host too. */
+    int         loopback;
+    /*! MoldUDP session name of at most ten characters, or NULL. */
+    const char *session;
+    /*! Maximum datagram size in bytes, or zero for the default. */
+    size_t      max_packet_size;
+} helix_moldudp_sender_config_t;
+
+/*!
+ * @typedef  helix_replay_stats_t
+ * @abstract Pacing statistics of a paced file replay.
+ *
+ * Lag is the time in nanoseconds by which a packet was processed after it
+ * was due at the replay speed.
+ */
+typedef struct {
+    /*! Number of packets that were processed after they were due. */
+    uint64_t late;
+    /*! Median lag. */
+    uint64_t lag_p50;
+    /*! 99th percentile lag. */
+    uint64_t lag_p99;
+    /*! Maximum lag. */
+    uint64_t lag_max;
+} helix_replay_stats_t;
+
+/*!
+ * @enum     helix_level_storage_t
+ * @abstract Price level storage of an order book.
+ */
+typedef enum {
+    /*! Price levels are kept in an ordered tree. */
+    HELIX_LEVEL_STORAGE_TREE,
+    /*! Price levels near the best price are kept in a tick-indexed ladder. */
+    HELIX_LEVEL_STORAGE_LADDER,
+} helix_level_storage_t;
+
+/*!
+ * @typedef  helix_level_config_t
+ * @abstract Price level configuration of a subscription.
+ *
+ * A zeroed configuration is the default one: price levels in an ordered
+ * tree, every update reported, nothing published and no order queues.
+ */
+typedef struct {
+    /*! Price level storage. */
+    helix_level_storage_t storage;
+    /*! Price increment between ladder levels, or zero for the default of one cent. */
+    helix_price_t         tick_size;
+    /*! Number of ladder levels per side, or zero for the default. */
+    size_t                window;
+    /*! Number of top price levels per side whose changes are reported, or zero for all. */
+    size_t                depth;
+    /*! Number of top price levels per side to publish for reader threads, or zero. */
+    size_t                published_depth;
+    /*! Non-zero to keep order queues and deliver order events. */
+    int                   order_queues;
+} helix_level_config_t;
+
 /*!
  * @typedef  helix_order_book_callback_t
  * @abstract Type of an order book update callback.
@@ -78,6 +265,106 @@ typedef void (*helix_order_book_callback_t)(helix_session_t, helix_order_book_t)
  */
 typedef void (*helix_trade_callback_t)(helix_session_t, helix_trade_t);
 
+/*!
+ * @enum     helix_side_t
+ * @abstract Side of an order.
+ */
+typedef enum {
+    HELIX_SIDE_BUY = 1,
+    HELIX_SIDE_SELL = 2,
+} helix_side_t;
+
+/*!
+ * @enum     helix_order_event_type_t
+ * @abstract Type of an order event.
+ */
+typedef enum {
+    /*! Order was added to the order book. */
+    HELIX_ORDER_EVENT_ADD,
+    /*! Quantity of an order was reduced. The order keeps its queue position. */
+    HELIX_ORDER_EVENT_MODIFY,
+    /*! Order was removed from the order book. */
+    HELIX_ORDER_EVENT_REMOVE,
+} helix_order_event_type_t;
+
+/*!
+ * @typedef  helix_order_event_t
+ * @abstract Order event of an order book that keeps order queues.
+ *
+ * A replaced order loses its queue position, so replacement is reported as
+ * the removal of the old order followed by the addition of the new one.
+ */
+typedef struct {
+    helix_order_event_type_t type;
+    helix_order_book_t       order_book;
+    helix_timestamp_t        timestamp;
+    uint64_t                 order_id;
+    helix_side_t             side;
+    helix_price_t            price;
+    /*! Quantity of the order after the event, zero if it was removed. */
+    uint64_t                 quantity;
+    /*! Quantity of the order before the event, zero if it was added. */
+    uint64_t                 previous_quantity;
+} helix_order_event_t;
+
+/*!
+ * @typedef  helix_order_callback_t
+ * @abstract Type of an order event callback.
+ */
+typedef void (*helix_order_callback_t)(helix_session_t, const helix_order_event_t *);
+
+/*!
+ * @typedef  helix_queue_position_t
+ * @abstract Queue position of an order at its price level.
+ */
+typedef struct {
+    /*! Number of orders ahead of the order. */
+    uint64_t orders;
+    /*! Quantity of the orders ahead of the order. */
+    uint64_t quantity;
+} helix_queue_position_t;
+
+/*!
+ * @typedef  helix_retransmit_callback_t
+ * @abstract Type of a retransmission request callback.
+ *
+ * The callback is invoked with the sequence number of the first missing
+ * message and the number of missing messages.
+ */
+typedef void (*helix_retransmit_callback_t)(helix_session_t, uint64_t seq_num, uint64_t count);
+
+/*!
+ * @enum     helix_error_t
+ * @abstract Reason why a message was dropped.
+ */
+typedef enum {
+    /*! Message refers to an order that is not in the order book. */
+    HELIX_ERROR_UNKNOWN_ORDER = 1,
+    /*! Message adds an order whose ID is already in use. */
+    HELIX_ERROR_DUPLICATE_ORDER,
+    /*! Message has an invalid buy/sell indicator. */
+    HELIX_ERROR_INVALID_SIDE,
+    /*! Message has an invalid trading state. */
+    HELIX_ERROR_INVALID_TRADING_STATE,
+    /*! Message adds an order whose price does not fit in an order book. */
+    HELIX_ERROR_INVALID_PRICE,
+    /*! Message executes or cancels more than the quantity of an order. */
+    HELIX_ERROR_INVALID_QUANTITY,
+    /*! Messages were skipped because a sequence gap could not be filled. */
+    HELIX_ERROR_MESSAGES_LOST,
+} helix_error_t;
+
+/*!
+ * @typedef  helix_error_callback_t
+ * @abstract Type of a dropped message callback.
+ *
+ * The callback is invoked with the reason why the message was dropped and
+ * the offending value, which is an order ID for order errors and the
+ * invalid indicator for the other errors. For lost messages, the value is
+ * the number of messages that were skipped.
+ */
+typedef void (*helix_error_callback_t)(helix_session_t, helix_error_t error, uint64_t value);
+
 /*!
  * @enum     helix_trading_state_t
  * @abstract Order book instrument trading state.
@@ -143,6 +430,11 @@ size_t helix_order_book_ask_levels(helix_order_book_t);
  */
 size_t helix_order_book_order_count(helix_order_book_t);
 
+/*!
+ * @abstract Returns the number of bytes of memory that the book uses.
+ */
+size_t helix_order_book_memory_usage(helix_order_book_t);
+
 /*!
  * @abstract Returns the order book bid price for a price level.
  */
@@ -168,6 +460,51 @@ uint64_t helix_order_book_ask_size(helix_order_book_t, size_t);
  */
 helix_price_t helix_order_book_midprice(helix_order_book_t, size_t);
 
+/*!
+ * @abstract Copies top price levels of the order book.
+ *
+ * Fills the bids and asks arrays, each of which has room for depth entries,
+ * with the best price levels in one pass. Missing levels have zero size.
+ */
+void helix_order_book_depth(helix_order_book_t, helix_price_level_t *bids, helix_price_level_t *asks, size_t depth);
+
+/*!
+ * @abstract Returns the published top price levels of the order book.
+ *
+ * Returns NULL if the symbol was not subscribed to with
+ * helix_session_subscribe_published(). The published book lives as long as
+ * the session and, unlike the order book, can be read from any thread.
+ * Applications typically look it up in the first order book callback of a
+ * symbol and hand it over to reader threads.
+ */
+helix_published_book_t helix_order_book_published(helix_order_book_t);
+
+/*!
+ * @abstract Returns the number of price levels per side of a published book.
+ */
+size_t helix_published_book_depth(helix_published_book_t);
+
+/*!
+ * @abstract Returns the version of a published book.
+ *
+ * The version is incremented every time the session publishes the book, so
+ * a reader that polls only needs to call helix_published_book_read() when
+ * it has changed.
+ */
+uint64_t helix_published_book_version(helix_published_book_t);
+
+/*!
+ * @abstract Reads a consistent snapshot of a published book without locks.
+ *
+ * Fills in the timestamp and trading state of the order book and the bids
+ * and asks arrays, each of which has room for depth entries, with the best
+ * price levels like helix_order_book_depth() does. Levels beyond the depth
+ * of the published book are filled in as missing. Returns the version of
+ * the snapshot, which is zero if the book has not been published yet.
+ */
+uint64_t helix_published_book_read(helix_published_book_t, helix_timestamp_t *timestamp, helix_trading_state_t *state,
+                                   helix_price_level_t *bids, helix_price_level_t *asks, size_t depth);
+
 /*!
  * @abstract Returns the trade symbol.
  */
@@ -203,6 +540,17 @@ helix_protocol_t helix_protocol_lookup(const char *name);
  */
 helix_session_t helix_session_create(helix_protocol_t, helix_order_book_callback_t, helix_trade_callback_t, void *data);
 
+/*!
+ * @abstract Create a new session that replays a file on several threads.
+ *
+ * Messages are distributed to shards worker threads by instrument, so that
+ * updates of one order book are processed in order by a single thread.
+ * helix_session_process_packet() processes the whole buffer it is passed
+ * and the callbacks are invoked concurrently from the worker threads.
+ * Returns NULL if the protocol does not support sharded replay.
+ */
+helix_session_t helix_session_create_sharded(helix_protocol_t, size_t shards, helix_order_book_callback_t, helix_trade_callback_t, void *data);
+
 /*!
  * @abstract Returns session opaque context data.
  */
@@ -215,11 +563,589 @@ void *helix_session_data(helix_session_t);
  */
 size_t helix_session_process_packet(helix_session_t, const char* buf, size_t len);
 
+/*!
+ * @abstract Process a packet received on one of redundant feed lines.
+ *
+ * MoldUDP sessions arbitrate between the A and B lines: the first copy of
+ * a message is processed and the other one is dropped, and a gap on one
+ * line is only reported to the retransmit callback if the other line does
+ * not fill it. Other sessions ignore the line.
+ */
+size_t helix_session_process_line_packet(helix_session_t, helix_feed_line_t, const char* buf, size_t len);
+
+/*!
+ * @abstract Process a batch of packets for a session.
+ *
+ * Processes count packets in order, as if each of them was passed to
+ * helix_session_process_packet(). The packets are described by the same
+ * struct iovec array that is passed to recvmmsg() in the msg_iov fields of
+ * struct mmsghdr. When conflation is enabled, order book updates may be
+ * conflated across packets of the batch. Returns the total number of bytes
+ * processed.
+ */
+size_t helix_session_process_packets(helix_session_t, const struct iovec *packets, size_t count);
+
+/*!
+ * @abstract Replay a file in a session.
+ *
+ * The file is read and, if it is gzip or zstd compressed, decompressed on a
+ * background thread while the session processes it, so the file does not
+ * need to be decompressed to disk first. Returns the number of uncompressed
+ * bytes that were processed or -1 and sets errno on failure.
+ */
+int64_t helix_session_replay_file(helix_session_t, const char *path);
+
+/*!
+ * @abstract Replay a file in a session at a controlled speed.
+ *
+ * Works like helix_session_replay_file(), but processes every packet when it
+ * is due according to the timestamps of the feed, at speed times the
+ * recorded rate, by busy-waiting on the time stamp counter. A speed of zero
+ * replays as fast as possible. Gaps in feed time that are longer than
+ * max_gap nanoseconds are shortened to max_gap, unless it is zero. If stats
+ * is not NULL, the pacing statistics are stored in it. Returns the number of
+ * uncompressed bytes that were processed or -1 and sets errno on failure.
+ */
+int64_t helix_session_replay_file_paced(helix_session_t, const char *path, double speed, uint64_t max_gap,
+                                        helix_replay_stats_t *stats);
+
+/*!
+ * @abstract Re-emit the messages that a session processes as MoldUDP packets.
+ *
+ * Every message is sent with the packetization of the input: one packet per
+ * record of a replayed file, or per packet of a MoldUDP feed. The sender must
+ * outlive the session or be detached by passing NULL. Returns zero on
+ * success or -1 with errno set to EOPNOTSUPP if the session does not support
+ * re-emitting.
+ */
+int helix_session_set_mirror(helix_session_t, helix_moldudp_sender_t);
+
 /*!
  * @abstract Subscribe to listening to market data updates for a symbol.
  */
 void helix_session_subscribe(helix_session_t, const char *symbol, size_t max_orders);
 
+/*!
+ * @abstract Subscribe to market data updates for a symbol with a price level
+ * configuration.
+ *
+ * The options of levels can be combined freely. A NULL levels is the
+ * default configuration. Subscribing to a symbol that is already subscribed
+ * has no effect, so every option of a symbol must be passed in one call.
+ */
+void helix_session_subscribe_ex(helix_session_t, const char *symbol, size_t max_orders,
+                                const helix_level_config_t *levels);
+
+/*!
+ * @abstract Subscribe to market data updates for the top price levels of a symbol.
+ *
+ * The order book callback is only invoked for updates that change one of
+ * the top depth price levels on either side. A depth of zero reports every
+ * update like helix_session_subscribe() does. Same as
+ * helix_session_subscribe_ex() with only the depth option set.
+ */
+void helix_session_subscribe_depth(helix_session_t, const char *symbol, size_t max_orders, size_t depth);
+
+/*!
+ * @abstract Subscribe to market data updates for a symbol and publish its
+ * top price levels for reader threads.
+ *
+ * The top depth price levels of each side are published after every update
+ * and can be read with helix_published_book_read() from any thread. Same as
+ * helix_session_subscribe_ex() with only the published_depth option set.
+ */
+void helix_session_subscribe_published(helix_session_t, const char *symbol, size_t max_orders, size_t depth);
+
+/*!
+ * @abstract Subscribe to order-level market data updates for a symbol.
+ *
+ * The order book keeps the orders of every price level in time priority
+ * and every order that is added, modified or removed is passed to the
+ * order callback of the session, in addition to the order book updates.
+ * Same as helix_session_subscribe_ex() with only the order_queues option
+ * set.
+ */
+void helix_session_subscribe_orders(helix_session_t, const char *symbol, size_t max_orders);
+
+/*!
+ * @abstract Subscribe to market data updates for every symbol of the feed.
+ *
+ * The order books of symbols that are not also subscribed individually
+ * share one pool of orders that is allocated once for max_orders resting
+ * orders across the whole feed.
+ */
+void helix_session_subscribe_all(helix_session_t, size_t max_orders);
+
+/*!
+ * @abstract Subscribe to every symbol of the feed with a price level
+ * configuration.
+ *
+ * Works like helix_session_subscribe_all(), and the order books of symbols
+ * that are not also subscribed individually use levels, or the default
+ * configuration if it is NULL.
+ */
+void helix_session_subscribe_all_ex(helix_session_t, size_t max_orders, const helix_level_config_t *levels);
+
+/*!
+ * @abstract Returns the number of bytes of memory that the order books of
+ * the session use.
+ */
+size_t helix_session_memory_usage(helix_session_t);
+
+/*!
+ * @abstract Set callback for order events of order books that were
+ * subscribed with helix_session_subscribe_orders().
+ *
+ * Order events are delivered before the order book update and the trade,
+ * if any, of the same message and are never conflated.
+ */
+void helix_session_set_order_callback(helix_session_t, helix_order_callback_t);
+
+/*!
+ * @abstract Look up the queue position of a resting order.
+ *
+ * Returns zero and fills in pos on success. Returns -1 and sets errno to
+ * ENOENT if the order is not in a subscribed order book, or to EOPNOTSUPP
+ * if its order book does not keep order queues.
+ */
+int helix_session_queue_position(helix_session_t, uint64_t order_id, helix_queue_position_t *pos);
+
+/*!
+ * @abstract Enable or disable conflation of order book updates.
+ *
+ * When conflation is enabled, an order book that changes several times
+ * within a packet or within a timestamp is passed to the order book
+ * callback only once, after its last change. Trades are not conflated.
+ */
+void helix_session_set_conflation(helix_session_t, int enabled);
+
+/*!
+ * @abstract Set a callback for requesting retransmission of missing messages.
+ *
+ * Sessions of sequenced transport protocols such as MoldUDP buffer packets
+ * that arrive after a gap and invoke the callback for the missing messages.
+ * Retransmitted packets are passed to helix_session_process_packet() and
+ * processing resumes once the gap is filled. The callback is invoked again
+ * for messages that are still missing after some more packets, and a gap
+ * that is not filled before the reorder buffer fills up is skipped and
+ * reported to the error callback as HELIX_ERROR_MESSAGES_LOST.
+ */
+void helix_session_set_retransmit_callback(helix_session_t, helix_retransmit_callback_t);
+
+/*!
+ * @abstract Set callback for dropped messages.
+ *
+ * Messages that cannot be applied to the order books, for example an
+ * execution of an order that was never added, are dropped and counted.
+ * Processing continues with the next message.
+ */
+void helix_session_set_error_callback(helix_session_t, helix_error_callback_t);
+
+/*!
+ * @abstract Returns the number of messages a session dropped with an error.
+ */
+uint64_t helix_session_error_count(helix_session_t, helix_error_t error);
+
+/*!
+ * @abstract Returns the timestamp of the last message processed by a session.
+ *
+ * The timestamp is in the time unit of the protocol: nanoseconds since
+ * midnight for ITCH 5.0 and milliseconds since midnight for Nordic ITCH.
+ */
+helix_timestamp_t helix_session_clock(helix_session_t);
+
+/*!
+ * @abstract Returns the processing time of a message type.
+ *
+ * Fills in the distribution of the time it took the feed handler to
+ * process messages of ITCH message type "message_type", including the
+ * callbacks invoked for them. Percentiles are accurate to about 3%.
+ * Returns zero on success, or -1 with errno set to EOPNOTSUPP if the
+ * library is not built with HELIX_LATENCY or the session is not
+ * instrumented and ENOENT if no message of the type has been processed.
+ */
+int helix_session_latency(helix_session_t, char message_type, helix_latency_t *latency);
+
+/*!
+ * @abstract Returns the wire-to-callback latency of a session.
+ *
+ * Fills in the distribution of the time from the kernel receive timestamp
+ * of a datagram to the order book and trade callbacks invoked for it. Only
+ * datagrams received by a UDP receiver with timestamps enabled are
+ * measured. Returns zero on success, or -1 with errno set like
+ * helix_session_latency() does.
+ */
+int helix_session_wire_latency(helix_session_t, helix_latency_t *latency);
+
+/*!
+ * @abstract Capture a snapshot of session state.
+ *
+ * The snapshot contains all order books with their resting orders and the
+ * sequence number of the next message to process. It must be captured on
+ * the thread that processes packets, but can be written on any thread.
+ * Returns NULL and sets errno on failure.
+ */
+helix_snapshot_t helix_session_snapshot(helix_session_t);
+
+/*!
+ * @abstract Write a snapshot to a file.
+ *
+ * The file is replaced atomically. Returns zero on success, or -1 with
+ * errno set on failure.
+ */
+int helix_snapshot_write(helix_snapshot_t, const char *path);
+
+/*!
+ * @abstract Returns the sequence number of the next message to process
+ * after a snapshot, or zero if the protocol is not sequenced.
+ */
+uint64_t helix_snapshot_seq_num(helix_snapshot_t);
+
+/*!
+ * @abstract Free a snapshot.
+ */
+void helix_snapshot_free(helix_snapshot_t);
+
+/*!
+ * @abstract Restore session state from a snapshot file.
+ *
+ * The session must have been subscribed to but must not have processed any
+ * packets. Processing continues from the sequence number of the snapshot.
+ * Returns zero on success, or -1 with errno set on failure.
+ */
+int helix_session_restore(helix_session_t, const char *path);
+
+/*!
+ * @abstract Build an index of an ITCH 5.0 BinaryFILE.
+ *
+ * The index has time checkpoints every interval nanoseconds, or every
+ * second if interval is zero, and the offsets of the records of every
+ * symbol. Returns zero on success, or -1 with errno set on failure.
+ */
+int helix_index_build(const char *input, const char *output, helix_timestamp_t interval);
+
+/*!
+ * @abstract Open an index that was built with helix_index_build().
+ *
+ * Returns NULL and sets errno on failure.
+ */
+helix_index_t helix_index_open(const char *path);
+
+/*!
+ * @abstract Close an index.
+ */
+void helix_index_close(helix_index_t);
+
+/*!
+ * @abstract Returns the size of the file that an index was built from.
+ */
+uint64_t helix_index_file_size(helix_index_t);
+
+/*!
+ * @abstract Returns the offset of a record at or before the first record
+ * whose timestamp is at or after a timestamp.
+ */
+uint64_t helix_index_seek(helix_index_t, helix_timestamp_t);
+
+/*!
+ * @abstract Returns the offsets of the records of a symbol in file order.
+ *
+ * The offsets point to the length prefixes of BinaryFILE records, so a
+ * record can be passed to helix_session_process_packet() as is. Returns
+ * NULL if the symbol does not appear in the file.
+ */
+const uint64_t *helix_index_symbol_offsets(helix_index_t, const char *symbol, size_t *count);
+
+/*!
+ * @abstract Open a UDP multicast receiver.
+ *
+ * Returns NULL and sets errno on failure.
+ */
+helix_udp_receiver_t helix_udp_receiver_open(const helix_udp_config_t *config);
+
+/*!
+ * @abstract Close a UDP multicast receiver.
+ */
+void helix_udp_receiver_close(helix_udp_receiver_t);
+
+/*!
+ * @abstract Returns the socket file descriptor of a receiver.
+ *
+ * The socket is non-blocking and can be registered with an event loop.
+ */
+int helix_udp_receiver_fd(helix_udp_receiver_t);
+
+/*!
+ * @abstract Receive a batch of datagrams and process them in a session.
+ *
+ * Reads up to batch_size datagrams with a single system call and passes
+ * them to helix_session_process_packets(), or one at a time to
+ * helix_session_process_line_packet() if timestamps are enabled or the
+ * receiver is configured for the B line.
+ * If wait is non-zero,
+ * blocks until at least one datagram arrives. Returns the number of
+ * datagrams processed, or -1 with errno set on failure.
+ */
+int helix_udp_receiver_process(helix_udp_receiver_t, helix_session_t, int wait);
+
+/*!
+ * @abstract Returns the kernel receive timestamp of the current datagram.
+ *
+ * The timestamp is in nanoseconds since the epoch and is valid in callbacks
+ * invoked by helix_udp_receiver_process(). Returns zero if timestamps are
+ * not enabled.
+ */
+helix_timestamp_t helix_udp_receiver_timestamp(helix_udp_receiver_t);
+
+/*!
+ * @abstract Open a MoldUDP multicast sender.
+ *
+ * Returns NULL and sets errno on failure.
+ */
+helix_moldudp_sender_t helix_moldudp_sender_open(const helix_moldudp_sender_config_t *config);
+
+/*!
+ * @abstract Close a MoldUDP multicast sender.
+ */
+void helix_moldudp_sender_close(helix_moldudp_sender_t);
+
+/*!
+ * @abstract Send pending messages and an end of session packet.
+ *
+ * Returns zero on success or -1 with errno set on failure.
+ */
+int helix_moldudp_sender_end_session(helix_moldudp_sender_t);
+
+/*!
+ * @abstract Returns the number of packets that a sender has sent.
+ */
+uint64_t helix_moldudp_sender_packet_count(helix_moldudp_sender_t);
+
+/*!
+ * @abstract Callback that is invoked when the NBBO of an instrument changes.
+ */
+typedef void (*helix_nbbo_callback_t)(helix_aggregator_t, helix_consolidated_book_t);
+
+/*!
+ * @abstract Create an aggregator that consolidates depth price levels of
+ * order books across venues.
+ *
+ * Returns NULL and sets errno on failure.
+ */
+helix_aggregator_t helix_aggregator_create(size_t depth, helix_nbbo_callback_t, void *data);
+
+/*!
+ * @abstract Destroy an aggregator.
+ */
+void helix_aggregator_destroy(helix_aggregator_t);
+
+/*!
+ * @abstract Returns aggregator opaque context data.
+ */
+void *helix_aggregator_data(helix_aggregator_t);
+
+/*!
+ * @abstract Add a venue to an aggregator and return its number.
+ *
+ * A venue is usually a session whose order book callback passes the order
+ * book to helix_aggregator_update().
+ */
+size_t helix_aggregator_add_venue(helix_aggregator_t);
+
+/*!
+ * @abstract Consolidate the order book of a venue symbol into the book of
+ * an instrument.
+ *
+ * By default, order books are consolidated by symbol without trailing
+ * spaces. Returns 0 on success or -1 and sets errno on failure.
+ */
+int helix_aggregator_map_symbol(helix_aggregator_t, size_t venue, const char *venue_symbol, const char *instrument);
+
+/*!
+ * @abstract Process an order book update of a venue.
+ *
+ * Only the top price levels of the updated order book are read. The NBBO
+ * callback is invoked if the NBBO of the instrument changes.
+ */
+void helix_aggregator_update(helix_aggregator_t, size_t venue, helix_order_book_t);
+
+/*!
+ * @abstract Returns the consolidated book of an instrument, or NULL if no
+ * venue has updated it yet.
+ */
+helix_consolidated_book_t helix_aggregator_lookup(helix_aggregator_t, const char *instrument);
+
+/*!
+ * @abstract Returns the instrument of a consolidated book.
+ */
+const char *helix_consolidated_book_symbol(helix_consolidated_book_t);
+
+/*!
+ * @abstract Returns the timestamp of the venue update that last changed a
+ * consolidated book.
+ */
+helix_timestamp_t helix_consolidated_book_timestamp(helix_consolidated_book_t);
+
+/*!
+ * @abstract Returns the consolidated bid price for a price level.
+ */
+helix_price_t helix_consolidated_book_bid_price(helix_consolidated_book_t, size_t);
+
+/*!
+ * @abstract Returns the total bid size on all venues for a price level.
+ */
+uint64_t helix_consolidated_book_bid_size(helix_consolidated_book_t, size_t);
+
+/*!
+ * @abstract Returns the consolidated ask price for a price level.
+ */
+helix_price_t helix_consolidated_book_ask_price(helix_consolidated_book_t, size_t);
+
+/*!
+ * @abstract Returns the total ask size on all venues for a price level.
+ */
+uint64_t helix_consolidated_book_ask_size(helix_consolidated_book_t, size_t);
+
+/*!
+ * @abstract Returns the venue that quotes the best bid, or SIZE_MAX if there
+ * is no bid.
+ */
+size_t helix_consolidated_book_bid_venue(helix_consolidated_book_t);
+
+/*!
+ * @abstract Returns the venue that quotes the best ask, or SIZE_MAX if there
+ * is no ask.
+ */
+size_t helix_consolidated_book_ask_venue(helix_consolidated_book_t);
+
+/*!
+ * @enum     helix_bus_event_type_t
+ * @abstract Type of a market data bus event.
+ */
+typedef enum {
+    /*! Top of book update. */
+    HELIX_BUS_EVENT_ORDER_BOOK = 1,
+    /*! Trade. */
+    HELIX_BUS_EVENT_TRADE = 2,
+} helix_bus_event_type_t;
+
+/*!
+ * @typedef  helix_bus_event_t
+ * @abstract Event read from a market data bus.
+ */
+typedef struct {
+    helix_bus_event_type_t type;
+    /*! Index of the symbol in the latest value table of the bus. */
+    uint32_t               symbol;
+    helix_timestamp_t      timestamp;
+    /*! Trading state of a top of book update. */
+    helix_trading_state_t  state;
+    /*! Best bid and ask of a top of book update. */
+    helix_price_level_t    bid;
+    helix_price_level_t    ask;
+    /*! Sign, price and size of a trade. */
+    helix_trade_sign_t     sign;
+    helix_price_t          price;
+    uint64_t               size;
+} helix_bus_event_t;
+
+/*!
+ * @abstract Create a shared memory market data bus.
+ *
+ * The bus is a POSIX shared memory object with a ring of capacity events,
+ * rounded up to a power of two, and the latest top depth price levels of up
+ * to max_symbols symbols. A bus of the same name is replaced. Returns NULL
+ * and sets errno on failure.
+ */
+helix_bus_t helix_bus_create(const char *name, size_t capacity, size_t max_symbols, size_t depth);
+
+/*!
+ * @abstract Destroy a market data bus and remove its shared memory object.
+ */
+void helix_bus_destroy(helix_bus_t);
+
+/*!
+ * @abstract Publish an order book update to a market data bus.
+ *
+ * Typically called from the order book callback of the session. Returns
+ * zero on success, or -1 with errno set to ENOSPC if the latest value table
+ * of the bus is full.
+ */
+int helix_bus_publish_order_book(helix_bus_t, helix_order_book_t);
+
+/*!
+ * @abstract Publish a trade to a market data bus.
+ *
+ * Returns zero on success, or -1 with errno set to ENOSPC if the latest
+ * value table of the bus is full.
+ */
+int helix_bus_publish_trade(helix_bus_t, helix_trade_t);
+
+/*!
+ * @abstract Attach to a market data bus.
+ *
+ * The reader starts at the newest event of the bus. Returns NULL and sets
+ * errno on failure.
+ */
+helix_bus_reader_t helix_bus_reader_open(const char *name);
+
+/*!
+ * @abstract Detach from a market data bus.
+ */
+void helix_bus_reader_close(helix_bus_reader_t);
+
+/*!
+ * @abstract Read the next event from a market data bus.
+ *
+ * Returns 1 if an event was read and 0 if there are no new events. The
+ * publisher never waits for readers: a reader that falls more than a ring's
+ * worth of events behind skips to the newest event.
+ */
+int helix_bus_reader_poll(helix_bus_reader_t, helix_bus_event_t *event);
+
+/*!
+ * @abstract Returns the number of events a reader skipped because it fell
+ * behind.
+ */
+uint64_t helix_bus_reader_lost(helix_bus_reader_t);
+
+/*!
+ * @abstract Returns the number of price levels per side in the latest
+ * values of a market data bus.
+ */
+size_t helix_bus_reader_depth(helix_bus_reader_t);
+
+/*!
+ * @abstract Returns the number of symbols in the latest value table of a
+ * market data bus.
+ */
+size_t helix_bus_reader_symbol_count(helix_bus_reader_t);
+
+/*!
+ * @abstract Returns the symbol of a latest value table entry, or NULL if
+ * there is no such entry.
+ */
+const char *helix_bus_reader_symbol(helix_bus_reader_t, uint32_t symbol);
+
+/*!
+ * @abstract Look up a symbol in the latest value table of a market data bus.
+ *
+ * Trailing spaces are ignored. Returns the index of the symbol, or -1 if it
+ * has not been published.
+ */
+int64_t helix_bus_reader_find(helix_bus_reader_t, const char *symbol);
+
+/*!
+ * @abstract Read the latest value of a symbol from a market data bus.
+ *
+ * Fills in the timestamp and trading state of the order book and the bids
+ * and asks arrays like helix_published_book_read() does. Returns the number
+ * of times the latest value has been updated, which is zero if there is no
+ * such symbol.
+ */
+uint64_t helix_bus_reader_read(helix_bus_reader_t, uint32_t symbol, helix_timestamp_t *timestamp, helix_trading_state_t *state,
+                               helix_price_level_t *bids, helix_price_level_t *asks, size_t depth);
+
 /*!
  * @abstract Unsubscribe a subscription from session.
  */
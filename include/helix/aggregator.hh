@@ -0,0 +1,145 @@
+#pragma once
+
+#include "helix/helix.hh"
+
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace helix {
+
+namespace core {
+
+/// \addtogroup order-book
+/// @{
+
+/// \brief Consolidated order book of an instrument across venues.
+///
+/// The book keeps a copy of the top price levels of every venue and merges
+/// them into consolidated price levels, whose size is the total size
+/// quoted at the price on all venues. The best consolidated level of each
+/// side is the synthetic national best bid and offer (NBBO).
+///
+/// Venues are expected to quote the instrument in the same price units.
+class consolidated_book {
+    struct venue_quote {
+        std::vector<depth_level> bids;
+        std::vector<depth_level> asks;
+    };
+    std::string _symbol;
+    size_t _depth;
+    uint64_t _timestamp;
+    std::vector<venue_quote> _venues;
+    std::vector<depth_level> _bids;
+    std::vector<depth_level> _asks;
+    size_t _bid_venue;
+    size_t _ask_venue;
+    venue_quote _scratch;
+    std::vector<size_t> _cursors;
+public:
+    /// Venue of an empty side of the book.
+    static constexpr size_t no_venue = std::numeric_limits<size_t>::max();
+
+    consolidated_book(std::string symbol, size_t depth);
+
+    const std::string& symbol() const {
+        return _symbol;
+    }
+
+    /// Returns the timestamp of the venue order book update that last
+    /// changed the consolidated book.
+    uint64_t timestamp() const {
+        return _timestamp;
+    }
+
+    size_t depth() const {
+        return _depth;
+    }
+
+    /// Returns the consolidated price and size of a level, with the same
+    /// values for empty levels as order_book::bid_price() and friends.
+    uint64_t bid_price(size_t level) const;
+    uint64_t bid_size (size_t level) const;
+    uint64_t ask_price(size_t level) const;
+    uint64_t ask_size (size_t level) const;
+
+    /// Returns the lowest-numbered venue that quotes the best bid or ask
+    /// price, or no_venue if the side is empty.
+    size_t bid_venue() const {
+        return _bid_venue;
+    }
+
+    size_t ask_venue() const {
+        return _ask_venue;
+    }
+
+    /// Replaces the quote of a venue with the top price levels of its order
+    /// book. An order book that is halted or paused quotes no levels. Only
+    /// the levels of \p venue are read; the other venues are merged from
+    /// their copies. Returns \c true if the NBBO changed.
+    bool update(size_t venue, const order_book& ob);
+private:
+    template<typename Better>
+    size_t merge(std::vector<depth_level> venue_quote::* side, std::vector<depth_level>& levels,
+                 uint64_t empty, Better better);
+};
+
+/// Callback that is invoked when the NBBO of an instrument changes.
+using nbbo_callback = std::function<void(const consolidated_book&)>;
+
+/// \brief Aggregator maintains consolidated order books across sessions.
+///
+/// Every session that feeds the aggregator is a venue. The order books of
+/// different venues are consolidated by instrument, which is the order book
+/// symbol without trailing spaces unless the symbol is mapped to a
+/// different instrument name with map_symbol().
+///
+/// The aggregator is not thread-safe: sessions that run on different
+/// threads must serialize their updates.
+class aggregator {
+    size_t _depth;
+    size_t _venue_count;
+    std::vector<std::unordered_map<std::string, std::string>> _symbol_maps;
+    std::unordered_map<std::string, consolidated_book> _books;
+    std::unordered_map<const order_book*, consolidated_book*> _books_by_ob;
+    nbbo_callback _process_nbbo;
+public:
+    /// Creates an aggregator that consolidates \p depth price levels.
+    explicit aggregator(size_t depth = 1);
+
+    /// Adds a venue and returns its number. The application passes the
+    /// order book updates of the venue to update().
+    size_t add_venue();
+
+    /// Adds a session as a venue and returns the venue number. The order
+    /// book callback of the session is replaced with one that updates the
+    /// aggregator.
+    size_t attach(session& s);
+
+    /// Consolidates the order book of \p venue_symbol on \p venue into the
+    /// book of \p instrument.
+    void map_symbol(size_t venue, const std::string& venue_symbol, const std::string& instrument);
+
+    void register_callback(nbbo_callback process_nbbo) {
+        _process_nbbo = std::move(process_nbbo);
+    }
+
+    /// Processes an order book update of a venue.
+    void update(size_t venue, const order_book& ob);
+
+    /// Returns the consolidated book of an instrument, or \c nullptr if no
+    /// venue has updated it yet.
+    const consolidated_book* find(const std::string& instrument) const;
+private:
+    consolidated_book& lookup(size_t venue, const order_book& ob);
+};
+
+/// @}
+
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+namespace helix {
+
+namespace core {
+
+/// \defgroup ascii ASCII field decoding
+///
+/// Decoding of fixed-width ASCII decimal fields, which protocols such as
+/// Nordic ITCH use for all numbers. The fields are right-justified and
+/// padded with leading spaces. The decoders assume that every character is
+/// a digit or a space and decode a space as a zero.
+///
+/// The digits of a field are converted in parallel, eight at a time in a
+/// 64-bit word, or all sixteen at once in an SSE register if the library is
+/// built for a processor with SSE4.1 (for example with -march=native), and
+/// the field is loaded without reading past its end.
+
+/// \addtogroup ascii
+/// @{
+
+namespace detail {
+
+/// Loads \p N bytes, at most eight, into the most significant end of a
+/// little-endian word and zeroes the rest. The word is assembled from
+/// naturally sized loads, so there is no store forwarding stall.
+template<size_t N>
+inline uint64_t load_digits(const char* p)
+{
+    static_assert(N <= 8, "at most eight digits fit in a word");
+    uint64_t v = 0;
+    if (N == 8) {
+        memcpy(&v, p, 8);
+        return v;
+    }
+    size_t off = 0;
+    if (N >= 4) {
+        uint32_t w;
+        memcpy(&w, p, 4);
+        v = w;
+        off = 4;
+    }
+    if (N - off >= 2) {
+        uint16_t w;
+        memcpy(&w, p + off, 2);
+        v |= uint64_t(w) << (8 * off);
+        off += 2;
+    }
+    if (N - off) {
+        v |= uint64_t(uint8_t(p[off])) << (8 * off);
+    }
+    return N ? v << (8 * (8 - N)) : 0;
+}
+
+/// Converts eight ASCII digits in a word, the most significant digit in the
+/// lowest byte, by combining adjacent digits, then pairs, then quadruples.
+inline uint64_t convert_digits(uint64_t v)
+{
+    v &= 0x0f0f0f0f0f0f0f0full;
+    v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffull;
+    v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffull;
+    v = (v * 10000 + (v >> 32)) & 0x00000000ffffffffull;
+    return v;
+}
+
+template<size_t N>
+inline typename std::enable_if<(N <= 8), uint64_t>::type decode_swar(const char* p)
+{
+    return convert_digits(load_digits<N>(p));
+}
+
+template<size_t N>
+inline typename std::enable_if<(N > 8), uint64_t>::type decode_swar(const char* p)
+{
+    return convert_digits(load_digits<N - 8>(p)) * 100000000 + convert_digits(load_digits<8>(p + N - 8));
+}
+
+#ifdef __SSE4_1__
+
+template<size_t N>
+inline uint64_t decode_sse(const char* p)
+{
+    __m128i v;
+    if (N <= 8) {
+        v = _mm_set_epi64x(load_digits<N <= 8 ? N : 8>(p), 0);
+    } else {
+        v = _mm_set_epi64x(load_digits<8>(p + N - 8), load_digits<N <= 8 ? 0 : N - 8>(p));
+    }
+    v = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+    // Pairs of digits, then groups of four digits as 32-bit lanes, which
+    // are packed to 16 bits to combine them into two groups of eight.
+    v = _mm_maddubs_epi16(v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    v = _mm_packus_epi32(v, v);
+    v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    uint64_t hi = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+    uint64_t lo = static_cast<uint32_t>(_mm_extract_epi32(v, 1));
+    return hi * 100000000 + lo;
+}
+
+#endif
+
+}
+
+/// Decodes an ASCII decimal field of a message that is \p N characters,
+/// at most 16, wide.
+template<size_t N>
+inline uint64_t decode_decimal(const char (&field)[N])
+{
+    static_assert(N > 0 && N <= 16, "decimal fields are 1 to 16 characters wide");
+#ifdef __SSE4_1__
+    return detail::decode_sse<N>(field);
+#else
+    return detail::decode_swar<N>(field);
+#endif
+}
+
+/// @}
+
+}
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "helix/helix.hh"
+
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace helix {
+
+namespace core {
+
+/// \addtogroup order-book
+/// @{
+
+/// \brief Market data bus shares the normalized events of one session with
+/// consumer processes on the same host.
+///
+/// The bus is a POSIX shared memory object that holds a ring of events and
+/// a table of per-symbol latest values. The ring is written by a single
+/// publisher and read by any number of consumers, none of which the
+/// publisher waits for. Every event is a top-of-book update or a trade in
+/// one cache line. The latest value of a symbol is its top price levels,
+/// timestamp and trading state.
+///
+/// Events and latest values are written under sequence locks, so a reader
+/// detects a copy that was overwritten while it was reading. A consumer
+/// that falls more than a ring's worth of events behind skips to the newest
+/// event and counts the skipped events as lost; it can recover book state
+/// from the latest values.
+namespace bus {
+
+static constexpr char magic[8] = {'H', 'E', 'L', 'I', 'X', 'B', 'U', 'S'};
+static constexpr uint32_t version = 1;
+
+enum class event_type : uint8_t {
+    order_book = 1,
+    trade = 2,
+};
+
+struct header {
+    char     magic[8];
+    uint32_t version;
+    //! Number of price levels per side in a latest value.
+    uint32_t depth;
+    //! Number of events in the ring, which is a power of two.
+    uint64_t capacity;
+    //! Maximum number of symbols in the latest value table.
+    uint64_t max_symbols;
+    //! Size of a latest value table entry in bytes.
+    uint64_t symbol_stride;
+    //! Number of events published since the bus was created.
+    alignas(64) std::atomic<uint64_t> head;
+    //! Number of symbols in the latest value table.
+    alignas(64) std::atomic<uint64_t> symbol_count;
+};
+
+/// Event in the ring. The sequence number of the n-th event is 2n + 1
+/// while the event is being written and 2n + 2 once it is complete.
+struct alignas(64) event {
+    std::atomic<uint64_t> seq;
+    //! Event type, trading state or trade sign, and symbol index.
+    std::atomic<uint64_t> meta;
+    std::atomic<uint64_t> timestamp;
+    //! Best bid price and size and best ask price and size of an order
+    //! book update, or price and size of a trade.
+    std::atomic<uint64_t> words[4];
+};
+
+/// Latest value table entry, which is followed by the price and size of
+/// depth bid levels and depth ask levels.
+struct symbol_entry {
+    char symbol[32];
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> timestamp;
+    std::atomic<uint64_t> state;
+};
+
+}
+
+/// \brief Event that a consumer reads from a market data bus.
+struct bus_event {
+    bus::event_type type;
+    uint32_t symbol;
+    uint64_t timestamp;
+    //! Trading state of an order book update.
+    trading_state state;
+    //! Sign of a trade.
+    trade_sign sign;
+    //! Best levels of an order book update.
+    depth_level bid;
+    depth_level ask;
+    //! Price and size of a trade.
+    uint64_t price;
+    uint64_t size;
+};
+
+/// \brief Publisher writes the events of a session to a market data bus.
+///
+/// A publisher is not thread-safe: events must be published from one
+/// thread, which is normally the thread that processes packets.
+class bus_publisher {
+    std::string _name;
+    char* _base;
+    size_t _size;
+    bus::header* _header;
+    bus::event* _ring;
+    char* _symbols;
+    uint64_t _mask;
+    std::unordered_map<std::string, uint32_t> _symbol_index;
+    //! Symbol table entries by the address of an order book symbol, which
+    //! lets trades be published without building a string.
+    std::unordered_map<const char*, uint32_t> _symbol_index_by_ptr;
+    std::vector<depth_level> _scratch;
+public:
+    /// Creates a bus named \p name with room for \p capacity events, which
+    /// is rounded up to a power of two, and the latest values of
+    /// \p max_symbols symbols with \p depth price levels per side. A bus of
+    /// the same name is replaced; consumers that attached to it keep
+    /// reading the old one until they reopen the bus. Throws
+    /// std::system_error on failure.
+    bus_publisher(const std::string& name, size_t capacity, size_t max_symbols, size_t depth);
+    ~bus_publisher();
+
+    bus_publisher(const bus_publisher&) = delete;
+    bus_publisher& operator=(const bus_publisher&) = delete;
+
+    /// Replaces the order book and trade callbacks of a session with ones
+    /// that publish to the bus.
+    void attach(session& s);
+
+    /// Publishes an order book update. Returns \c false if the symbol does
+    /// not fit in the latest value table.
+    bool publish(const order_book& ob);
+
+    /// Publishes a trade. Returns \c false if the symbol does not fit in
+    /// the latest value table.
+    bool publish(const trade& t);
+private:
+    bool lookup(const char* symbol, uint32_t& idx);
+    bus::symbol_entry& entry(uint32_t idx);
+    void append(uint64_t meta, uint64_t timestamp, uint64_t w0, uint64_t w1, uint64_t w2, uint64_t w3);
+};
+
+/// \brief Reader attaches a consumer to a market data bus.
+///
+/// A reader is not thread-safe, but every consumer thread can open a
+/// reader of its own.
+class bus_reader {
+    char* _base;
+    size_t _size;
+    const bus::header* _header;
+    const bus::event* _ring;
+    const char* _symbols;
+    uint64_t _mask;
+    uint64_t _tail;
+    uint64_t _lost;
+public:
+    /// Attaches to the bus named \p name and positions the reader at the
+    /// newest event. Throws std::system_error if the bus does not exist and
+    /// std::runtime_error if it is not a bus.
+    explicit bus_reader(const std::string& name);
+    ~bus_reader();
+
+    bus_reader(const bus_reader&) = delete;
+    bus_reader& operator=(const bus_reader&) = delete;
+
+    /// Reads the next event into \p e. Returns \c false if there is none.
+    bool poll(bus_event& e);
+
+    /// Returns the number of events that were skipped because the reader
+    /// fell behind.
+    uint64_t lost() const {
+        return _lost;
+    }
+
+    size_t depth() const {
+        return _header->depth;
+    }
+
+    size_t symbol_count() const;
+
+    /// Returns the symbol of a latest value table entry, or \c nullptr if
+    /// idx is not a symbol of the bus. The symbol lives in the bus.
+    const char* symbol(uint32_t idx) const;
+
+    /// Looks up the latest value table entry of a symbol, ignoring trailing
+    /// spaces. Returns \c false if the symbol has not been published.
+    bool find(const std::string& symbol, uint32_t& idx) const;
+
+    /// Copies a consistent latest value of a symbol with up to depth()
+    /// price levels per side. Returns the number of times it has been
+    /// updated, which is zero if idx is not a symbol of the bus.
+    uint64_t read(uint32_t idx, uint64_t& timestamp, trading_state& state,
+                  depth_level* bids, depth_level* asks, size_t levels) const;
+private:
+    const bus::symbol_entry& entry(uint32_t idx) const;
+};
+
+/// @}
+
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "helix/helix.hh"
+
+#include <condition_variable>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+namespace helix {
+
+namespace core {
+
+/// Compression format of a market data file.
+enum class file_compression {
+    none,
+    gzip,
+    zstd,
+};
+
+class file_decoder;
+class replay_clock;
+
+/// \brief Streaming reader of market data files.
+///
+/// The reader replays a BinaryFILE or SoupFILE to a session without mapping
+/// or first decompressing the file. The compression format is detected from
+/// the magic number of the file. A background thread reads and decompresses
+/// the file in large chunks into one of two buffers while the session
+/// processes the other one.
+///
+/// A message that straddles a chunk boundary is carried over to the front of
+/// the next chunk, so the session always sees a message as one contiguous
+/// buffer. This requires messages to be at most max_message_size bytes,
+/// which holds for the 16-bit length prefixed BinaryFILE records.
+class file_reader {
+public:
+    static constexpr size_t default_chunk_size = 16 * 1024 * 1024;
+
+    /// Maximum size of a message, including its framing.
+    static constexpr size_t max_message_size = 64 * 1024 + 2;
+private:
+    struct buffer {
+        std::vector<char> data;
+        size_t size = 0;
+        bool full = false;
+        bool last = false;
+    };
+    std::string _path;
+    std::unique_ptr<file_decoder> _decoder;
+    size_t _chunk_size;
+    buffer _buffers[2];
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::exception_ptr _error;
+    bool _stop = false;
+    std::thread _thread;
+public:
+    /// Opens a file. Throws std::system_error if the file cannot be opened
+    /// and std::runtime_error if its compression format is not supported.
+    explicit file_reader(const std::string& path, size_t chunk_size = default_chunk_size);
+    ~file_reader();
+
+    file_reader(const file_reader&) = delete;
+    file_reader& operator=(const file_reader&) = delete;
+
+    file_compression compression() const;
+
+    /// Replays the file to a session until the end of the file or until the
+    /// session reports end of session. Returns the number of uncompressed
+    /// bytes that were processed. Rethrows errors from the reader thread.
+    uint64_t replay(session& s);
+
+    /// Replays the file to a session like replay(session&) does, but waits
+    /// for \p clock to release every packet at the feed time that
+    /// session::packet_time() reports for it.
+    uint64_t replay(session& s, replay_clock& clock);
+private:
+    char* chunk(buffer& b) {
+        return b.data.data() + max_message_size;
+    }
+
+    buffer& acquire(size_t idx);
+    void release(size_t idx);
+    uint64_t replay_records(session& s, replay_clock* clock);
+    void run();
+};
+
+}
+
+}
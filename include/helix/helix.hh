@@ -9,19 +9,17 @@
 ///   - \ref order-book Order book reconstruction and management.
 
 #include "helix/order_book.hh"
+#include "helix/net.hh"
 
+#include <functional>
+#include <stdexcept>
 #include <cstddef>
+#include <memory>
 #include <vector>
 #include <string>
 
 namespace helix {
 
-namespace net {
-
-class packet_view;
-
-}
-
 namespace core {
 
 enum class trade_sign {
@@ -31,27 +29,140 @@ enum class trade_sign {
     non_displayable,
 };
 
+/// \brief Trade event.
+///
+/// A trade does not own its symbol. The symbol points to the symbol of the
+/// order book the trade happened in and is valid for as long as the order
+/// book exists, so that delivering a trade never allocates.
 struct trade {
-    std::string symbol;
+    const char* symbol;
     uint64_t    timestamp;
     uint64_t    price;
     uint64_t    size;
     trade_sign  sign;
 
-    trade(std::string symbol_, uint64_t timestamp_,
+    trade(const std::string& symbol_, uint64_t timestamp_,
           uint64_t price_, uint64_t size_, trade_sign sign_)
-        : symbol{std::move(symbol_)}
+        : symbol{symbol_.c_str()}
         , timestamp{timestamp_}
         , price{price_}
         , size{size_}
         , sign{sign_}
     { }
+
+    trade(std::string&& symbol_, uint64_t timestamp_,
+          uint64_t price_, uint64_t size_, trade_sign sign_) = delete;
+};
+
+enum class order_event_type : uint8_t {
+    /// Order was added to the book.
+    add,
+    /// Quantity of an order was reduced by a cancellation or an execution.
+    /// The order keeps its queue position.
+    modify,
+    /// Order was removed from the book.
+    remove,
+};
+
+/// \brief Order event.
+///
+/// Order books that keep order queues (see level_config::order_queues)
+/// report every order that is added, modified or removed. A replaced
+/// order loses its queue position, so replacement is reported as the
+/// removal of the old order followed by the addition of the new one.
+struct order_event {
+    order_event_type type;
+    const order_book* book;
+    //! Slot of the order in the book, which can be passed to
+    //! order_book::position_at(). Not valid for removed orders.
+    uint32_t    slot;
+    uint64_t    timestamp;
+    uint64_t    id;
+    uint64_t    price;
+    //! Quantity of the order after the event, zero if it was removed.
+    uint64_t    quantity;
+    //! Quantity of the order before the event, zero if it was added.
+    uint64_t    previous_quantity;
+    side_type   side;
+
+    order_event(order_event_type type_, const order_book& book_, uint32_t slot_,
+                const order& o, uint64_t previous_quantity_)
+        : type{type_}
+        , book{&book_}
+        , slot{slot_}
+        , timestamp{book_.timestamp()}
+        , id{o.id}
+        , price{o.price}
+        , quantity{type_ == order_event_type::remove ? 0 : o.quantity}
+        , previous_quantity{previous_quantity_}
+        , side{o.side}
+    { }
 };
 
 using ob_callback = std::function<void(const order_book&)>;
 
 using trade_callback = std::function<void(const trade&)>;
 
+using order_callback = std::function<void(const order_event&)>;
+
+/// Callback for requesting retransmission of \p count messages starting
+/// from sequence number \p seq_num.
+using retransmit_callback = std::function<void(uint64_t seq_num, uint64_t count)>;
+
+/// \brief Listener that forwards events to callback functions.
+///
+/// Feed handlers deliver events to a listener that is a template parameter
+/// of the handler, so that a listener whose member functions are visible to
+/// the compiler is called directly and can be inlined. A listener provides:
+///
+///   - void on_order_book(const order_book&)
+///   - void on_trade(const trade&)
+///   - void on_order(const order_event&)
+///
+/// This listener is used by the sessions of the C API and dispatches events
+/// through \c std::function.
+class callback_listener {
+    ob_callback _process_ob;
+    trade_callback _process_trade;
+    order_callback _process_order;
+public:
+    void register_callback(ob_callback process_ob) {
+        _process_ob = std::move(process_ob);
+    }
+
+    void register_callback(trade_callback process_trade) {
+        _process_trade = std::move(process_trade);
+    }
+
+    void register_callback(order_callback process_order) {
+        _process_order = std::move(process_order);
+    }
+
+    void on_order_book(const order_book& ob) {
+        _process_ob(ob);
+    }
+
+    void on_trade(const trade& t) {
+        _process_trade(t);
+    }
+
+    void on_order(const order_event& e) {
+        if (_process_order) {
+            _process_order(e);
+        }
+    }
+};
+
+class snapshot;
+class mapped_snapshot;
+class latency_stats;
+
+/// Redundant feed lines that carry the same sequenced messages.
+enum class feed_line {
+    a,
+    b,
+};
+
 class session {
     void* _data;
 public:
@@ -66,18 +177,146 @@ public:
         return _data;
     }
 
-    virtual void subscribe(const std::string& symbol, size_t max_orders) = 0;
+    virtual void subscribe(const std::string& symbol, size_t max_orders,
+                           const core::level_config& levels = core::level_config{}) = 0;
+
+    /// Subscribes to every symbol of the feed. The order books of symbols
+    /// that are not also subscribed with subscribe() share one order pool
+    /// that is sized for \p max_orders resting orders across the feed.
+    virtual void subscribe_all(size_t max_orders,
+                               const core::level_config& levels = core::level_config{}) = 0;
+
+    /// Enables or disables conflation of order book updates. When enabled,
+    /// an order book that changes several times within a packet or a
+    /// timestamp is delivered once, after its last change.
+    virtual void set_conflation(bool enabled) = 0;
 
     virtual void register_callback(core::ob_callback process_ob) = 0;
 
     virtual void register_callback(core::trade_callback process_trade) = 0;
 
+    /// Registers a callback for the order events of order books that keep
+    /// order queues.
+    virtual void register_callback(core::order_callback process_order) = 0;
+
+    /// Returns the queue position of a resting order in \p pos. Throws
+    /// std::logic_error if the order book of the order does not keep order
+    /// queues.
+    virtual core::status position(uint64_t order_id, core::queue_position& pos) const {
+        return core::status::unknown_order;
+    }
+
+    /// Registers a callback that is invoked when the session detects a gap
+    /// in a sequenced transport protocol. The application is expected to
+    /// request the missing messages from a retransmission server and pass
+    /// them to process_packet(). Messages that are still missing may be
+    /// requested again.
+    virtual void set_retransmit_callback(core::retransmit_callback retransmit) = 0;
+
     virtual size_t process_packet(const net::packet_view& packet) = 0;
+
+    /// Processes a packet received on one of the redundant feed lines of a
+    /// sequenced transport protocol. Sessions that do not arbitrate between
+    /// lines process the packet like process_packet() does.
+    virtual size_t process_line_packet(feed_line line, const net::packet_view& packet) {
+        return process_packet(packet);
+    }
+
+    /// Returns the feed clock, which is the timestamp of the last message
+    /// processed in the time unit of the protocol.
+    virtual uint64_t clock() const {
+        return 0;
+    }
+
+    /// Returns the feed time, in nanoseconds, of the first message of a
+    /// packet that is passed to process_packet() next, or zero if the
+    /// packet has no timestamp of its own. Sessions whose messages carry
+    /// only an offset from a separate time message report the time of the
+    /// last time message. Used for pacing replays with core::replay_clock.
+    virtual uint64_t packet_time(const net::packet_view& packet) const {
+        return 0;
+    }
+
+    /// Re-emits every message that the session processes to \p mirror,
+    /// which sees the message stream in sequence with duplicates removed
+    /// and is flushed at the end of every packet. Throws std::logic_error
+    /// if the session does not support mirroring.
+    virtual void set_mirror(std::shared_ptr<net::message_parser> mirror) {
+        throw std::logic_error("session does not support mirroring");
+    }
+
+    /// Sets the receive timestamp, in nanoseconds since the epoch, of the
+    /// packet that is processed next so that the session can measure
+    /// wire-to-callback latency. Zero means the packet has no timestamp.
+    virtual void set_rx_timestamp(uint64_t timestamp) {
+    }
+
+    /// Returns the latency statistics of the session, or \c nullptr if
+    /// the session is not instrumented. Sessions are instrumented when the
+    /// library is built with HELIX_LATENCY defined.
+    virtual const latency_stats* latency() const {
+        return nullptr;
+    }
+
+    /// Registers a callback that is invoked for every message that is
+    /// dropped because it cannot be applied to the order books, such as an
+    /// execution of an unknown order.
+    virtual void set_error_callback(core::error_callback process_error) {
+    }
+
+    /// Makes dropped messages throw std::invalid_argument instead of being
+    /// reported to the error callback. Meant for debugging.
+    virtual void set_strict(bool strict) {
+    }
+
+    /// Returns the number of messages that were dropped with status \p s.
+    virtual uint64_t error_count(core::status s) const {
+        return 0;
+    }
+
+    /// Returns the number of bytes of memory that the order books and
+    /// order indexes of the session use.
+    virtual size_t memory_usage() const {
+        return 0;
+    }
+
+    /// Captures order book state and the transport sequence number in \p s.
+    /// Throws std::logic_error if the session does not support snapshots.
+    virtual void save(snapshot& s) const {
+        throw std::logic_error("snapshots are not supported");
+    }
+
+    /// Restores state that was captured with save() into a session that has
+    /// not processed any packets. Processing resumes from the sequence
+    /// number of the snapshot. Throws std::logic_error if the session does
+    /// not support snapshots.
+    virtual void restore(const mapped_snapshot& s) {
+        throw std::logic_error("snapshots are not supported");
+    }
+
+    /// Processes \p count packets in order. This is equivalent to calling
+    /// process_packet() for each of them, except that sessions may amortize
+    /// per-packet work over the batch and conflation, when enabled, may
+    /// extend across packet boundaries. Returns the total number of bytes
+    /// processed.
+    virtual size_t process_packets(const net::packet_view* packets, size_t count) {
+        size_t nr = 0;
+        for (size_t i = 0; i < count; i++) {
+            nr += process_packet(packets[i]);
+        }
+        return nr;
+    }
 };
 
 class protocol {
 public:
     virtual session* new_session(void*) = 0;
+
+    /// Creates a session that processes messages on \p shards worker
+    /// threads. Returns \c nullptr if the protocol does not support it.
+    virtual session* new_sharded_session(size_t shards, void*) {
+        return nullptr;
+    }
 };
 
 }
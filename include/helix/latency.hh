@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace helix {
+
+namespace core {
+
+/// Reads the time stamp counter. Platforms without one return nanoseconds
+/// of the monotonic clock instead.
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/// Returns the number of time stamp counter ticks per nanosecond. The rate
+/// is calibrated against the monotonic clock on the first call.
+double tsc_ticks_per_nsec();
+
+/// Returns the wall clock time in nanoseconds since the epoch, which is the
+/// clock of kernel receive timestamps.
+inline uint64_t realtime_nsec()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/// \brief Latency histogram.
+///
+/// The histogram has log-linear buckets in the style of HdrHistogram:
+/// values below 2^sub_bucket_bits have a bucket of their own and larger
+/// values are split into 2^sub_bucket_bits buckets per power of two, which
+/// bounds the relative error of a percentile to about 3%.
+///
+/// A histogram has a single writer, which updates the counters without
+/// atomic read-modify-write instructions, and any number of concurrent
+/// readers that see a slightly stale but never torn histogram.
+class latency_histogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+    //! Values are clamped to below 2^max_value_bits.
+    static constexpr unsigned max_value_bits = 48;
+    static constexpr size_t bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_buckets;
+private:
+    std::atomic<uint64_t> _counts[bucket_count];
+    std::atomic<uint64_t> _max;
+public:
+    latency_histogram();
+
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+    void record(uint64_t value) {
+        auto&& count = _counts[index(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > _max.load(std::memory_order_relaxed)) {
+            _max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const;
+
+    uint64_t max() const {
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    /// Returns the highest value that is equivalent to the value at a
+    /// percentile between 0 and 100, capped at the maximum value, or zero
+    /// if the histogram is empty.
+    uint64_t percentile(double p) const;
+private:
+    static size_t index(uint64_t value) {
+        if (value < sub_buckets) {
+            return value;
+        }
+        if (value >> max_value_bits) {
+            value = (uint64_t(1) << max_value_bits) - 1;
+        }
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned shift = msb - sub_bucket_bits;
+        return (shift + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+    }
+
+    static uint64_t highest_equivalent(size_t idx);
+};
+
+/// \brief Latency statistics of a feed handler.
+///
+/// Feed handlers that are built with HELIX_LATENCY defined record the time
+/// it takes to process a message, in time stamp counter ticks, per message
+/// type. If the packet that is being processed has a receive timestamp,
+/// they also record the wire-to-callback latency, in nanoseconds, of every
+/// event they deliver.
+class latency_stats {
+    std::atomic<latency_histogram*> _processing[std::numeric_limits<uint8_t>::max() + 1];
+    latency_histogram _wire;
+    uint64_t _rx_timestamp;
+public:
+    latency_stats();
+    ~latency_stats();
+
+    latency_stats(const latency_stats&) = delete;
+    latency_stats& operator=(const latency_stats&) = delete;
+
+    void record_processing(uint8_t type, uint64_t ticks) {
+        auto* h = _processing[type].load(std::memory_order_relaxed);
+        if (!h) {
+            h = create(type);
+        }
+        h->record(ticks);
+    }
+
+    /// Sets the receive timestamp in nanoseconds since the epoch of the
+    /// packet that is processed next, or zero if it has none.
+    void set_rx_timestamp(uint64_t timestamp) {
+        _rx_timestamp = timestamp;
+    }
+
+    void record_wire() {
+        if (_rx_timestamp) {
+            _wire.record(realtime_nsec() - _rx_timestamp);
+        }
+    }
+
+    /// Returns the processing time histogram of a message type, or \c
+    /// nullptr if no message of the type has been processed.
+    const latency_histogram* processing(uint8_t type) const {
+        return _processing[type].load(std::memory_order_acquire);
+    }
+
+    const latency_histogram& wire() const {
+        return _wire;
+    }
+private:
+    latency_histogram* create(uint8_t type);
+};
+
+}
+
+}
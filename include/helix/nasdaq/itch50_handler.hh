@@ -1,19 +1,48 @@
 #pragma once
 
 #include "helix/nasdaq/itch50_messages.h"
+#include "helix/order_index.hh"
 #include "helix/order_book.hh"
+#include "helix/latency.hh"
+#include "helix/snapshot.hh"
 #include "helix/helix.hh"
 #include "helix/net.hh"
 
 #include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include <vector>
+#include <limits>
+#include <deque>
 #include <memory>
-#include <set>
+
+#include <endian.h>
 
 namespace helix {
 
 namespace nasdaq {
 
+//! Returns the key of a space-padded eight-character symbol, which is the
+//! symbol compared as a 64-bit integer.
+inline uint64_t itch50_symbol_key(const char* symbol)
+{
+    static_assert(ITCH_SYMBOL_LEN == sizeof(uint64_t), "symbol does not fit in a key");
+    uint64_t key;
+    std::memcpy(&key, symbol, sizeof(key));
+    return key;
+}
+
+//! Returns the shard, out of \p shards, that owns the order books of a
+//! stock locate code. The locate code is in wire byte order, which is how
+//! order books are indexed by it.
+inline size_t itch50_shard(uint16_t stock_locate, size_t shards)
+{
+    return be16toh(stock_locate) % shards;
+}
+
 // NASDAQ TotalView-ITCH 5.0
 //
 // This is a feed handler for Total-View ITCH. The handler assumes that
@@ -26,18 +55,62 @@ namespace nasdaq {
 //   Version 5.0
 //   03/06/2015
 //
-class itch50_handler : public net::message_parser {
+// The handler delivers order book and trade events to a listener that is a
+// compile-time parameter (see core::callback_listener for the interface).
+// The itch50_handler alias dispatches events through std::function and is
+// what the C API uses.
+//
+template<typename Listener>
+class basic_itch50_handler : public net::message_parser {
 private:
-    //! Callback function for processing order book events.
-    core::ob_callback _process_ob;
-    //! Callback function for processing trade events.
-    core::trade_callback _process_trade;
-    //! A map of order books by order book ID.
-    std::unordered_map<uint64_t, helix::core::order_book> order_book_id_map;
-    //! A set of symbols that we are interested in.
-    std::set<std::string> _symbols;
-    //! A map of pre-allocation size by symbol.
-    std::unordered_map<std::string, size_t> _symbol_max_orders;
+    //! Listener that order book and trade events are delivered to.
+    Listener _listener;
+#ifdef HELIX_LATENCY
+    //! Per-message processing time and wire-to-callback latency.
+    core::latency_stats _latency;
+#endif
+    //! Are order book updates conflated?
+    bool _conflate;
+    //! Is a batch of packets being processed?
+    bool _batch;
+    //! Order books that have changed since updates were last delivered.
+    std::vector<helix::core::order_book*> _dirty;
+    //! Timestamp of the previous message as it appears on the wire, which
+    //! is compared without byte-swapping.
+    uint64_t _raw_timestamp;
+    //! Order pool that the books of symbols that are only subscribed by
+    //! subscribe_all() share. It outlives the books.
+    core::order_pool _pool;
+    //! Order books of subscribed symbols. Books are never removed, so
+    //! pointers to them stay valid for the lifetime of the handler.
+    std::deque<helix::core::order_book> _books;
+    //! A table of order books indexed by stock locate code. Entries of
+    //! symbols that are not subscribed are \c nullptr.
+    std::vector<helix::core::order_book*> _books_by_locate;
+    //! An index of orders in subscribed order books by order reference
+    //! number, which is unique across the whole feed.
+    core::order_index<core::order_ref> _orders;
+    //! Pre-allocation size and price level storage configuration of a
+    //! subscribed symbol.
+    struct subscription {
+        size_t max_orders;
+        core::level_config levels;
+    };
+    //! Subscriptions by symbol key (see itch50_symbol_key()), so that
+    //! stock directory messages are matched without building a string.
+    std::unordered_map<uint64_t, subscription> _subscriptions;
+    //! Is every symbol of the feed subscribed?
+    bool _subscribe_all;
+    //! Price level storage configuration of symbols that are only
+    //! subscribed by subscribe_all().
+    core::level_config _all_levels;
+    //! Sum of the pre-allocation sizes of the order books created so far
+    //! and of the shared pool.
+    size_t _max_all_orders;
+    //! Messages that were dropped because they could not be applied.
+    core::error_reporter _errors;
+    //! Parser that every processed message is re-emitted to, if any.
+    std::shared_ptr<net::message_parser> _mirror;
 public:
     class unknown_message_type : public std::logic_error {
     public:
@@ -46,29 +119,146 @@ public:
         { }
     };
 public:
-    itch50_handler()
+    explicit basic_itch50_handler(Listener listener = Listener{})
+        : _listener{std::move(listener)}
+        , _conflate{false}
+        , _batch{false}
+        , _raw_timestamp{0}
+        , _books_by_locate(std::numeric_limits<uint16_t>::max() + 1, nullptr)
+        , _subscribe_all{false}
+        , _max_all_orders{0}
     { }
-    void subscribe(std::string sym, size_t max_orders) {
-        auto padding = ITCH_SYMBOL_LEN - sym.size();
-        if (padding > 0) {
-            sym.insert(sym.size(), padding, ' ');
+    Listener& listener() {
+        return _listener;
+    }
+    void subscribe(std::string sym, size_t max_orders, const core::level_config& levels = core::level_config{}) {
+        if (sym.size() > ITCH_SYMBOL_LEN) {
+            // No stock has a symbol this long.
+            return;
         }
-        _symbols.insert(sym);
-        _symbol_max_orders.emplace(sym, max_orders);
-        size_t max_all_orders = 0;
-        for (auto&& kv : _symbol_max_orders) {
-            max_all_orders += kv.second;
+        sym.resize(ITCH_SYMBOL_LEN, ' ');
+        // The order index grows when the order book is created, so that
+        // handlers that never see the symbol do not reserve room for it.
+        _subscriptions.emplace(itch50_symbol_key(sym.data()), subscription{max_orders, levels});
+    }
+    //! Subscribes to every symbol of the feed. Symbols that are not also
+    //! subscribed individually share one order pool, which is sized once
+    //! for \p max_orders resting orders across all of them.
+    void subscribe_all(size_t max_orders, const core::level_config& levels = core::level_config{}) {
+        _subscribe_all = true;
+        _all_levels = levels;
+        _pool.reserve(max_orders);
+        _max_all_orders += max_orders;
+        _orders.reserve(_max_all_orders);
+    }
+    void set_conflation(bool enabled) {
+        if (!enabled) {
+            deliver();
         }
-        order_book_id_map.reserve(max_all_orders);
+        _conflate = enabled;
     }
-    void register_callback(core::ob_callback process_ob) {
-        _process_ob = process_ob;
+    //! Starts a batch of packets. Conflated updates are not delivered at
+    //! packet boundaries until end_batch() is called.
+    void begin_batch() {
+        _batch = true;
     }
-    void register_callback(core::trade_callback process_trade) {
-        _process_trade = process_trade;
+    //! Ends a batch of packets and delivers conflated updates.
+    void end_batch() {
+        _batch = false;
+        deliver();
     }
     virtual size_t parse(const net::packet_view& packet) override;
+    virtual void flush() override {
+        if (!_batch) {
+            deliver();
+        }
+        if (_mirror) {
+            _mirror->flush();
+        }
+    }
+    //! Re-emits every processed message to \p mirror, which is flushed
+    //! whenever the handler is.
+    void set_mirror(std::shared_ptr<net::message_parser> mirror) {
+        _mirror = std::move(mirror);
+    }
+    //! Registers a callback that is invoked for every message that is
+    //! dropped because it cannot be applied to the order books.
+    void set_error_callback(core::error_callback process_error) {
+        _errors.set_callback(std::move(process_error));
+    }
+    //! Throws std::invalid_argument for dropped messages instead of
+    //! reporting them. Meant for debugging.
+    void set_strict(bool strict) {
+        _errors.set_strict(strict);
+    }
+    //! Number of dropped messages with error status \p s.
+    uint64_t error_count(core::status s) const {
+        return _errors.count(s);
+    }
+    //! Queue position of a resting order in an order book that keeps
+    //! order queues.
+    core::status position(uint64_t order_id, core::queue_position& pos) const {
+        auto* e = _orders.find(order_id);
+        if (!e) {
+            return core::status::unknown_order;
+        }
+        pos = _books_by_locate[e->value.book]->position_at(e->value.slot);
+        return core::status::ok;
+    }
+    //! Number of bytes of memory that the order books and the order index
+    //! use.
+    size_t memory_usage() const {
+        size_t size = _orders.memory_usage() + _books_by_locate.capacity() * sizeof(core::order_book*);
+        for (auto&& ob : _books) {
+            size += ob.memory_usage();
+        }
+        // Books count their orders in the shared pool, so only the
+        // unused part of the pool is added.
+        return size + _pool.memory_usage() - _pool.size() * sizeof(core::order);
+    }
+    //! Timestamp of the last message in nanoseconds since midnight.
+    uint64_t clock() const;
+    //! Sets the receive timestamp in nanoseconds since the epoch of the
+    //! packet that is parsed next, or zero if it has none.
+    void set_rx_timestamp(uint64_t timestamp) {
+#ifdef HELIX_LATENCY
+        _latency.set_rx_timestamp(timestamp);
+#endif
+    }
+    //! Latency statistics, or \c nullptr if the handler is not built with
+    //! HELIX_LATENCY defined.
+    const core::latency_stats* latency() const {
+#ifdef HELIX_LATENCY
+        return &_latency;
+#else
+        return nullptr;
+#endif
+    }
+    //! Appends all order books to a snapshot, keyed by stock locate code.
+    void save(core::snapshot& s) const;
+    //! Restores order books from a snapshot into a handler that has not
+    //! created any order books. Only books whose stock locate code modulo
+    //! \p shards equals \p shard are restored.
+    void restore(const core::mapped_snapshot& s, size_t shard = 0, size_t shards = 1);
 private:
+    //! Entry of the message dispatch table.
+    struct dispatch_entry {
+        //! Processes a message and returns its size, or \c nullptr if the
+        //! message type is unknown.
+        size_t (basic_itch50_handler::*process)(const net::packet_view& packet);
+        //! Size of the message.
+        size_t size;
+        //! Is the message skipped if its stock locate is not subscribed?
+        bool filtered;
+    };
+    struct dispatch_table {
+        dispatch_entry entries[std::numeric_limits<uint8_t>::max() + 1];
+    };
+    static constexpr dispatch_table make_dispatch_table();
+    //! Message dispatch table indexed by message type.
+    static const dispatch_table _dispatch_table;
+
+    size_t dispatch(const net::packet_view& packet);
     template<typename T>
     size_t process_msg(const net::packet_view& packet);
     void process_msg(const itch50_system_event* m);
@@ -91,8 +281,532 @@ private:
     void process_msg(const itch50_broken_trade* m);
     void process_msg(const itch50_noii* m);
     void process_msg(const itch50_rpii* m);
+
+    void notify(core::order_book& ob);
+    void publish(const core::order_book& ob) {
+#ifdef HELIX_LATENCY
+        _latency.record_wire();
+#endif
+        _listener.on_order_book(ob);
+    }
+    void publish(const core::trade& t) {
+#ifdef HELIX_LATENCY
+        _latency.record_wire();
+#endif
+        _listener.on_trade(t);
+    }
+    //! Delivers an order event if the order book keeps order queues.
+    void publish(core::order_event_type type, const core::order_book& ob, uint32_t slot,
+                 const core::order& o, uint64_t previous_quantity) {
+        if (ob.levels().order_queues) {
+#ifdef HELIX_LATENCY
+            _latency.record_wire();
+#endif
+            _listener.on_order(core::order_event{type, ob, slot, o, previous_quantity});
+        }
+    }
+    //! Delivers the modification or removal of an order whose quantity was
+    //! reduced from \p o.
+    void publish_reduced(const core::order_book& ob, uint32_t slot, const core::order& o, bool removed) {
+        if (removed) {
+            publish(core::order_event_type::remove, ob, slot, o, o.quantity);
+        } else {
+            publish(core::order_event_type::modify, ob, slot, ob.at(slot), o.quantity);
+        }
+    }
+    //! Delivers order books that have changed since updates were last
+    //! delivered.
+    void deliver() {
+        for (auto* ob : _dirty) {
+            publish(*ob);
+        }
+        _dirty.clear();
+    }
+    core::order_index<core::order_ref>::entry* find_order(uint16_t stock_locate, uint64_t order_id);
+    core::order_book& new_book(std::string symbol, uint64_t timestamp, size_t max_orders, const core::level_config& levels);
+    core::status add_order(core::order_book& ob, uint16_t stock_locate, core::order o, uint32_t& slot);
+    template<typename T>
+    void process_add_order(const T* m);
 };
 
+//! Decodes a buy/sell indicator. Returns \c false if it is invalid.
+inline bool itch50_side(char c, core::side_type& side)
+{
+    switch (c) {
+    case 'B': side = core::side_type::buy;  return true;
+    case 'S': side = core::side_type::sell; return true;
+    default:  return false;
+    }
+}
+
+inline core::trade_sign itch50_trade_sign(core::side_type s)
+{
+    return s == core::side_type::buy ? core::trade_sign::seller_initiated : core::trade_sign::buyer_initiated;
+}
+
+inline uint64_t itch50_timestamp(uint64_t raw_timestamp)
+{
+    return be64toh(raw_timestamp << 16);
+}
+
+inline uint64_t itch50_raw_timestamp(uint64_t timestamp)
+{
+    return htobe64(timestamp) >> 16;
+}
+
+template<typename Listener>
+constexpr typename basic_itch50_handler<Listener>::dispatch_table basic_itch50_handler<Listener>::make_dispatch_table()
+{
+    using handler = basic_itch50_handler<Listener>;
+    dispatch_table t{};
+    // Messages that do not refer to a stock, or that subscribe to one, are
+    // always processed.
+    t.entries['S'] = {&handler::template process_msg<itch50_system_event>,              sizeof(itch50_system_event),              false};
+    t.entries['R'] = {&handler::template process_msg<itch50_stock_directory>,           sizeof(itch50_stock_directory),           false};
+    t.entries['V'] = {&handler::template process_msg<itch50_mwcb_decline_level>,        sizeof(itch50_mwcb_decline_level),        false};
+    t.entries['W'] = {&handler::template process_msg<itch50_mwcb_breach>,               sizeof(itch50_mwcb_breach),               false};
+    t.entries['H'] = {&handler::template process_msg<itch50_stock_trading_action>,      sizeof(itch50_stock_trading_action),      true};
+    t.entries['Y'] = {&handler::template process_msg<itch50_reg_sho_restriction>,       sizeof(itch50_reg_sho_restriction),       true};
+    t.entries['L'] = {&handler::template process_msg<itch50_market_participant_position>, sizeof(itch50_market_participant_position), true};
+    t.entries['K'] = {&handler::template process_msg<itch50_ipo_quoting_period_update>, sizeof(itch50_ipo_quoting_period_update), true};
+    t.entries['A'] = {&handler::template process_msg<itch50_add_order>,                 sizeof(itch50_add_order),                 true};
+    t.entries['F'] = {&handler::template process_msg<itch50_add_order_mpid>,            sizeof(itch50_add_order_mpid),            true};
+    t.entries['E'] = {&handler::template process_msg<itch50_order_executed>,            sizeof(itch50_order_executed),            true};
+    t.entries['C'] = {&handler::template process_msg<itch50_order_executed_with_price>, sizeof(itch50_order_executed_with_price), true};
+    t.entries['X'] = {&handler::template process_msg<itch50_order_cancel>,              sizeof(itch50_order_cancel),              true};
+    t.entries['D'] = {&handler::template process_msg<itch50_order_delete>,              sizeof(itch50_order_delete),              true};
+    t.entries['U'] = {&handler::template process_msg<itch50_order_replace>,             sizeof(itch50_order_replace),             true};
+    t.entries['P'] = {&handler::template process_msg<itch50_trade>,                     sizeof(itch50_trade),                     true};
+    t.entries['Q'] = {&handler::template process_msg<itch50_cross_trade>,               sizeof(itch50_cross_trade),               true};
+    t.entries['B'] = {&handler::template process_msg<itch50_broken_trade>,              sizeof(itch50_broken_trade),              true};
+    t.entries['I'] = {&handler::template process_msg<itch50_noii>,                      sizeof(itch50_noii),                      true};
+    t.entries['N'] = {&handler::template process_msg<itch50_rpii>,                      sizeof(itch50_rpii),                      true};
+    return t;
+}
+
+template<typename Listener>
+constexpr typename basic_itch50_handler<Listener>::dispatch_table basic_itch50_handler<Listener>::_dispatch_table = basic_itch50_handler<Listener>::make_dispatch_table();
+
+template<typename Listener>
+uint64_t basic_itch50_handler<Listener>::clock() const
+{
+    return itch50_timestamp(_raw_timestamp);
+}
+
+template<typename Listener>
+size_t basic_itch50_handler<Listener>::parse(const net::packet_view& packet)
+{
+#ifdef HELIX_LATENCY
+    uint64_t start = core::read_tsc();
+    size_t nr = dispatch(packet);
+    _latency.record_processing(packet.cast<itch50_message>()->MessageType, core::read_tsc() - start);
+#else
+    size_t nr = dispatch(packet);
+#endif
+    if (_mirror && nr) {
+        _mirror->parse(net::packet_view{packet.buf(), nr});
+    }
+    return nr;
+}
+
+template<typename Listener>
+size_t basic_itch50_handler<Listener>::dispatch(const net::packet_view& packet)
+{
+    auto* msg = packet.cast<itch50_message>();
+    // All messages start with the same header as the system event.
+    auto* header = packet.cast<itch50_system_event>();
+    uint64_t raw_timestamp = header->Timestamp;
+    if (raw_timestamp != _raw_timestamp) {
+        if (_conflate) {
+            deliver();
+        }
+        _raw_timestamp = raw_timestamp;
+    }
+    auto&& entry = _dispatch_table.entries[static_cast<uint8_t>(msg->MessageType)];
+    if (!entry.process) {
+        throw unknown_message_type("unknown type: " + std::string(1, msg->MessageType));
+    }
+    // Most of the feed is for stocks that are not subscribed, which are
+    // skipped without decoding the message.
+    if (entry.filtered && !_books_by_locate[header->StockLocate]) {
+        return entry.size;
+    }
+    return (this->*entry.process)(packet);
+}
+
+template<typename Listener>
+template<typename T>
+size_t basic_itch50_handler<Listener>::process_msg(const net::packet_view& packet)
+{
+    process_msg(packet.cast<T>());
+    return sizeof(T);
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_system_event* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_stock_directory* m)
+{
+    auto it = _subscriptions.find(itch50_symbol_key(m->Stock));
+    if (it == _subscriptions.end() && !_subscribe_all) {
+        return;
+    }
+    auto&& ob = _books_by_locate[m->StockLocate];
+    if (!ob) {
+        std::string symbol{m->Stock, ITCH_SYMBOL_LEN};
+        uint64_t timestamp = itch50_timestamp(m->Timestamp);
+        if (it != _subscriptions.end()) {
+            ob = &new_book(std::move(symbol), timestamp, it->second.max_orders, it->second.levels);
+        } else {
+            ob = &new_book(std::move(symbol), timestamp, 0, _all_levels);
+        }
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_stock_trading_action* m)
+{
+    auto* book = _books_by_locate[m->StockLocate];
+    if (book) {
+        auto& ob = *book;
+
+        switch (m->TradingState) {
+        case 'H': ob.set_state(core::trading_state::halted); break;
+        case 'P': ob.set_state(core::trading_state::paused); break;
+        case 'Q': ob.set_state(core::trading_state::quotation_only); break;
+        case 'T': ob.set_state(core::trading_state::trading); break;
+        default:  _errors.report(core::status::invalid_trading_state, m->TradingState); break;
+        }
+        ob.publish_levels();
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_reg_sho_restriction* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_market_participant_position* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_mwcb_decline_level* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_mwcb_breach* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_ipo_quoting_period_update* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_add_order* m)
+{
+    process_add_order(m);
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_add_order_mpid* m)
+{
+    process_add_order(m);
+}
+
+template<typename Listener>
+template<typename T>
+void basic_itch50_handler<Listener>::process_add_order(const T* m)
+{
+    auto* book = _books_by_locate[m->StockLocate];
+    if (book) {
+        auto& ob = *book;
+
+        core::side_type side;
+        if (!itch50_side(m->BuySellIndicator, side)) {
+            _errors.report(core::status::invalid_side, m->BuySellIndicator);
+            return;
+        }
+        uint64_t order_id = be64toh(m->OrderReferenceNumber);
+        uint32_t price    = be32toh(m->Price);
+        uint32_t quantity = be32toh(m->Shares);
+        uint64_t timestamp = itch50_timestamp(m->Timestamp);
+        core::order o{order_id, price, quantity, side, timestamp};
+        uint32_t slot;
+        if (add_order(ob, m->StockLocate, o, slot) != core::status::ok) {
+            _errors.report(core::status::duplicate_order, order_id);
+            return;
+        }
+        ob.set_timestamp(timestamp);
+        publish(core::order_event_type::add, ob, slot, o, 0);
+        notify(ob);
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_order_executed* m)
+{
+    auto* e = find_order(m->StockLocate, be64toh(m->OrderReferenceNumber));
+    if (e) {
+        uint64_t quantity = be32toh(m->ExecutedShares);
+        uint64_t timestamp = itch50_timestamp(m->Timestamp);
+        auto& ob = *_books_by_locate[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, be64toh(m->OrderReferenceNumber));
+            return;
+        }
+        bool removed = ob.execute_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(timestamp);
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+        publish(core::trade{ob.symbol(), timestamp, o.price, quantity, itch50_trade_sign(o.side)});
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_order_executed_with_price* m)
+{
+    auto* e = find_order(m->StockLocate, be64toh(m->OrderReferenceNumber));
+    if (e) {
+        uint64_t quantity = be32toh(m->ExecutedShares);
+        uint64_t price = be32toh(m->ExecutionPrice);
+        uint64_t timestamp = itch50_timestamp(m->Timestamp);
+        auto& ob = *_books_by_locate[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, be64toh(m->OrderReferenceNumber));
+            return;
+        }
+        bool removed = ob.execute_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(timestamp);
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+        publish(core::trade{ob.symbol(), timestamp, price, quantity, itch50_trade_sign(o.side)});
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_order_cancel* m)
+{
+    auto* e = find_order(m->StockLocate, be64toh(m->OrderReferenceNumber));
+    if (e) {
+        auto& ob = *_books_by_locate[e->value.book];
+        uint32_t slot = e->value.slot;
+        uint64_t quantity = be32toh(m->CanceledShares);
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, be64toh(m->OrderReferenceNumber));
+            return;
+        }
+        bool removed = ob.cancel_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(itch50_timestamp(m->Timestamp));
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+    }
+
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_order_delete* m)
+{
+    auto* e = find_order(m->StockLocate, be64toh(m->OrderReferenceNumber));
+    if (e) {
+        auto& ob = *_books_by_locate[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        ob.remove_at(slot);
+        _orders.erase(e);
+        ob.set_timestamp(itch50_timestamp(m->Timestamp));
+        publish(core::order_event_type::remove, ob, slot, o, o.quantity);
+        notify(ob);
+    }
+
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_order_replace* m)
+{
+    auto* e = find_order(m->StockLocate, be64toh(m->OriginalOrderReferenceNumber));
+    if (e) {
+        auto& ob = *_books_by_locate[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto old = ob.at(slot);
+        ob.remove_at(slot);
+        _orders.erase(e);
+        uint64_t order_id = be64toh(m->NewOrderReferenceNumber);
+        uint32_t price    = be32toh(m->Price);
+        uint32_t quantity = be32toh(m->Shares);
+        uint64_t timestamp = itch50_timestamp(m->Timestamp);
+        ob.set_timestamp(timestamp);
+        publish(core::order_event_type::remove, ob, slot, old, old.quantity);
+        core::order o{order_id, price, quantity, old.side, timestamp};
+        if (add_order(ob, m->StockLocate, o, slot) != core::status::ok) {
+            _errors.report(core::status::duplicate_order, order_id);
+        } else {
+            publish(core::order_event_type::add, ob, slot, o, 0);
+        }
+        notify(ob);
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_trade* m)
+{
+    auto* book = _books_by_locate[m->StockLocate];
+    if (book) {
+        uint64_t trade_price = be32toh(m->Price);
+        uint32_t quantity = be32toh(m->Shares);
+        auto& ob = *book;
+        publish(core::trade{ob.symbol(), itch50_timestamp(m->Timestamp), trade_price, quantity, core::trade_sign::non_displayable});
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_cross_trade* m)
+{
+    auto* book = _books_by_locate[m->StockLocate];
+    if (book) {
+        uint64_t cross_price = be32toh(m->CrossPrice);
+        uint64_t quantity = be64toh(m->Shares);
+        auto& ob = *book;
+        publish(core::trade{ob.symbol(), itch50_timestamp(m->Timestamp), cross_price, quantity, core::trade_sign::crossing});
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_broken_trade* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_noii* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::process_msg(const itch50_rpii* m)
+{
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::notify(core::order_book& ob)
+{
+    ob.publish_levels();
+    if (!ob.depth_changed()) {
+        return;
+    }
+    ob.clear_depth_changed();
+    if (!_conflate) {
+        publish(ob);
+        return;
+    }
+    if (std::find(_dirty.begin(), _dirty.end(), &ob) == _dirty.end()) {
+        _dirty.push_back(&ob);
+    }
+}
+
+template<typename Listener>
+core::order_index<core::order_ref>::entry* basic_itch50_handler<Listener>::find_order(uint16_t stock_locate, uint64_t order_id)
+{
+    auto* e = _orders.find(order_id);
+    if (!e && _books_by_locate[stock_locate]) {
+        _errors.report(core::status::unknown_order, order_id);
+    }
+    return e;
+}
+
+// Books of symbols that are only subscribed by subscribe_all() allocate
+// their orders from the shared pool and are not pre-allocated. Other books
+// pre-allocate their orders and grow the order index to match.
+template<typename Listener>
+core::order_book& basic_itch50_handler<Listener>::new_book(std::string symbol, uint64_t timestamp, size_t max_orders, const core::level_config& levels)
+{
+    if (_subscribe_all && !_subscriptions.count(itch50_symbol_key(symbol.data()))) {
+        _books.emplace_back(std::move(symbol), timestamp, _pool, levels);
+    } else {
+        _books.emplace_back(std::move(symbol), timestamp, max_orders, levels);
+        _max_all_orders += max_orders;
+        _orders.reserve(_max_all_orders);
+    }
+    return _books.back();
+}
+
+template<typename Listener>
+core::status basic_itch50_handler<Listener>::add_order(core::order_book& ob, uint16_t stock_locate, core::order o, uint32_t& slot)
+{
+    uint64_t order_id = o.id;
+    slot = ob.insert(std::move(o));
+    if (!_orders.insert(order_id, core::order_ref{stock_locate, slot})) {
+        ob.remove_at(slot);
+        return core::status::duplicate_order;
+    }
+    return core::status::ok;
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::save(core::snapshot& s) const
+{
+    s.set_clock(std::max(s.clock(), clock()));
+    for (size_t locate = 0; locate < _books_by_locate.size(); locate++) {
+        auto* ob = _books_by_locate[locate];
+        if (ob) {
+            s.add(*ob, locate);
+        }
+    }
+}
+
+template<typename Listener>
+void basic_itch50_handler<Listener>::restore(const core::mapped_snapshot& s, size_t shard, size_t shards)
+{
+    if (!_books.empty()) {
+        throw std::logic_error("order books have already been created");
+    }
+    _raw_timestamp = itch50_raw_timestamp(s.clock());
+    s.for_each_book([&](const core::snapshot::book& b, const core::snapshot::order* orders) {
+        if (b.key >= _books_by_locate.size()) {
+            throw std::invalid_argument(std::string("invalid stock locate: ") + std::to_string(b.key));
+        }
+        if (itch50_shard(static_cast<uint16_t>(b.key), shards) != shard) {
+            return;
+        }
+        auto&& ob = new_book(std::string{b.symbol}, b.timestamp, b.max_orders, core::snapshot::levels(b));
+        _books_by_locate[b.key] = &ob;
+        ob.set_state(static_cast<core::trading_state>(b.state));
+        for (uint64_t i = 0; i < b.order_count; i++) {
+            uint64_t order_id = orders[i].id;
+            uint32_t slot;
+            if (add_order(ob, b.key, core::snapshot::to_order(orders[i]), slot) != core::status::ok) {
+                throw std::invalid_argument(std::string("duplicate order id: ") + std::to_string(order_id));
+            }
+        }
+        ob.clear_depth_changed();
+        ob.publish_levels();
+    });
+}
+
+using itch50_handler = basic_itch50_handler<core::callback_listener>;
+
+extern template class basic_itch50_handler<core::callback_listener>;
+
 }
 
 }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace helix {
+
+namespace nasdaq {
+
+// Sidecar index of an ITCH 5.0 BinaryFILE.
+//
+// The index lets applications replay a time range of a few symbols without
+// parsing the whole file. It consists of:
+//
+//   - time checkpoints that map a timestamp to the offset of the first
+//     BinaryFILE record at or after it, taken at a fixed interval, and
+//
+//   - the offsets of the BinaryFILE records of every stock locate code in
+//     file order, together with the symbol that the stock directory
+//     message assigned to the locate code.
+//
+// Offsets point to the length prefix of a record, so a record can be passed
+// to a BinaryFILE session as is. The index is mapped from its file and used
+// in place.
+class itch50_index {
+public:
+    static constexpr uint32_t version = 1;
+
+    //! Default distance between time checkpoints (one second).
+    static constexpr uint64_t default_interval = 1000000000;
+
+    struct header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t locate_count;
+        uint64_t file_size;
+        uint64_t interval;
+        uint64_t checkpoint_count;
+        uint64_t offset_count;
+    };
+
+    struct checkpoint {
+        uint64_t timestamp;
+        uint64_t offset;
+    };
+
+    struct locate {
+        char     symbol[8];
+        uint64_t first;
+        uint64_t count;
+    };
+private:
+    const char* _data;
+    size_t _size;
+public:
+    // Maps an index file. Throws std::system_error if the file cannot be
+    // mapped and std::runtime_error if it is not a valid index.
+    explicit itch50_index(const std::string& path);
+    ~itch50_index();
+
+    itch50_index(const itch50_index&) = delete;
+    itch50_index& operator=(const itch50_index&) = delete;
+
+    // Scans a BinaryFILE and writes its index. Throws std::system_error on
+    // I/O errors and std::runtime_error if the file is malformed.
+    static void build(const std::string& input, const std::string& output,
+                      uint64_t interval = default_interval);
+
+    // Size of the indexed file.
+    uint64_t file_size() const {
+        return hdr().file_size;
+    }
+
+    // Returns the offset of a record at or before the first record whose
+    // timestamp is at or after \p timestamp.
+    uint64_t seek(uint64_t timestamp) const;
+
+    // Returns the offsets of the records of a symbol in file order and sets
+    // \p count to their number. Returns nullptr if the symbol does not
+    // appear in the file.
+    const uint64_t* offsets(const std::string& symbol, size_t& count) const;
+private:
+    const header& hdr() const {
+        return *reinterpret_cast<const header*>(_data);
+    }
+
+    const checkpoint* checkpoints() const {
+        return reinterpret_cast<const checkpoint*>(_data + sizeof(header));
+    }
+
+    const locate* locates() const {
+        return reinterpret_cast<const locate*>(checkpoints() + hdr().checkpoint_count);
+    }
+
+    const uint64_t* all_offsets() const {
+        return reinterpret_cast<const uint64_t*>(locates() + hdr().locate_count);
+    }
+
+    void validate() const;
+};
+
+}
+
+}
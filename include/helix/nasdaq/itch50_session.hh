@@ -3,15 +3,21 @@
 #include "helix/helix.hh"
 #include "helix/net.hh"
 
+#include <condition_variable>
 #include <memory>
+#include <atomic>
 #include <vector>
 #include <string>
+#include <mutex>
 
 namespace helix {
 
 namespace nasdaq {
 
-class itch50_handler;
+template<typename Listener>
+class basic_itch50_handler;
+
+using itch50_handler = basic_itch50_handler<core::callback_listener>;
 
 class itch50_session : public core::session {
 private:
@@ -19,10 +25,87 @@ private:
     std::shared_ptr<net::message_parser> _transport_session;
 public:
     itch50_session(std::shared_ptr<itch50_handler>, std::shared_ptr<net::message_parser>, void *data);
-    virtual void subscribe(const std::string& symbol, size_t max_orders) override;
+    virtual void subscribe(const std::string& symbol, size_t max_orders,
+                           const core::level_config& levels = core::level_config{}) override;
+    virtual void subscribe_all(size_t max_orders,
+                               const core::level_config& levels = core::level_config{}) override;
+    virtual void set_conflation(bool enabled) override;
+    virtual void register_callback(core::ob_callback process_ob) override;
+    virtual void register_callback(core::trade_callback process_trade) override;
+    virtual void register_callback(core::order_callback process_order) override;
+    virtual void set_retransmit_callback(core::retransmit_callback retransmit) override;
+    virtual uint64_t clock() const override;
+    virtual uint64_t packet_time(const net::packet_view& packet) const override;
+    virtual void set_mirror(std::shared_ptr<net::message_parser> mirror) override;
+    virtual void set_rx_timestamp(uint64_t timestamp) override;
+    virtual const core::latency_stats* latency() const override;
+    virtual void set_error_callback(core::error_callback process_error) override;
+    virtual void set_strict(bool strict) override;
+    virtual uint64_t error_count(core::status s) const override;
+    virtual size_t memory_usage() const override;
+    virtual core::status position(uint64_t order_id, core::queue_position& pos) const override;
+    virtual void save(core::snapshot& s) const override;
+    virtual void restore(const core::mapped_snapshot& s) override;
+    virtual size_t process_packet(const net::packet_view& packet) override;
+    virtual size_t process_packets(const net::packet_view* packets, size_t count) override;
+};
+
+// Parallel replay of an ITCH 5.0 BinaryFILE.
+//
+// The calling thread splits the file into BinaryFILE records and hands each
+// record over a single-producer single-consumer queue to one of the worker
+// threads. Records are assigned to workers by StockLocate, so every worker
+// owns a disjoint set of order books and the messages of a symbol are
+// processed in file order by the same thread. Messages without a stock
+// locate code carry no order book state and go to the first worker.
+//
+// The workers are started when the session is created and wait for work
+// between calls. process_packet() replays every record in the buffer and
+// returns when all workers have processed their records, so the session
+// cannot be paced with core::replay_clock. process_packets() hands the
+// whole batch to the workers at once. Callbacks, including the error
+// callback, are invoked concurrently from the worker threads. If workers
+// fail, the error of the first failed shard is rethrown once all workers
+// are done and the errors of the other shards are discarded.
+class itch50_sharded_session : public core::session {
+private:
+    struct shard;
+    std::vector<std::unique_ptr<shard>> _shards;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    //! Number of the current batch, which workers wait to change.
+    uint64_t _epoch;
+    //! Number of workers that have not finished the current batch.
+    size_t _running;
+    bool _stop;
+    //! Has the last record of the current batch been queued?
+    std::atomic<bool> _done;
+    //! Has a worker failed in the current batch?
+    std::atomic<bool> _failed;
+    size_t dispatch(const net::packet_view& packet);
+    void stop();
+public:
+    itch50_sharded_session(size_t shards, void *data);
+    ~itch50_sharded_session();
+    virtual void subscribe(const std::string& symbol, size_t max_orders,
+                           const core::level_config& levels = core::level_config{}) override;
+    virtual void subscribe_all(size_t max_orders,
+                               const core::level_config& levels = core::level_config{}) override;
+    virtual void set_conflation(bool enabled) override;
     virtual void register_callback(core::ob_callback process_ob) override;
     virtual void register_callback(core::trade_callback process_trade) override;
+    virtual void register_callback(core::order_callback process_order) override;
+    virtual void set_retransmit_callback(core::retransmit_callback retransmit) override;
+    virtual uint64_t clock() const override;
+    virtual void set_error_callback(core::error_callback process_error) override;
+    virtual void set_strict(bool strict) override;
+    virtual uint64_t error_count(core::status s) const override;
+    virtual size_t memory_usage() const override;
+    virtual core::status position(uint64_t order_id, core::queue_position& pos) const override;
+    virtual void save(core::snapshot& s) const override;
+    virtual void restore(const core::mapped_snapshot& s) override;
     virtual size_t process_packet(const net::packet_view& packet) override;
+    virtual size_t process_packets(const net::packet_view* packets, size_t count) override;
 };
 
 class itch50_protocol : public core::protocol {
@@ -32,6 +115,7 @@ public:
         : _name{std::move(name)}
     { }
     virtual itch50_session* new_session(void *) override;
+    virtual itch50_sharded_session* new_sharded_session(size_t shards, void *) override;
 };
 
 }
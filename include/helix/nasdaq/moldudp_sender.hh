@@ -0,0 +1,95 @@
+#pragma once
+
+#include "helix/nasdaq/moldudp_messages.h"
+#include "helix/net.hh"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace helix {
+
+namespace nasdaq {
+
+/// \brief Configuration of a MoldUDP multicast sender.
+struct moldudp_sender_config {
+    /// Multicast group to send to.
+    std::string multicast_addr;
+    /// Address of the local interface to send from. Empty lets the kernel
+    /// choose.
+    std::string interface_addr;
+    /// UDP port to send to.
+    uint16_t port = 0;
+    /// Time-to-live of multicast datagrams.
+    int ttl = 1;
+    /// Deliver datagrams to receivers on the local host as well.
+    bool loopback = true;
+    /// MoldUDP session name, padded with spaces to ten characters.
+    std::string session;
+    /// Maximum size of a datagram, including the MoldUDP header.
+    size_t max_packet_size = 1400;
+};
+
+/// \brief MoldUDP multicast sender.
+///
+/// The sender is a message parser that frames the messages passed to
+/// parse() as MoldUDP message blocks and sends them as one packet when it
+/// is flushed, or earlier if the next message would not fit in
+/// moldudp_sender_config::max_packet_size. Sequence numbers start at one.
+/// The packet format is the one that moldudp_session parses, so a session
+/// of the same protocol can receive the packets with net::udp_receiver.
+///
+/// Passed to core::session::set_mirror(), the sender re-emits a replayed
+/// file as a multicast feed with one packet per record of the file, or
+/// with the packetization of the original feed for MoldUDP input.
+class moldudp_sender : public net::message_parser {
+    int _fd;
+    struct sockaddr_in _addr;
+    char _session[sizeof(moldudp_header::Session)];
+    //! Sequence number of the first message of the pending packet.
+    uint32_t _seq_num;
+    //! Number of messages in the pending packet.
+    uint16_t _count;
+    uint64_t _packet_count;
+    std::vector<char> _packet;
+    size_t _len;
+public:
+    /// Opens a socket for sending to the multicast group. Throws
+    /// std::system_error on failure and std::invalid_argument if the
+    /// configuration is invalid.
+    explicit moldudp_sender(const moldudp_sender_config& config);
+    ~moldudp_sender();
+
+    moldudp_sender(const moldudp_sender&) = delete;
+    moldudp_sender& operator=(const moldudp_sender&) = delete;
+
+    /// Appends a message to the pending packet. Throws
+    /// std::invalid_argument if the message does not fit in a packet of its
+    /// own and std::system_error if sending fails.
+    virtual size_t parse(const net::packet_view& message) override;
+
+    /// Sends the pending packet, if it has any messages.
+    virtual void flush() override;
+
+    /// Sends the pending packet and an end of session packet.
+    void end_session();
+
+    /// Returns the sequence number of the next message to be sent.
+    uint32_t seq_num() const {
+        return _seq_num + _count;
+    }
+
+    /// Returns the number of packets sent.
+    uint64_t packet_count() const {
+        return _packet_count;
+    }
+private:
+    void send(uint16_t count);
+};
+
+}
+
+}
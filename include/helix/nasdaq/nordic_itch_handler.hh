@@ -1,13 +1,22 @@
 #pragma once
 
 #include "helix/nasdaq/nordic_itch_messages.h"
+#include "helix/order_index.hh"
+#include "helix/ascii.hh"
 #include "helix/order_book.hh"
+#include "helix/latency.hh"
+#include "helix/snapshot.hh"
 #include "helix/helix.hh"
 #include "helix/net.hh"
 
 #include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <memory>
+#include <deque>
 #include <set>
 
 namespace helix {
@@ -23,8 +32,9 @@ namespace nasdaq {
 // The feed handler reconstructs a full depth order book from a ITCH message
 // flow using an algorithm that is specified in Appendix A of the protocol
 // specification. As not all messages include an order book ID, the handler
-// keeps mapping from every order ID it encounters to the order book the order
-// is part of.
+// keeps a single index from the ID of every resting order in a subscribed
+// order book to the book and the pool slot of the order. Orders leave the
+// index when they are fully executed or deleted.
 //
 // The ITCH variant processed by this feed handler is specified by NASDAQ OMX
 // in:
@@ -33,24 +43,58 @@ namespace nasdaq {
 //   Version 1.90.2
 //   April 7, 2014
 //
-class nordic_itch_handler : public net::message_parser {
+// The handler delivers order book and trade events to a listener that is a
+// compile-time parameter (see core::callback_listener for the interface).
+// The nordic_itch_handler alias dispatches events through std::function and
+// is what the C API uses.
+//
+template<typename Listener>
+class basic_nordic_itch_handler : public net::message_parser {
 private:
     //! Seconds since midnight in CET (Central European Time).
     uint64_t time_sec;
     //! Milliseconds since @time_sec.
     uint64_t time_msec;
-    //! Callback function for processing order book events.
-    core::ob_callback _process_ob;
-    //! Callback function for processing trade events.
-    core::trade_callback _process_trade;
-    //! A map of order books by order book ID.
-    std::unordered_map<uint64_t, helix::core::order_book> order_book_id_map;
-    //! A map of order books by order ID.
-    std::unordered_map<uint64_t, helix::core::order_book&> order_id_map;
+    //! Listener that order book and trade events are delivered to.
+    Listener _listener;
+#ifdef HELIX_LATENCY
+    //! Per-message processing time and wire-to-callback latency.
+    core::latency_stats _latency;
+#endif
+    //! Are order book updates conflated?
+    bool _conflate;
+    //! Is a batch of packets being processed?
+    bool _batch;
+    //! Order books that have changed since updates were last delivered.
+    std::vector<helix::core::order_book*> _dirty;
+    //! Order pool that the books of symbols that are only subscribed by
+    //! subscribe_all() share. It outlives the books.
+    core::order_pool _pool;
+    //! Order books of subscribed symbols. Books are never removed, so
+    //! pointers to them stay valid for the lifetime of the handler.
+    std::deque<helix::core::order_book> _books;
+    //! A map of indexes into _books by order book ID.
+    std::unordered_map<uint64_t, uint32_t> order_book_id_map;
+    //! An index of orders in subscribed order books by order ID, which is
+    //! unique across all order books.
+    core::order_index<core::order_ref> _orders;
     //! A set of symbols that we are interested in.
     std::set<std::string> _symbols;
     //! A map of pre-allocation size by symbol.
     std::unordered_map<std::string, size_t> _symbol_max_orders;
+    //! A map of price level storage configuration by symbol.
+    std::unordered_map<std::string, core::level_config> _symbol_levels;
+    //! Is every symbol of the feed subscribed?
+    bool _subscribe_all;
+    //! Price level storage configuration of symbols that are only
+    //! subscribed by subscribe_all().
+    core::level_config _all_levels;
+    //! Sum of the pre-allocation sizes of all subscriptions.
+    size_t _max_all_orders;
+    //! Messages that were dropped because they could not be applied.
+    core::error_reporter _errors;
+    //! Parser that every processed message is re-emitted to, if any.
+    std::shared_ptr<net::message_parser> _mirror;
 public:
     class unknown_message_type : public std::logic_error {
     public:
@@ -59,30 +103,134 @@ public:
         { }
     };
 public:
-    nordic_itch_handler()
+    explicit basic_nordic_itch_handler(Listener listener = Listener{})
+        : time_sec{0}
+        , time_msec{0}
+        , _listener{std::move(listener)}
+        , _conflate{false}
+        , _batch{false}
+        , _subscribe_all{false}
+        , _max_all_orders{0}
     {
     }
-    void subscribe(std::string sym, size_t max_orders) {
+    Listener& listener() {
+        return _listener;
+    }
+    void subscribe(std::string sym, size_t max_orders, const core::level_config& levels = core::level_config{}) {
         auto padding = ITCH_SYMBOL_LEN - sym.size();
         if (padding > 0) {
             sym.insert(sym.size(), padding, ' ');
         }
-        _symbols.insert(sym);
-        _symbol_max_orders.emplace(sym, max_orders);
-        size_t max_all_orders = 0;
-        for (auto&& kv : _symbol_max_orders) {
-            max_all_orders += kv.second;
+        if (_symbols.insert(sym).second) {
+            _symbol_max_orders.emplace(sym, max_orders);
+            _symbol_levels.emplace(sym, levels);
+            _max_all_orders += max_orders;
+            _orders.reserve(_max_all_orders);
+        }
+    }
+    //! Subscribes to every symbol of the feed. Symbols that are not also
+    //! subscribed individually share one order pool, which is sized once
+    //! for \p max_orders resting orders across all of them.
+    void subscribe_all(size_t max_orders, const core::level_config& levels = core::level_config{}) {
+        _subscribe_all = true;
+        _all_levels = levels;
+        _pool.reserve(max_orders);
+        _max_all_orders += max_orders;
+        _orders.reserve(_max_all_orders);
+    }
+    void set_conflation(bool enabled) {
+        if (!enabled) {
+            deliver();
         }
-        order_id_map.reserve(max_all_orders);
+        _conflate = enabled;
     }
-    void register_callback(core::ob_callback process_ob) {
-        _process_ob = process_ob;
+    //! Starts a batch of packets. Conflated updates are not delivered at
+    //! packet boundaries until end_batch() is called.
+    void begin_batch() {
+        _batch = true;
     }
-    void register_callback(core::trade_callback process_trade) {
-        _process_trade = process_trade;
+    //! Ends a batch of packets and delivers conflated updates.
+    void end_batch() {
+        _batch = false;
+        deliver();
     }
     virtual size_t parse(const net::packet_view& packet) override;
+    virtual void flush() override {
+        if (!_batch) {
+            deliver();
+        }
+        if (_mirror) {
+            _mirror->flush();
+        }
+    }
+    //! Re-emits every processed message to \p mirror, which is flushed
+    //! whenever the handler is.
+    void set_mirror(std::shared_ptr<net::message_parser> mirror) {
+        _mirror = std::move(mirror);
+    }
+    //! Registers a callback that is invoked for every message that is
+    //! dropped because it cannot be applied to the order books.
+    void set_error_callback(core::error_callback process_error) {
+        _errors.set_callback(std::move(process_error));
+    }
+    //! Throws std::invalid_argument for dropped messages instead of
+    //! reporting them. Meant for debugging.
+    void set_strict(bool strict) {
+        _errors.set_strict(strict);
+    }
+    //! Number of dropped messages with error status \p s.
+    uint64_t error_count(core::status s) const {
+        return _errors.count(s);
+    }
+    //! Queue position of a resting order in an order book that keeps
+    //! order queues.
+    core::status position(uint64_t order_id, core::queue_position& pos) const {
+        auto* e = _orders.find(order_id);
+        if (!e) {
+            return core::status::unknown_order;
+        }
+        pos = _books[e->value.book].position_at(e->value.slot);
+        return core::status::ok;
+    }
+    //! Number of bytes of memory that the order books and the order index
+    //! use.
+    size_t memory_usage() const {
+        size_t size = _orders.memory_usage();
+        for (auto&& ob : _books) {
+            size += ob.memory_usage();
+        }
+        // Books count their orders in the shared pool, so only the
+        // unused part of the pool is added.
+        return size + _pool.memory_usage() - _pool.size() * sizeof(core::order);
+    }
+    //! Timestamp of the last seconds or milliseconds message in
+    //! milliseconds since midnight.
+    uint64_t clock() const {
+        return timestamp();
+    }
+    //! Sets the receive timestamp in nanoseconds since the epoch of the
+    //! packet that is parsed next, or zero if it has none.
+    void set_rx_timestamp(uint64_t timestamp) {
+#ifdef HELIX_LATENCY
+        _latency.set_rx_timestamp(timestamp);
+#endif
+    }
+    //! Latency statistics, or \c nullptr if the handler is not built with
+    //! HELIX_LATENCY defined.
+    const core::latency_stats* latency() const {
+#ifdef HELIX_LATENCY
+        return &_latency;
+#else
+        return nullptr;
+#endif
+    }
+    //! Appends all order books to a snapshot, keyed by order book ID.
+    void save(core::snapshot& s) const;
+    //! Restores order books from a snapshot into a handler that has not
+    //! created any order books.
+    void restore(const core::mapped_snapshot& s);
 private:
+    size_t dispatch(const net::packet_view& packet);
     template<typename T>
     size_t process_msg(const net::packet_view& packet);
     void process_msg(const itch_seconds* m);
@@ -102,12 +250,454 @@ private:
     void process_msg(const itch_broken_trade* m);
     void process_msg(const itch_noii* m);
 
+    void notify(core::order_book& ob);
+    core::order_book* find_book(uint64_t order_book_id);
+    void new_book(std::string symbol, uint64_t timestamp, size_t max_orders, const core::level_config& levels);
+    core::status add_order(uint32_t book, core::order o, uint32_t& slot);
+    template<typename T>
+    void process_add_order(const T* m);
+    void publish(const core::order_book& ob) {
+#ifdef HELIX_LATENCY
+        _latency.record_wire();
+#endif
+        _listener.on_order_book(ob);
+    }
+    void publish(const core::trade& t) {
+#ifdef HELIX_LATENCY
+        _latency.record_wire();
+#endif
+        _listener.on_trade(t);
+    }
+    //! Delivers an order event if the order book keeps order queues.
+    void publish(core::order_event_type type, const core::order_book& ob, uint32_t slot,
+                 const core::order& o, uint64_t previous_quantity) {
+        if (ob.levels().order_queues) {
+#ifdef HELIX_LATENCY
+            _latency.record_wire();
+#endif
+            _listener.on_order(core::order_event{type, ob, slot, o, previous_quantity});
+        }
+    }
+    //! Delivers the modification or removal of an order whose quantity was
+    //! reduced from \p o.
+    void publish_reduced(const core::order_book& ob, uint32_t slot, const core::order& o, bool removed) {
+        if (removed) {
+            publish(core::order_event_type::remove, ob, slot, o, o.quantity);
+        } else {
+            publish(core::order_event_type::modify, ob, slot, ob.at(slot), o.quantity);
+        }
+    }
+    //! Delivers order books that have changed since updates were last
+    //! delivered.
+    void deliver() {
+        for (auto* ob : _dirty) {
+            publish(*ob);
+        }
+        _dirty.clear();
+    }
+
     //! Timestamp in milliseconds
     inline uint64_t timestamp() const {
         return time_sec * 1000 + time_msec;
     }
 };
 
+//! Decodes a buy/sell indicator. Returns \c false if it is invalid.
+inline bool itch_side(char c, core::side_type& side)
+{
+    switch (c) {
+    case 'B': side = core::side_type::buy;  return true;
+    case 'S': side = core::side_type::sell; return true;
+    default:  return false;
+    }
+}
+
+inline core::trade_sign itch_trade_sign(core::side_type s)
+{
+    return s == core::side_type::buy ? core::trade_sign::seller_initiated : core::trade_sign::buyer_initiated;
+}
+
+template<typename Listener>
+size_t basic_nordic_itch_handler<Listener>::parse(const net::packet_view& packet)
+{
+#ifdef HELIX_LATENCY
+    uint64_t start = core::read_tsc();
+    size_t nr = dispatch(packet);
+    _latency.record_processing(packet.cast<itch_message>()->MsgType, core::read_tsc() - start);
+#else
+    size_t nr = dispatch(packet);
+#endif
+    if (_mirror && nr) {
+        _mirror->parse(net::packet_view{packet.buf(), nr});
+    }
+    return nr;
+}
+
+template<typename Listener>
+size_t basic_nordic_itch_handler<Listener>::dispatch(const net::packet_view& packet)
+{
+    auto* msg = packet.cast<itch_message>();
+    switch (msg->MsgType) {
+    case 'T': return process_msg<itch_seconds>(packet);
+    case 'M': return process_msg<itch_milliseconds>(packet);
+    case 'O': return process_msg<itch_market_segment_state>(packet);
+    case 'S': return process_msg<itch_system_event>(packet);
+    case 'R': return process_msg<itch_order_book_directory>(packet);
+    case 'H': return process_msg<itch_order_book_trading_action>(packet);
+    case 'A': return process_msg<itch_add_order>(packet);
+    case 'F': return process_msg<itch_add_order_mpid>(packet);
+    case 'E': return process_msg<itch_order_executed>(packet);
+    case 'C': return process_msg<itch_order_executed_with_price>(packet);
+    case 'X': return process_msg<itch_order_cancel>(packet);
+    case 'D': return process_msg<itch_order_delete>(packet);
+    case 'P': return process_msg<itch_trade>(packet);
+    case 'Q': return process_msg<itch_cross_trade>(packet);
+    case 'B': return process_msg<itch_broken_trade>(packet);
+    case 'I': return process_msg<itch_noii>(packet);
+    default:  throw unknown_message_type("unknown type: " + std::string(1, msg->MsgType));
+    }
+}
+
+template<typename Listener>
+template<typename T>
+size_t basic_nordic_itch_handler<Listener>::process_msg(const net::packet_view& packet)
+{
+    process_msg(packet.cast<T>());
+    return sizeof(T);
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_seconds* m)
+{
+    auto second = core::decode_decimal(m->Second);
+    if (_conflate) {
+        deliver();
+    }
+    time_sec = second;
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_milliseconds* m)
+{
+    auto millisecond = core::decode_decimal(m->Millisecond);
+    if (_conflate) {
+        deliver();
+    }
+    time_msec = millisecond;
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_market_segment_state* m)
+{
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_system_event* m)
+{
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_book_directory* m)
+{
+    auto order_book_id = core::decode_decimal(m->OrderBook);
+
+    std::string sym{m->Symbol, ITCH_SYMBOL_LEN};
+    if (order_book_id_map.count(order_book_id)) {
+        return;
+    }
+    if (_symbols.count(sym) > 0) {
+        new_book(sym, timestamp(), _symbol_max_orders.at(sym), _symbol_levels.at(sym));
+    } else if (_subscribe_all) {
+        new_book(sym, timestamp(), 0, _all_levels);
+    } else {
+        return;
+    }
+    order_book_id_map.emplace(order_book_id, _books.size() - 1);
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_book_trading_action* m)
+{
+    auto* book = find_book(core::decode_decimal(m->OrderBook));
+    if (book) {
+        auto& ob = *book;
+
+        switch (m->TradingState) {
+        case 'H': ob.set_state(core::trading_state::halted ); break;
+        case 'T': ob.set_state(core::trading_state::trading); break;
+        case 'Q': ob.set_state(core::trading_state::auction); break;
+        default : _errors.report(core::status::invalid_trading_state, m->TradingState); break;
+        }
+        ob.set_timestamp(timestamp());
+        ob.publish_levels();
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_add_order* m)
+{
+    process_add_order(m);
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_add_order_mpid* m)
+{
+    process_add_order(m);
+}
+
+template<typename Listener>
+template<typename T>
+void basic_nordic_itch_handler<Listener>::process_add_order(const T* m)
+{
+    auto order_book_id = core::decode_decimal(m->OrderBook);
+    auto it = order_book_id_map.find(order_book_id);
+    if (it != order_book_id_map.end()) {
+        auto& ob = _books[it->second];
+
+        core::side_type side;
+        if (!itch_side(m->BuySellIndicator, side)) {
+            _errors.report(core::status::invalid_side, m->BuySellIndicator);
+            return;
+        }
+        uint64_t order_id = core::decode_decimal(m->OrderReferenceNumber);
+        uint64_t price    = core::decode_decimal(m->Price);
+        uint32_t quantity = core::decode_decimal(m->Quantity);
+        if (price > core::order::max_price) {
+            _errors.report(core::status::invalid_price, order_id);
+            return;
+        }
+
+        core::order o{order_id, static_cast<uint32_t>(price), quantity, side, timestamp()};
+        uint32_t slot;
+        if (add_order(it->second, o, slot) != core::status::ok) {
+            _errors.report(core::status::duplicate_order, order_id);
+            return;
+        }
+        ob.set_timestamp(timestamp());
+        publish(core::order_event_type::add, ob, slot, o, 0);
+        notify(ob);
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_executed* m)
+{
+    uint64_t order_id = core::decode_decimal(m->OrderReferenceNumber);
+    auto* e = _orders.find(order_id);
+    if (e) {
+        uint64_t quantity = core::decode_decimal(m->ExecutedQuantity);
+        auto& ob = _books[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, order_id);
+            return;
+        }
+        bool removed = ob.execute_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(timestamp());
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+        publish(core::trade{ob.symbol(), timestamp(), o.price, quantity, itch_trade_sign(o.side)});
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_executed_with_price* m)
+{
+    uint64_t order_id = core::decode_decimal(m->OrderReferenceNumber);
+    auto* e = _orders.find(order_id);
+    if (e) {
+        uint64_t quantity = core::decode_decimal(m->ExecutedQuantity);
+        uint64_t price = core::decode_decimal(m->TradePrice);
+        auto& ob = _books[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, order_id);
+            return;
+        }
+        bool removed = ob.execute_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(timestamp());
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+        publish(core::trade{ob.symbol(), timestamp(), price, quantity, itch_trade_sign(o.side)});
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_cancel* m)
+{
+    uint64_t order_id = core::decode_decimal(m->OrderReferenceNumber);
+    auto* e = _orders.find(order_id);
+    if (e) {
+        uint64_t quantity = core::decode_decimal(m->CanceledQuantity);
+        auto& ob = _books[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        if (quantity > o.quantity) {
+            _errors.report(core::status::invalid_quantity, order_id);
+            return;
+        }
+        bool removed = ob.cancel_at(slot, quantity);
+        if (removed) {
+            _orders.erase(e);
+        }
+        ob.set_timestamp(timestamp());
+        publish_reduced(ob, slot, o, removed);
+        notify(ob);
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_order_delete* m)
+{
+    uint64_t order_id = core::decode_decimal(m->OrderReferenceNumber);
+    auto* e = _orders.find(order_id);
+    if (e) {
+        auto& ob = _books[e->value.book];
+        uint32_t slot = e->value.slot;
+        auto o = ob.at(slot);
+        ob.remove_at(slot);
+        _orders.erase(e);
+        ob.set_timestamp(timestamp());
+        publish(core::order_event_type::remove, ob, slot, o, o.quantity);
+        notify(ob);
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_trade* m)
+{
+    auto* book = find_book(core::decode_decimal(m->OrderBook));
+    if (book) {
+        uint64_t trade_price = core::decode_decimal(m->TradePrice);
+        uint64_t quantity = core::decode_decimal(m->Quantity);
+        auto& ob = *book;
+        publish(core::trade{ob.symbol(), timestamp(), trade_price, quantity, core::trade_sign::non_displayable});
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_cross_trade* m)
+{
+    auto* book = find_book(core::decode_decimal(m->OrderBook));
+    if (book) {
+        uint64_t cross_price = core::decode_decimal(m->CrossPrice);
+        uint64_t quantity = core::decode_decimal(m->Quantity);
+        auto& ob = *book;
+        publish(core::trade{ob.symbol(), timestamp(), cross_price, quantity, core::trade_sign::crossing});
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_broken_trade* m)
+{
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::process_msg(const itch_noii* m)
+{
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::notify(core::order_book& ob)
+{
+    ob.publish_levels();
+    if (!ob.depth_changed()) {
+        return;
+    }
+    ob.clear_depth_changed();
+    if (!_conflate) {
+        publish(ob);
+        return;
+    }
+    if (std::find(_dirty.begin(), _dirty.end(), &ob) == _dirty.end()) {
+        _dirty.push_back(&ob);
+    }
+}
+
+template<typename Listener>
+core::order_book* basic_nordic_itch_handler<Listener>::find_book(uint64_t order_book_id)
+{
+    auto it = order_book_id_map.find(order_book_id);
+    if (it == order_book_id_map.end()) {
+        return nullptr;
+    }
+    return &_books[it->second];
+}
+
+// Books of symbols that are only subscribed by subscribe_all() allocate
+// their orders from the shared pool and are not pre-allocated.
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::new_book(std::string symbol, uint64_t timestamp, size_t max_orders, const core::level_config& levels)
+{
+    if (_subscribe_all && !_symbols.count(symbol)) {
+        _books.emplace_back(std::move(symbol), timestamp, _pool, levels);
+    } else {
+        _books.emplace_back(std::move(symbol), timestamp, max_orders, levels);
+    }
+}
+
+template<typename Listener>
+core::status basic_nordic_itch_handler<Listener>::add_order(uint32_t book, core::order o, uint32_t& slot)
+{
+    auto& ob = _books[book];
+    uint64_t order_id = o.id;
+    slot = ob.insert(std::move(o));
+    if (!_orders.insert(order_id, core::order_ref{book, slot})) {
+        ob.remove_at(slot);
+        return core::status::duplicate_order;
+    }
+    return core::status::ok;
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::save(core::snapshot& s) const
+{
+    s.set_clock(timestamp());
+    for (auto&& kv : order_book_id_map) {
+        s.add(_books[kv.second], kv.first);
+    }
+}
+
+template<typename Listener>
+void basic_nordic_itch_handler<Listener>::restore(const core::mapped_snapshot& s)
+{
+    if (!order_book_id_map.empty()) {
+        throw std::logic_error("order books have already been created");
+    }
+    time_sec = s.clock() / 1000;
+    time_msec = s.clock() % 1000;
+    s.for_each_book([&](const core::snapshot::book& b, const core::snapshot::order* orders) {
+        if (!order_book_id_map.emplace(b.key, _books.size()).second) {
+            throw std::invalid_argument(std::string("duplicate order book id: ") + std::to_string(b.key));
+        }
+        new_book(std::string{b.symbol}, b.timestamp, b.max_orders, core::snapshot::levels(b));
+        auto&& ob = _books.back();
+        ob.set_state(static_cast<core::trading_state>(b.state));
+        _orders.reserve(_orders.size() + b.order_count);
+        for (uint64_t i = 0; i < b.order_count; i++) {
+            uint64_t order_id = orders[i].id;
+            uint32_t slot;
+            if (add_order(_books.size() - 1, core::snapshot::to_order(orders[i]), slot) != core::status::ok) {
+                throw std::invalid_argument(std::string("duplicate order id: ") + std::to_string(order_id));
+            }
+        }
+        ob.clear_depth_changed();
+        ob.publish_levels();
+    });
+}
+
+using nordic_itch_handler = basic_nordic_itch_handler<core::callback_listener>;
+
+extern template class basic_nordic_itch_handler<core::callback_listener>;
+
 }
 
 }
@@ -11,18 +11,45 @@ namespace helix {
 
 namespace nasdaq {
 
-class nordic_itch_handler;
+template<typename Listener>
+class basic_nordic_itch_handler;
+
+using nordic_itch_handler = basic_nordic_itch_handler<core::callback_listener>;
+
+class moldudp_arbiter;
 
 class nordic_itch_session : public core::session {
 private:
     std::shared_ptr<nordic_itch_handler> _handler;
     std::shared_ptr<net::message_parser> _transport_session;
+    //! A/B line arbiter if the transport protocol is MoldUDP.
+    std::shared_ptr<moldudp_arbiter> _arbiter;
 public:
     nordic_itch_session(std::shared_ptr<nordic_itch_handler>, std::shared_ptr<net::message_parser>, void *data);
-    virtual void subscribe(const std::string& symbol, size_t max_orders) override;
+    virtual void subscribe(const std::string& symbol, size_t max_orders,
+                           const core::level_config& levels = core::level_config{}) override;
+    virtual void subscribe_all(size_t max_orders,
+                               const core::level_config& levels = core::level_config{}) override;
+    virtual void set_conflation(bool enabled) override;
     virtual void register_callback(core::ob_callback process_ob) override;
     virtual void register_callback(core::trade_callback process_trade) override;
+    virtual void register_callback(core::order_callback process_order) override;
+    virtual void set_retransmit_callback(core::retransmit_callback retransmit) override;
+    virtual uint64_t clock() const override;
+    virtual uint64_t packet_time(const net::packet_view& packet) const override;
+    virtual void set_mirror(std::shared_ptr<net::message_parser> mirror) override;
+    virtual void set_rx_timestamp(uint64_t timestamp) override;
+    virtual const core::latency_stats* latency() const override;
+    virtual void set_error_callback(core::error_callback process_error) override;
+    virtual void set_strict(bool strict) override;
+    virtual uint64_t error_count(core::status s) const override;
+    virtual size_t memory_usage() const override;
+    virtual core::status position(uint64_t order_id, core::queue_position& pos) const override;
+    virtual void save(core::snapshot& s) const override;
+    virtual void restore(const core::mapped_snapshot& s) override;
     virtual size_t process_packet(const net::packet_view& packet) override;
+    virtual size_t process_line_packet(core::feed_line line, const net::packet_view& packet) override;
+    virtual size_t process_packets(const net::packet_view* packets, size_t count) override;
 };
 
 class nordic_itch_protocol : public core::protocol {
@@ -39,6 +39,11 @@ public:
     { }
 
     virtual size_t parse(const packet_view&) = 0;
+
+    // Called by transport protocol sessions when all messages of a packet
+    // have been parsed.
+    virtual void flush()
+    { }
 };
 
 }
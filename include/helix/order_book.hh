@@ -6,16 +6,19 @@
 /// querying per-asset order book state such as top and depth of book bid
 /// and ask price and size.
 
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/member.hpp>
+#include "helix/order_index.hh"
 
 #include <unordered_map>
+#include <type_traits>
+#include <functional>
+#include <stdexcept>
+#include <atomic>
 #include <cstdint>
 #include <utility>
+#include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 #include <list>
 #include <map>
 
@@ -50,59 +53,475 @@ enum class trading_state : uint8_t {
     auction,
 };
 
+/// \brief Result of an order book operation or of applying a message.
+///
+/// Inconsistent messages, such as references to unknown orders after a
+/// late subscription or a recovery, are routine in market data feeds, so
+/// they are reported as a status instead of an exception.
+enum class status : uint8_t {
+    /// The operation succeeded.
+    ok,
+    /// The order ID is not in the order book.
+    unknown_order,
+    /// An order with the same ID is already in the order book.
+    duplicate_order,
+    /// The side of an order is neither buy nor sell.
+    invalid_side,
+    /// The trading state of an order book is not known.
+    invalid_trading_state,
+    /// The price of an order is greater than order::max_price.
+    invalid_price,
+    /// The executed or canceled quantity is greater than the quantity of
+    /// the order.
+    invalid_quantity,
+    /// A gap in the sequence numbers of a feed could not be filled and the
+    /// missing messages were skipped.
+    messages_lost,
+};
+
+/// Number of status values.
+static constexpr size_t status_count = static_cast<size_t>(status::messages_lost) + 1;
+
+/// Returns a description of a status.
+const char* status_string(status s);
+
+/// Callback that is invoked when a feed handler drops a message that it
+/// cannot apply. \p value is the order ID or other field that the message
+/// failed on, or the number of skipped messages for status::messages_lost.
+using error_callback = std::function<void(status s, uint64_t value)>;
+
+/// \brief Error reporter counts the messages that a feed handler drops and
+/// passes them to an error callback.
+///
+/// In strict mode, which is meant for debugging, dropped messages throw
+/// std::invalid_argument instead.
+class error_reporter {
+    uint64_t _counts[status_count] = {};
+    error_callback _process_error;
+    bool _strict = false;
+public:
+    void set_callback(error_callback process_error) {
+        _process_error = std::move(process_error);
+    }
+
+    void set_strict(bool strict) {
+        _strict = strict;
+    }
+
+    /// Returns the number of errors with a status since the handler was
+    /// created.
+    uint64_t count(status s) const {
+        return _counts[static_cast<size_t>(s)];
+    }
+
+    /// Reports an error.
+    void report(status s, uint64_t value);
+};
+
 struct price_level;
 
+/// Slot that refers to no order.
+static constexpr uint32_t null_slot = std::numeric_limits<uint32_t>::max();
+
 /// \brief Order is a request to buy or sell quantity of asset at a
 /// specified price.
+///
+/// Orders are packed into 40 bytes so that the resting orders of a whole
+/// market fit in memory: prices are 32-bit, which holds every ITCH 5.0 price
+/// and Nordic ITCH prices up to max_price, and timestamps are 56-bit, which
+/// holds nanoseconds since midnight.
 struct order final {
+    static constexpr uint64_t max_price = std::numeric_limits<uint32_t>::max();
+
     price_level* level;
     uint64_t     id;
-    uint64_t     price;
+    uint32_t     price;
     uint32_t     quantity;
+    //! Slots of the previous and next order at the price level in time
+    //! priority, if the order book keeps order queues.
+    uint32_t     prev;
+    uint32_t     next;
+    uint64_t     timestamp : 56;
     side_type    side;
-    uint64_t     timestamp;
 
-    order(uint64_t id, uint64_t price, uint32_t quantity, side_type side, uint64_t timestamp)
+    order() = default;
+
+    order(uint64_t id, uint32_t price, uint32_t quantity, side_type side, uint64_t timestamp)
         : level{nullptr}
         , id{id}
         , price{price}
         , quantity{quantity}
-        , side{side}
+        , prev{null_slot}
+        , next{null_slot}
         , timestamp{timestamp}
+        , side{side}
     {}
 };
 
+static_assert(sizeof(order) == 40, "order is not packed");
+
+/// \brief Order pool is a slab of orders addressed by 32-bit slot.
+///
+/// The pool is sized from the expected number of orders and recycles
+/// released slots, so steady-state allocation and release never touch the
+/// heap. The pool grows when it runs out of slots, which invalidates
+/// references to orders but not slots. Released slots have no price level.
+/// The order books of a feed handler can share one pool, which is then sized
+/// once for the whole feed instead of per book.
+class order_pool {
+    std::vector<order> _orders;
+    std::vector<uint32_t> _free;
+public:
+    explicit order_pool(size_t max_orders = 0) {
+        reserve(max_orders);
+    }
+
+    /// Makes room for \p max_orders orders without growing the pool.
+    void reserve(size_t max_orders) {
+        _orders.reserve(max_orders);
+        _free.reserve(max_orders);
+    }
+
+    order& operator[](uint32_t slot) {
+        return _orders[slot];
+    }
+
+    const order& operator[](uint32_t slot) const {
+        return _orders[slot];
+    }
+
+    /// Returns the number of slots in use.
+    size_t size() const {
+        return _orders.size() - _free.size();
+    }
+
+    /// Returns the number of bytes allocated for the pool.
+    size_t memory_usage() const {
+        return _orders.capacity() * sizeof(order) + _free.capacity() * sizeof(uint32_t);
+    }
+
+    /// Stores an order in a free slot and returns the slot.
+    uint32_t alloc(const order& o) {
+        if (!_free.empty()) {
+            uint32_t slot = _free.back();
+            _free.pop_back();
+            _orders[slot] = o;
+            return slot;
+        }
+        if (_orders.size() == _orders.capacity()) {
+            _free.reserve(_orders.size() * 2);
+        }
+        _orders.push_back(o);
+        return _orders.size() - 1;
+    }
+
+    /// Returns a slot to the pool.
+    void free(uint32_t slot) {
+        _orders[slot].level = nullptr;
+        _free.push_back(slot);
+    }
+
+    /// Calls \p fn for every order in the pool.
+    template<typename Fn>
+    void for_each(Fn&& fn) {
+        for (auto&& o : _orders) {
+            if (o.level) {
+                fn(o);
+            }
+        }
+    }
+
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        for (auto&& o : _orders) {
+            if (o.level) {
+                fn(o);
+            }
+        }
+    }
+};
+
+/// \brief Order reference locates an order in an order book pool for
+/// handlers that index orders across all books.
+struct order_ref {
+    uint32_t book;
+    uint32_t slot;
+};
+
 /// \brief Price level is a time-prioritized list of orders with the same price.
+///
+/// The list is an intrusive queue of order pool slots that is only
+/// maintained if the order book keeps order queues, shares its pool or keeps
+/// a ladder. Slots stay valid when price levels are moved, so the queue
+/// moves with the level.
 struct price_level {
     explicit price_level(uint64_t price_)
         : price(price_)
         , size(0)
+        , head(null_slot)
+        , tail(null_slot)
     { }
 
     uint64_t price;
     uint64_t size;
+    //! Slots of the first and last order in time priority.
+    uint32_t head;
+    uint32_t tail;
 };
 
-/// \brief Order book is a price-time prioritized list of buy and sell
-/// orders.
+/// \brief Queue position of an order at its price level.
+struct queue_position {
+    //! Number of orders ahead of the order.
+    uint64_t orders;
+    //! Quantity of the orders ahead of the order.
+    uint64_t quantity;
+};
+
+/// \brief Depth level is the aggregate size of orders at a price in a
+/// snapshot of the order book.
+struct depth_level {
+    uint64_t price;
+    uint64_t size;
+};
 
-using namespace boost::multi_index;
+/// \brief Price level storage.
+enum class level_storage : uint8_t {
+    /// Price levels are kept in an ordered tree.
+    tree,
+    /// Price levels near the best price are kept in a contiguous
+    /// tick-indexed ladder, the rest in an ordered tree.
+    ladder,
+};
+
+/// \brief Price level storage configuration of an order book.
+struct level_config {
+    /// Price level storage type.
+    level_storage storage = level_storage::tree;
+    /// Price increment between adjacent ladder levels. The default is one
+    /// cent in prices with four implied decimals. Prices that are not a
+    /// multiple of the tick size are kept in the ordered tree.
+    uint64_t tick_size = 100;
+    /// Number of ladder levels per side.
+    size_t window = 1024;
+    /// Number of top price levels per side whose changes are reported to
+    /// the listener. Zero reports every change.
+    size_t depth = 0;
+    /// Number of top price levels per side that are published for reader
+    /// threads in a published_book. Zero disables publication.
+    size_t published_depth = 0;
+    /// Keep the orders of every price level in a time priority queue and
+    /// deliver an event for every order that is added, modified or removed
+    /// (L3 mode).
+    bool order_queues = false;
+};
+
+class order_book;
+
+/// \brief Published book is a copy of the top price levels of an order
+/// book that threads other than the feed handler thread can read without
+/// locks.
+///
+/// The feed handler thread stores a new copy after every update to the
+/// order book under a sequence lock: the sequence number is odd while a
+/// copy is being stored and a reader retries if the number changed while
+/// it was reading. Storing never waits for readers and readers never block
+/// the writer, but a reader may retry while the book is updated rapidly.
+class published_book {
+    std::atomic<uint64_t> _seq;
+    size_t _depth;
+    //! Timestamp, trading state, then price and size of every bid level
+    //! followed by every ask level.
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;
+    //! Levels of the copy that is being stored. Accessed by the writer only.
+    std::vector<depth_level> _scratch;
+public:
+    explicit published_book(size_t depth);
 
-typedef multi_index_container<order, indexed_by<
-    hashed_unique<member<order, uint64_t, &order::id>>>> order_set;
+    published_book(const published_book&) = delete;
+    published_book& operator=(const published_book&) = delete;
 
+    /// Returns the number of price levels per side.
+    size_t depth() const {
+        return _depth;
+    }
+
+    /// Returns the number of copies stored so far. A reader that polls the
+    /// version only needs to read() when it has changed.
+    uint64_t version() const {
+        return _seq.load(std::memory_order_acquire) / 2;
+    }
+
+    /// Copies a consistent snapshot of up to depth() top price levels to
+    /// \p bids and \p asks, with the same values for empty levels as
+    /// order_book::depth(). Returns the version of the snapshot, which is
+    /// zero if nothing has been stored yet.
+    uint64_t read(uint64_t& timestamp, trading_state& state,
+                  depth_level* bids, depth_level* asks, size_t levels) const;
+
+    /// Stores a copy of the top price levels of an order book. Must only be
+    /// called from the thread that updates the order book.
+    void store(const order_book& ob);
+
+    /// Returns the number of bytes allocated for the published book.
+    size_t memory_usage() const;
+};
+
+/// \brief Price ladder is one side of an order book: a set of price levels
+/// ordered from the best price to the worst.
+///
+/// Levels that fall in the ladder window are kept in a contiguous array
+/// indexed by their distance in ticks from the better end of the window and
+/// the rest in an ordered overflow tree. The window is re-centred when a new
+/// best price falls outside of it and a cursor tracks the best level in the
+/// window. A ladder with an empty window keeps all levels in the tree.
+template<side_type Side>
+class price_ladder {
+public:
+    using compare = typename std::conditional<Side == side_type::buy,
+                                              std::greater<uint64_t>,
+                                              std::less<uint64_t>>::type;
+private:
+    std::vector<price_level> _window;
+    std::map<uint64_t, price_level, compare> _overflow;
+    size_t   _capacity;
+    uint64_t _tick;
+    uint64_t _origin;
+    size_t   _window_levels;
+    size_t   _best;
+public:
+    explicit price_ladder(const level_config& config = level_config{});
+
+    size_t size() const {
+        return _window_levels + _overflow.size();
+    }
+
+    /// Returns the price level for a price, creating it if needed. If the
+    /// window is re-centred, \p relocate is called to update references to
+    /// price levels.
+    template<typename Relocate>
+    price_level& lookup_or_create(uint64_t price, Relocate&& relocate) {
+        size_t idx;
+        if (slot(price, idx)) {
+            return occupy(idx, price);
+        }
+        if (_capacity && price % _tick == 0 && (!_window_levels || better(price, _window[_best].price))) {
+            recentre(price);
+            relocate();
+            if (slot(price, idx)) {
+                return occupy(idx, price);
+            }
+        }
+        auto it = _overflow.find(price);
+        if (it == _overflow.end()) {
+            it = _overflow.emplace(price, price_level{price}).first;
+        }
+        return it->second;
+    }
+
+    /// Returns an existing price level for a price.
+    price_level& lookup(uint64_t price);
+
+    /// Removes a price level.
+    void erase(price_level& level);
+
+    /// Returns the price level at a depth or \c nullptr if there is none.
+    const price_level* level(size_t depth) const;
+
+    /// Copies up to \p depth best price levels to \p levels and returns
+    /// the number of levels copied.
+    size_t copy(depth_level* levels, size_t depth) const;
+
+    /// Calls \p fn for every price level, in no particular order.
+    template<typename Fn>
+    void for_each_level(Fn&& fn) {
+        for (auto&& level : _window) {
+            if (level.price != empty) {
+                fn(level);
+            }
+        }
+        for (auto&& kv : _overflow) {
+            fn(kv.second);
+        }
+    }
+
+    template<typename Fn>
+    void for_each_level(Fn&& fn) const {
+        const_cast<price_ladder*>(this)->for_each_level([&fn](const price_level& level) {
+            fn(level);
+        });
+    }
+
+    /// Returns the number of bytes allocated for the ladder, counting the
+    /// overflow tree nodes approximately.
+    size_t memory_usage() const;
+private:
+    static constexpr uint64_t empty = std::numeric_limits<uint64_t>::max();
+
+    static bool better(uint64_t a, uint64_t b) {
+        return compare{}(a, b);
+    }
+
+    bool slot(uint64_t price, size_t& idx) const {
+        if (_window.empty() || better(price, _origin)) {
+            return false;
+        }
+        uint64_t distance = Side == side_type::buy ? _origin - price : price - _origin;
+        idx = distance / _tick;
+        return idx < _capacity && idx * _tick == distance;
+    }
+
+    price_level& occupy(size_t idx, uint64_t price) {
+        auto&& level = _window[idx];
+        if (level.price == empty) {
+            level.price = price;
+            _window_levels++;
+            if (idx < _best) {
+                _best = idx;
+            }
+        }
+        return level;
+    }
+
+    void recentre(uint64_t price);
+};
+
+/// \brief Order book is a price-time prioritized list of buy and sell
+/// orders.
 class order_book {
 private:
     std::string _symbol;
     uint64_t _timestamp;
     trading_state _state;
-    order_set _orders;
-    std::map<uint64_t, price_level, std::greater<uint64_t>> _bids;
-    std::map<uint64_t, price_level, std::less   <uint64_t>> _asks;
+    size_t _max_orders;
+    //! Pool of the book, unless it shares a pool with other books.
+    std::unique_ptr<order_pool> _own_pool;
+    order_pool* _pool;
+    //! Number of orders in the book, which is not the size of a shared pool.
+    size_t _order_count;
+    //! Are orders linked into the queues of their price levels? Books that
+    //! keep order queues do, and so do books with a shared pool, which is
+    //! not scanned for the orders of one book, and books with a ladder, so
+    //! that re-centring walks the levels of one side instead of the pool.
+    bool _linked;
+    order_index<uint32_t> _orders;
+    price_ladder<side_type::buy>  _bids;
+    price_ladder<side_type::sell> _asks;
+    level_config _levels;
+    bool _depth_changed;
+    //! Prices of the price levels at level_config::depth on each side, or
+    //! the worst possible price if a side has fewer levels. Changes at worse
+    //! prices do not move the top levels.
+    uint64_t _bid_depth_price;
+    uint64_t _ask_depth_price;
+    std::unique_ptr<published_book> _published;
 public:
-    using iterator = order_set::iterator;
+    order_book(std::string symbol, uint64_t timestamp, size_t max_orders = 0,
+               const level_config& levels = level_config{});
 
-    order_book(std::string symbol, uint64_t timestamp, size_t max_orders = 0);
+    /// Creates an order book that allocates its orders from a pool that it
+    /// shares with other books, which must outlive the book.
+    order_book(std::string symbol, uint64_t timestamp, order_pool& pool,
+               const level_config& levels = level_config{});
 
     const std::string& symbol() const {
         return _symbol;
@@ -124,31 +543,169 @@ public:
         return _state;
     }
 
-    void add(order order);
-    void replace(uint64_t order_id, order order);
-    void cancel(uint64_t order_id, uint64_t quantity);
-    std::pair<uint64_t, side_type> execute(uint64_t order_id, uint64_t quantity);
-    void remove(uint64_t order_id);
-    side_type side(uint64_t order_id) const;
+    size_t max_orders() const {
+        return _max_orders;
+    }
+
+    const level_config& levels() const {
+        return _levels;
+    }
+
+    /// Calls \p fn for every order in the book. If the book keeps order
+    /// queues, the orders of a price level are visited in time priority.
+    template<typename Fn>
+    void for_each_order(Fn&& fn) const {
+        if (!_linked) {
+            const order_pool& pool = *_pool;
+            pool.for_each(std::forward<Fn>(fn));
+            return;
+        }
+        auto visit = [this, &fn](const price_level& level) {
+            for (uint32_t slot = level.head; slot != null_slot; slot = (*_pool)[slot].next) {
+                fn((*_pool)[slot]);
+            }
+        };
+        _bids.for_each_level(visit);
+        _asks.for_each_level(visit);
+    }
+
+    /// Calls \p fn for every order at the price level at \p depth on one
+    /// side of the book in time priority. Throws std::logic_error if the
+    /// book does not keep order queues.
+    template<typename Fn>
+    void for_each_queued(side_type side, size_t depth, Fn&& fn) const {
+        check_order_queues();
+        const price_level* level = side == side_type::buy ? _bids.level(depth) : _asks.level(depth);
+        if (!level) {
+            return;
+        }
+        for (uint32_t slot = level->head; slot != null_slot; slot = (*_pool)[slot].next) {
+            fn((*_pool)[slot]);
+        }
+    }
+
+    /// \name Order management by order ID
+    ///
+    /// These functions do not throw on invalid input. They return a
+    /// status other than status::ok and leave the book unchanged instead.
+    /// @{
+
+    status add(order order);
+    status replace(uint64_t order_id, order order);
+    status cancel(uint64_t order_id, uint64_t quantity);
+
+    /// Executes quantity of an order and returns the price and side of
+    /// the order in \p price and \p side.
+    status execute(uint64_t order_id, uint64_t quantity, uint64_t& price, side_type& side);
+    status remove(uint64_t order_id);
+    status side(uint64_t order_id, side_type& side) const;
+
+    /// Returns the queue position of an order in \p pos. Throws
+    /// std::logic_error if the book does not keep order queues.
+    status position(uint64_t order_id, queue_position& pos) const;
+
+    /// @}
+
+    /// \name Slot-based order management
+    ///
+    /// Orders that are inserted by slot are not indexed by order ID in the
+    /// book. This lets feed handlers that keep their own order ID index
+    /// skip the per-book lookup.
+    /// @{
+
+    /// Inserts an order and returns its slot. The side of the order must
+    /// be buy or sell.
+    uint32_t insert(order order);
+
+    /// Returns the order in a slot.
+    const order& at(uint32_t slot) const {
+        return (*_pool)[slot];
+    }
+
+    /// Cancels quantity of an order. Returns \c true if the order was
+    /// removed from the book. Throws std::invalid_argument and leaves the
+    /// order unchanged if the quantity is greater than that of the order.
+    bool cancel_at(uint32_t slot, uint64_t quantity);
+
+    /// Executes quantity of an order. Returns \c true if the order was
+    /// removed from the book. Throws std::invalid_argument and leaves the
+    /// order unchanged if the quantity is greater than that of the order.
+    bool execute_at(uint32_t slot, uint64_t quantity);
+
+    /// Removes an order from the book.
+    void remove_at(uint32_t slot);
+
+    /// Returns the queue position of an order. Throws std::logic_error if
+    /// the book does not keep order queues.
+    queue_position position_at(uint32_t slot) const;
+
+    /// @}
 
     size_t bid_levels() const;
     size_t ask_levels() const;
     size_t order_count() const;
 
+    /// Returns the number of bytes of memory that the book uses. Orders in
+    /// a shared pool are counted at their size, the rest of the pool is not
+    /// counted.
+    size_t memory_usage() const;
+
     uint64_t bid_price(size_t level) const;
     uint64_t bid_size (size_t level) const;
     uint64_t ask_price(size_t level) const;
     uint64_t ask_size (size_t level) const;
     uint64_t midprice (size_t level) const;
 
+    /// Fills \p bids and \p asks with the top \p levels price levels of the
+    /// book in one pass. Missing levels are filled with the same values that
+    /// bid_price(), ask_price(), bid_size() and ask_size() return for them.
+    void depth(depth_level* bids, depth_level* asks, size_t levels) const;
+
+    /// Returns the published copy of the book, or \c nullptr if
+    /// level_config::published_depth is zero. The published book lives as
+    /// long as the order book and can be read from any thread.
+    const published_book* published() const {
+        return _published.get();
+    }
+
+    /// Stores the current top price levels in the published book, if any.
+    /// Feed handlers call this after every update to the book.
+    void publish_levels() {
+        if (_published) {
+            _published->store(*this);
+        }
+    }
+
+    /// Returns \c true if an update since the last clear_depth_changed()
+    /// changed one of the top price levels configured in level_config::depth.
+    bool depth_changed() const {
+        return _depth_changed;
+    }
+
+    void clear_depth_changed() {
+        _depth_changed = false;
+    }
+
 private:
-    void remove(iterator& iter);
+    template<side_type Side>
+    void add(uint32_t slot, price_ladder<Side>& levels);
+
+    template<side_type Side>
+    void remove(uint32_t slot, price_ladder<Side>& levels);
+
+    void link(price_level& level, uint32_t slot);
+
+    void unlink(price_level& level, uint32_t slot);
+
+    void check_order_queues() const;
+
+    template<side_type Side>
+    void relocate(price_ladder<Side>& levels);
 
-    template<typename T>
-    void remove(const order& o, T& levels);
+    void touch(side_type side, uint64_t price);
 
-    template<typename T>
-    price_level& lookup_or_create(T& levels, uint64_t price);
+    template<side_type Side>
+    void touch(const price_ladder<Side>& levels, uint64_t price);
 };
 
 /// @}
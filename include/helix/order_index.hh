@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace helix {
+
+namespace core {
+
+/// \addtogroup order-book
+/// @{
+
+/// \brief Order index is an open-addressing hash table from order ID to a
+/// value such as a pool slot.
+///
+/// The table uses Robin Hood linear probing with backward-shift deletion so
+/// that steady-state insertion and removal never allocate and probe
+/// sequences stay short. Order IDs are hashed by their low bits, which keeps
+/// orders that arrive close together close in the table. The table is sized
+/// up front for the expected number of orders and grows only when that is
+/// exceeded. Order ID \c UINT64_MAX is reserved for marking empty entries.
+template<typename Value>
+class order_index {
+public:
+    struct entry {
+        uint64_t id;
+        Value    value;
+    };
+private:
+    static constexpr uint64_t empty = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t min_capacity = 16;
+
+    std::vector<entry> _entries;
+    size_t _size;
+    size_t _mask;
+public:
+    explicit order_index(size_t max_orders = 0)
+        : _size{0}
+        , _mask{0}
+    {
+        reserve(max_orders);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    /// Returns the number of entries in the table, occupied or not.
+    size_t capacity() const {
+        return _entries.size();
+    }
+
+    /// Returns the number of bytes allocated for the table.
+    size_t memory_usage() const {
+        return _entries.capacity() * sizeof(entry);
+    }
+
+    /// Makes room for \p max_orders orders without growing the table.
+    void reserve(size_t max_orders) {
+        size_t capacity = min_capacity;
+        while (capacity < max_orders * 2) {
+            capacity *= 2;
+        }
+        if (capacity > _entries.size()) {
+            rehash(capacity);
+        }
+    }
+
+    /// Returns the entry of an order or \c nullptr if the order ID is not in
+    /// the index. The entry is valid until the next insert() or erase().
+    entry* find(uint64_t id) {
+        for (size_t i = home(id), dist = 0;; i = (i + 1) & _mask, dist++) {
+            auto&& e = _entries[i];
+            if (e.id == id) {
+                return &e;
+            }
+            if (e.id == empty || distance(e.id, i) < dist) {
+                return nullptr;
+            }
+        }
+    }
+
+    const entry* find(uint64_t id) const {
+        return const_cast<order_index*>(this)->find(id);
+    }
+
+    /// Inserts an order. Returns \c false if the order ID is already in
+    /// the index.
+    bool insert(uint64_t id, Value value) {
+        if ((_size + 1) * 4 > _entries.size() * 3) {
+            rehash(_entries.size() * 2);
+        }
+        entry cur{id, value};
+        for (size_t i = home(id), dist = 0;; i = (i + 1) & _mask, dist++) {
+            auto&& e = _entries[i];
+            if (e.id == empty) {
+                e = cur;
+                _size++;
+                return true;
+            }
+            if (e.id == cur.id) {
+                return false;
+            }
+            // Entries that are closer to their home slot give way.
+            size_t e_dist = distance(e.id, i);
+            if (e_dist < dist) {
+                std::swap(e, cur);
+                dist = e_dist;
+            }
+        }
+    }
+
+    /// Removes an entry returned by find().
+    void erase(entry* e) {
+        size_t i = e - _entries.data();
+        for (;;) {
+            size_t j = (i + 1) & _mask;
+            auto&& next = _entries[j];
+            if (next.id == empty || distance(next.id, j) == 0) {
+                break;
+            }
+            _entries[i] = next;
+            i = j;
+        }
+        _entries[i].id = empty;
+        _size--;
+    }
+
+    /// Removes an order. Returns \c false if the order ID is not in the index.
+    bool erase(uint64_t id) {
+        auto* e = find(id);
+        if (!e) {
+            return false;
+        }
+        erase(e);
+        return true;
+    }
+
+    template<typename Fn>
+    void for_each(Fn&& fn) const {
+        for (auto&& e : _entries) {
+            if (e.id != empty) {
+                fn(e.id, e.value);
+            }
+        }
+    }
+private:
+    size_t home(uint64_t id) const {
+        return id & _mask;
+    }
+
+    size_t distance(uint64_t id, size_t pos) const {
+        return (pos - home(id)) & _mask;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<entry> entries(capacity, entry{empty, Value{}});
+        entries.swap(_entries);
+        _mask = capacity - 1;
+        _size = 0;
+        for (auto&& e : entries) {
+            if (e.id != empty) {
+                insert(e.id, e.value);
+            }
+        }
+    }
+};
+
+template<typename Value>
+constexpr uint64_t order_index<Value>::empty;
+
+template<typename Value>
+constexpr size_t order_index<Value>::min_capacity;
+
+/// @}
+
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "helix/latency.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace helix {
+
+namespace core {
+
+/// \brief Pacing clock for replaying recorded market data.
+///
+/// The clock maps feed time to time stamp counter ticks: the first packet
+/// with a known feed time fixes the origin of both clocks, and every later
+/// packet is released when the time stamp counter has advanced by the feed
+/// time that elapsed since the origin divided by the replay speed. Waiting
+/// is a busy-wait on the time stamp counter, so the pacing does not depend
+/// on the timer slack of the scheduler, at the cost of keeping one core
+/// busy. A packet that is already due is released immediately and the time
+/// by which it was late is recorded in lag(), so a replay that cannot keep
+/// up shows in the lag rather than by shifting the timing of later packets.
+///
+/// Feed time that goes backwards, such as at the start of a new trading
+/// day, sets a new origin. Gaps in feed time that are longer than the
+/// maximum gap, such as the overnight gap between two sessions, are
+/// shortened to the maximum gap.
+class replay_clock {
+    //! Time stamp counter ticks per nanosecond of feed time.
+    double _ticks_per_nsec;
+    bool _paced;
+    bool _started;
+    uint64_t _origin_tsc;
+    uint64_t _origin_time;
+    uint64_t _last_time;
+    uint64_t _max_gap;
+    uint64_t _late;
+    latency_histogram _lag;
+public:
+    /// Replays at \p speed times the recorded rate, or as fast as possible
+    /// if \p speed is zero. Gaps in feed time that are longer than \p
+    /// max_gap nanoseconds are shortened to it unless it is zero. Throws
+    /// std::invalid_argument if \p speed is negative.
+    explicit replay_clock(double speed = 1.0, uint64_t max_gap = 0);
+
+    replay_clock(const replay_clock&) = delete;
+    replay_clock& operator=(const replay_clock&) = delete;
+
+    /// Waits until the packet with feed time \p time, in nanoseconds, is
+    /// due. Zero means the time of the packet is unknown, and it is
+    /// released immediately.
+    void wait(uint64_t time);
+
+    /// Returns \c true if the clock paces packets.
+    bool paced() const {
+        return _paced;
+    }
+
+    /// Returns the number of packets that were released after they were
+    /// due because processing could not keep up with the replay speed.
+    uint64_t late_count() const {
+        return _late;
+    }
+
+    /// Returns the histogram of the time, in nanoseconds, by which packets
+    /// were released after they were due.
+    const latency_histogram& lag() const {
+        return _lag;
+    }
+};
+
+}
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "helix/order_book.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace helix {
+
+namespace core {
+
+/// \addtogroup order-book
+/// @{
+
+/// \brief Snapshot of feed handler state.
+///
+/// A snapshot is a flat buffer of fixed-size records: a header followed by
+/// a book record for every order book, each of which is followed by the
+/// resting orders of the book. Price levels are not stored because they are
+/// aggregates of the orders and are rebuilt when the snapshot is restored.
+///
+/// A snapshot is captured by a session on the thread that processes
+/// packets. Capturing only copies the order records, so the snapshot can
+/// then be written to a file from another thread while the session keeps
+/// processing packets.
+class snapshot {
+public:
+    static constexpr uint32_t version = 1;
+
+    struct header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t book_count;
+        //! Sequence number of the next message to process, or zero if the
+        //! transport protocol is not sequenced.
+        uint64_t seq_num;
+        //! Feed handler clock.
+        uint64_t clock;
+    };
+
+    struct book {
+        char     symbol[32];
+        //! Handler-specific order book key such as the stock locate code.
+        uint64_t key;
+        uint64_t timestamp;
+        uint64_t max_orders;
+        uint64_t tick_size;
+        uint64_t window;
+        uint64_t depth;
+        uint64_t order_count;
+        uint8_t  state;
+        uint8_t  storage;
+        //! Does the order book keep order queues? Orders of a price level
+        //! are stored in time priority if it does.
+        uint8_t  order_queues;
+        uint8_t  reserved[1];
+        //! Number of published price levels, which is zero in snapshots
+        //! that predate publication.
+        uint32_t published_depth;
+    };
+
+    struct order {
+        uint64_t id;
+        uint64_t price;
+        uint64_t timestamp;
+        uint32_t quantity;
+        uint8_t  side;
+        uint8_t  reserved[3];
+    };
+private:
+    std::vector<char> _data;
+public:
+    snapshot();
+
+    uint64_t seq_num() const;
+
+    void set_seq_num(uint64_t seq_num);
+
+    uint64_t clock() const;
+
+    void set_clock(uint64_t clock);
+
+    /// Appends an order book and its resting orders.
+    void add(const order_book& ob, uint64_t key);
+
+    /// Writes the snapshot to a file. The file is written under a temporary
+    /// name and renamed, so \p path always refers to a complete snapshot.
+    /// Throws std::system_error on failure.
+    void write(const std::string& path) const;
+
+    /// Returns the price level storage configuration of a book record.
+    static level_config levels(const book& b);
+
+    /// Returns the order of an order record. Throws std::runtime_error if
+    /// the record has an invalid price, quantity or side.
+    static core::order to_order(const order& o);
+};
+
+/// \brief Snapshot that is mapped from a file.
+///
+/// The records are read in place from the mapping, so restoring state costs
+/// one pass over the orders.
+class mapped_snapshot {
+    const char* _data;
+    size_t _size;
+public:
+    /// Maps a snapshot file. Throws std::system_error if the file cannot be
+    /// mapped and std::runtime_error if it is not a valid snapshot.
+    explicit mapped_snapshot(const std::string& path);
+    ~mapped_snapshot();
+
+    mapped_snapshot(const mapped_snapshot&) = delete;
+    mapped_snapshot& operator=(const mapped_snapshot&) = delete;
+
+    uint64_t seq_num() const {
+        return header().seq_num;
+    }
+
+    uint64_t clock() const {
+        return header().clock;
+    }
+
+    /// Calls \p fn with every book record and a pointer to its orders.
+    template<typename Fn>
+    void for_each_book(Fn&& fn) const {
+        const char* p = _data + sizeof(snapshot::header);
+        for (uint32_t i = 0; i < header().book_count; i++) {
+            auto* b = reinterpret_cast<const snapshot::book*>(p);
+            p += sizeof(snapshot::book);
+            fn(*b, reinterpret_cast<const snapshot::order*>(p));
+            p += b->order_count * sizeof(snapshot::order);
+        }
+    }
+private:
+    const snapshot::header& header() const {
+        return *reinterpret_cast<const snapshot::header*>(_data);
+    }
+
+    void validate() const;
+};
+
+/// @}
+
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace helix {
+
+namespace core {
+
+/// \brief Bounded lock-free queue for exactly one producer thread and one
+/// consumer thread.
+///
+/// Each side keeps a private copy of the other side's index and only reads
+/// the shared index when the copy says the queue is full or empty, so that
+/// in steady state the producer and the consumer do not touch each other's
+/// cache lines. The capacity is rounded up to a power of two.
+template<typename T>
+class spsc_queue {
+    static constexpr size_t cache_line_size = 64;
+
+    std::vector<T> _items;
+    size_t _mask;
+    char _pad0[cache_line_size];
+    //! Index of the next item to pop, written by the consumer.
+    std::atomic<size_t> _head;
+    //! Consumer's copy of _tail.
+    size_t _tail_cache;
+    char _pad1[cache_line_size];
+    //! Index of the next item to push, written by the producer.
+    std::atomic<size_t> _tail;
+    //! Producer's copy of _head.
+    size_t _head_cache;
+    char _pad2[cache_line_size];
+public:
+    explicit spsc_queue(size_t capacity)
+        : _head{0}
+        , _tail_cache{0}
+        , _tail{0}
+        , _head_cache{0}
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        _items.resize(size);
+        _mask = size - 1;
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    size_t capacity() const {
+        return _items.size();
+    }
+
+    /// Pushes an item. Returns \c false if the queue is full.
+    bool try_push(const T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head_cache == _items.size()) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            if (tail - _head_cache == _items.size()) {
+                return false;
+            }
+        }
+        _items[tail & _mask] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns \c true if there is no room to push. Only the producer may
+    /// call this.
+    bool full() {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head_cache == _items.size()) {
+            _head_cache = _head.load(std::memory_order_acquire);
+        }
+        return tail - _head_cache == _items.size();
+    }
+
+    /// Returns \c true if there is no item to pop. Only the consumer may
+    /// call this.
+    bool empty() {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cache) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+        }
+        return head == _tail_cache;
+    }
+
+    /// Pops an item. Returns \c false if the queue is empty.
+    bool try_pop(T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cache) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            if (head == _tail_cache) {
+                return false;
+            }
+        }
+        item = _items[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+template<typename T>
+constexpr size_t spsc_queue<T>::cache_line_size;
+
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "helix/helix.hh"
+#include "helix/net.hh"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace helix {
+
+namespace net {
+
+/// \brief Configuration of a UDP multicast receiver.
+struct udp_config {
+    /// Multicast group to join.
+    std::string multicast_addr;
+    /// Address of the local interface to join the group on. Empty lets
+    /// the kernel choose.
+    std::string interface_addr;
+    /// UDP port to bind to.
+    uint16_t port = 0;
+    /// Maximum number of datagrams received with one system call.
+    size_t batch_size = 64;
+    /// Socket receive buffer size in bytes. Zero keeps the system default.
+    int rcvbuf_size = 0;
+    /// Busy poll timeout in microseconds (SO_BUSY_POLL). Zero disables
+    /// busy polling in the kernel.
+    int busy_poll_usec = 0;
+    /// Record kernel receive timestamps of datagrams.
+    bool timestamps = false;
+    /// Feed line that the multicast group carries.
+    core::feed_line line = core::feed_line::a;
+};
+
+/// \brief UDP multicast receiver that reads datagrams in batches.
+///
+/// The receiver reads up to udp_config::batch_size datagrams with a single
+/// recvmmsg() call into buffers that are allocated once, and passes them
+/// to a session in arrival order. The socket is non-blocking so that
+/// applications can either wait for it in an event loop or spin on
+/// receive().
+class udp_receiver {
+    int _fd;
+    bool _timestamps;
+    core::feed_line _line;
+    uint64_t _timestamp;
+    std::vector<char> _buffers;
+    std::vector<char> _controls;
+    std::vector<struct iovec> _iovecs;
+    std::vector<struct mmsghdr> _msgs;
+    std::vector<net::packet_view> _packets;
+public:
+    /// Opens a socket, binds it and joins the multicast group. Throws
+    /// std::system_error on failure.
+    explicit udp_receiver(const udp_config& config);
+    ~udp_receiver();
+
+    udp_receiver(const udp_receiver&) = delete;
+    udp_receiver& operator=(const udp_receiver&) = delete;
+
+    /// Returns the socket file descriptor for use with an event loop.
+    int fd() const {
+        return _fd;
+    }
+
+    /// Returns the kernel receive timestamp in nanoseconds since the epoch of
+    /// the datagram that is being processed, or zero if timestamps are not
+    /// enabled.
+    uint64_t timestamp() const {
+        return _timestamp;
+    }
+
+    /// Receives one batch of datagrams and passes them to \p session with
+    /// core::session::process_packets(). If timestamps are enabled, the
+    /// datagrams are passed one at a time so that timestamp() refers to the
+    /// datagram being processed and is passed to the session with
+    /// core::session::set_rx_timestamp(). Datagrams of the B line are
+    /// passed one at a time with core::session::process_line_packet(). If \p wait is \c true, blocks until at least one datagram is
+    /// available. Returns the number of datagrams processed, which is zero if
+    /// none were available. Throws std::system_error on failure.
+    size_t receive(core::session& session, bool wait = false);
+};
+
+}
+
+}
@@ -0,0 +1,211 @@
+#include "helix/aggregator.hh"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace helix {
+
+namespace core {
+
+constexpr size_t consolidated_book::no_venue;
+
+static constexpr uint64_t empty_bid = numeric_limits<uint64_t>::min();
+static constexpr uint64_t empty_ask = numeric_limits<uint64_t>::max();
+
+static bool same_levels(const vector<depth_level>& a, const vector<depth_level>& b)
+{
+    return !memcmp(a.data(), b.data(), a.size() * sizeof(depth_level));
+}
+
+consolidated_book::consolidated_book(std::string symbol, size_t depth)
+    : _symbol{std::move(symbol)}
+    , _depth{depth}
+    , _timestamp{0}
+    , _bids(depth, depth_level{empty_bid, 0})
+    , _asks(depth, depth_level{empty_ask, 0})
+    , _bid_venue{no_venue}
+    , _ask_venue{no_venue}
+{
+    if (!depth) {
+        throw invalid_argument("consolidated book depth must be at least one level");
+    }
+    _scratch.bids.resize(depth);
+    _scratch.asks.resize(depth);
+}
+
+uint64_t consolidated_book::bid_price(size_t level) const
+{
+    return level < _depth ? _bids[level].price : empty_bid;
+}
+
+uint64_t consolidated_book::bid_size(size_t level) const
+{
+    return level < _depth ? _bids[level].size : 0;
+}
+
+uint64_t consolidated_book::ask_price(size_t level) const
+{
+    return level < _depth ? _asks[level].price : empty_ask;
+}
+
+uint64_t consolidated_book::ask_size(size_t level) const
+{
+    return level < _depth ? _asks[level].size : 0;
+}
+
+bool consolidated_book::update(size_t venue, const order_book& ob)
+{
+    if (venue >= _venues.size()) {
+        _venues.resize(venue + 1, venue_quote{vector<depth_level>(_depth, depth_level{empty_bid, 0}),
+                                              vector<depth_level>(_depth, depth_level{empty_ask, 0})});
+        _cursors.resize(_venues.size());
+    }
+    auto state = ob.state();
+    if (state == trading_state::halted || state == trading_state::paused) {
+        fill(_scratch.bids.begin(), _scratch.bids.end(), depth_level{empty_bid, 0});
+        fill(_scratch.asks.begin(), _scratch.asks.end(), depth_level{empty_ask, 0});
+    } else {
+        ob.depth(_scratch.bids.data(), _scratch.asks.data(), _depth);
+    }
+    auto&& quote = _venues[venue];
+    if (same_levels(quote.bids, _scratch.bids) && same_levels(quote.asks, _scratch.asks)) {
+        return false;
+    }
+    swap(quote, _scratch);
+    _timestamp = ob.timestamp();
+
+    depth_level bid = _bids[0];
+    depth_level ask = _asks[0];
+    _bid_venue = merge(&venue_quote::bids, _bids, empty_bid, greater<uint64_t>{});
+    _ask_venue = merge(&venue_quote::asks, _asks, empty_ask, less<uint64_t>{});
+    return bid.price != _bids[0].price || bid.size != _bids[0].size
+        || ask.price != _asks[0].price || ask.size != _asks[0].size;
+}
+
+// Merges one side of the venue quotes into consolidated levels with a
+// k-way merge of the already sorted venue levels. Returns the venue of the
+// best level.
+template<typename Better>
+size_t consolidated_book::merge(std::vector<depth_level> venue_quote::* side, std::vector<depth_level>& levels,
+                                uint64_t empty, Better better)
+{
+    fill(_cursors.begin(), _cursors.end(), 0);
+    size_t best_venue = no_venue;
+    for (size_t n = 0; n < _depth; n++) {
+        uint64_t price = empty;
+        size_t venue = no_venue;
+        for (size_t v = 0; v < _venues.size(); v++) {
+            size_t cursor = _cursors[v];
+            if (cursor == _depth) {
+                continue;
+            }
+            auto&& level = (_venues[v].*side)[cursor];
+            if (level.size && (venue == no_venue || better(level.price, price))) {
+                price = level.price;
+                venue = v;
+            }
+        }
+        if (venue == no_venue) {
+            fill(levels.begin() + n, levels.end(), depth_level{empty, 0});
+            break;
+        }
+        if (!n) {
+            best_venue = venue;
+        }
+        uint64_t size = 0;
+        for (size_t v = venue; v < _venues.size(); v++) {
+            size_t& cursor = _cursors[v];
+            if (cursor < _depth) {
+                auto&& level = (_venues[v].*side)[cursor];
+                if (level.size && level.price == price) {
+                    size += level.size;
+                    cursor++;
+                }
+            }
+        }
+        levels[n] = depth_level{price, size};
+    }
+    return best_venue;
+}
+
+aggregator::aggregator(size_t depth)
+    : _depth{depth}
+    , _venue_count{0}
+{
+    if (!depth) {
+        throw invalid_argument("aggregator depth must be at least one level");
+    }
+}
+
+size_t aggregator::add_venue()
+{
+    _symbol_maps.emplace_back();
+    return _venue_count++;
+}
+
+size_t aggregator::attach(session& s)
+{
+    size_t venue = add_venue();
+    s.register_callback(ob_callback{[this, venue](const order_book& ob) {
+        update(venue, ob);
+    }});
+    return venue;
+}
+
+void aggregator::map_symbol(size_t venue, const std::string& venue_symbol, const std::string& instrument)
+{
+    if (venue >= _venue_count) {
+        throw invalid_argument("unknown venue: " + to_string(venue));
+    }
+    _symbol_maps[venue][venue_symbol] = instrument;
+}
+
+void aggregator::update(size_t venue, const order_book& ob)
+{
+    auto&& book = lookup(venue, ob);
+    if (book.update(venue, ob) && _process_nbbo) {
+        _process_nbbo(book);
+    }
+}
+
+const consolidated_book* aggregator::find(const std::string& instrument) const
+{
+    auto it = _books.find(instrument);
+    if (it == _books.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+consolidated_book& aggregator::lookup(size_t venue, const order_book& ob)
+{
+    auto it = _books_by_ob.find(&ob);
+    if (it != _books_by_ob.end()) {
+        return *it->second;
+    }
+    if (venue >= _venue_count) {
+        throw invalid_argument("unknown venue: " + to_string(venue));
+    }
+    std::string instrument;
+    auto&& symbols = _symbol_maps[venue];
+    auto mapped = symbols.find(ob.symbol());
+    if (mapped != symbols.end()) {
+        instrument = mapped->second;
+    } else {
+        instrument = ob.symbol();
+        instrument.erase(instrument.find_last_not_of(' ') + 1);
+    }
+    auto book = _books.find(instrument);
+    if (book == _books.end()) {
+        book = _books.emplace(instrument, consolidated_book{instrument, _depth}).first;
+    }
+    _books_by_ob.emplace(&ob, &book->second);
+    return book->second;
+}
+
+}
+
+}
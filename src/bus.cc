@@ -0,0 +1,361 @@
+#include "helix/bus.hh"
+
+#include "helix/order_book.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace core {
+
+// Shared memory object names start with a slash.
+static string shm_name(const string& name)
+{
+    return name.size() && name[0] == '/' ? name : "/" + name;
+}
+
+// Returns the length of a symbol without trailing spaces, which order book
+// symbols are padded with.
+static size_t symbol_length(const char* symbol, size_t len)
+{
+    while (len && symbol[len - 1] == ' ') {
+        len--;
+    }
+    return len;
+}
+
+static size_t ring_offset()
+{
+    return (sizeof(bus::header) + alignof(bus::event) - 1) & ~(alignof(bus::event) - 1);
+}
+
+static size_t symbol_stride(size_t depth)
+{
+    size_t size = sizeof(bus::symbol_entry) + 4 * depth * sizeof(std::atomic<uint64_t>);
+    return (size + 63) & ~size_t(63);
+}
+
+static std::atomic<uint64_t>* entry_levels(bus::symbol_entry& e)
+{
+    return reinterpret_cast<std::atomic<uint64_t>*>(&e + 1);
+}
+
+static const std::atomic<uint64_t>* entry_levels(const bus::symbol_entry& e)
+{
+    return reinterpret_cast<const std::atomic<uint64_t>*>(&e + 1);
+}
+
+bus_publisher::bus_publisher(const string& name, size_t capacity, size_t max_symbols, size_t depth)
+    : _name{shm_name(name)}
+    , _scratch(2 * depth)
+{
+    if (!depth || depth > numeric_limits<uint32_t>::max()) {
+        throw invalid_argument("invalid bus depth: " + to_string(depth));
+    }
+    uint64_t ring_capacity = 1;
+    while (ring_capacity < capacity) {
+        ring_capacity *= 2;
+    }
+    size_t stride = symbol_stride(depth);
+    _size = ring_offset() + ring_capacity * sizeof(bus::event) + max_symbols * stride;
+
+    // Unlink a previous bus instead of truncating it so that consumers
+    // that still map it are not faulted.
+    ::shm_unlink(_name.c_str());
+    int fd = ::shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), _name);
+    }
+    if (::ftruncate(fd, _size) < 0) {
+        int err = errno;
+        ::close(fd);
+        ::shm_unlink(_name.c_str());
+        throw system_error(err, system_category(), _name);
+    }
+    void* base = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        int err = errno;
+        ::shm_unlink(_name.c_str());
+        throw system_error(err, system_category(), _name);
+    }
+    _base = static_cast<char*>(base);
+    _header = reinterpret_cast<bus::header*>(_base);
+    _ring = reinterpret_cast<bus::event*>(_base + ring_offset());
+    _symbols = _base + ring_offset() + ring_capacity * sizeof(bus::event);
+    _mask = ring_capacity - 1;
+
+    // The mapping is zero-filled, which is a valid empty ring and table.
+    _header->version = bus::version;
+    _header->depth = depth;
+    _header->capacity = ring_capacity;
+    _header->max_symbols = max_symbols;
+    _header->symbol_stride = stride;
+    // Consumers check the magic last, so it is published after the rest of
+    // the header.
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(_header->magic, bus::magic, sizeof(bus::magic));
+}
+
+bus_publisher::~bus_publisher()
+{
+    ::munmap(_base, _size);
+    ::shm_unlink(_name.c_str());
+}
+
+void bus_publisher::attach(session& s)
+{
+    s.register_callback(ob_callback{[this](const order_book& ob) {
+        publish(ob);
+    }});
+    s.register_callback(trade_callback{[this](const trade& t) {
+        publish(t);
+    }});
+}
+
+bool bus_publisher::publish(const order_book& ob)
+{
+    uint32_t idx;
+    if (!lookup(ob.symbol().c_str(), idx)) {
+        return false;
+    }
+    size_t depth = _header->depth;
+    auto* bids = _scratch.data();
+    auto* asks = bids + depth;
+    ob.depth(bids, asks, depth);
+
+    auto& e = entry(idx);
+    auto* levels = entry_levels(e);
+    uint64_t seq = e.seq.load(std::memory_order_relaxed);
+    e.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.timestamp.store(ob.timestamp(), std::memory_order_relaxed);
+    e.state.store(static_cast<uint64_t>(ob.state()), std::memory_order_relaxed);
+    for (size_t i = 0; i < 2 * depth; i++) {
+        levels[2 * i].store(bids[i].price, std::memory_order_relaxed);
+        levels[2 * i + 1].store(bids[i].size, std::memory_order_relaxed);
+    }
+    e.seq.store(seq + 2, std::memory_order_release);
+
+    uint64_t meta = uint64_t(bus::event_type::order_book) | uint64_t(ob.state()) << 8 | uint64_t(idx) << 32;
+    append(meta, ob.timestamp(), bids[0].price, bids[0].size, asks[0].price, asks[0].size);
+    return true;
+}
+
+bool bus_publisher::publish(const trade& t)
+{
+    uint32_t idx;
+    if (!lookup(t.symbol, idx)) {
+        return false;
+    }
+    uint64_t meta = uint64_t(bus::event_type::trade) | uint64_t(t.sign) << 8 | uint64_t(idx) << 32;
+    append(meta, t.timestamp, t.price, t.size, 0, 0);
+    return true;
+}
+
+bool bus_publisher::lookup(const char* symbol, uint32_t& idx)
+{
+    auto it = _symbol_index_by_ptr.find(symbol);
+    if (it != _symbol_index_by_ptr.end()) {
+        idx = it->second;
+        return true;
+    }
+    auto sym_it = _symbol_index.find(symbol);
+    if (sym_it == _symbol_index.end()) {
+        uint64_t count = _header->symbol_count.load(std::memory_order_relaxed);
+        size_t len = strlen(symbol);
+        if (count == _header->max_symbols || len >= sizeof(bus::symbol_entry::symbol)) {
+            return false;
+        }
+        memcpy(entry(count).symbol, symbol, len);
+        _header->symbol_count.store(count + 1, std::memory_order_release);
+        sym_it = _symbol_index.emplace(symbol, count).first;
+    }
+    idx = sym_it->second;
+    _symbol_index_by_ptr.emplace(symbol, idx);
+    return true;
+}
+
+bus::symbol_entry& bus_publisher::entry(uint32_t idx)
+{
+    return *reinterpret_cast<bus::symbol_entry*>(_symbols + idx * _header->symbol_stride);
+}
+
+void bus_publisher::append(uint64_t meta, uint64_t timestamp, uint64_t w0, uint64_t w1, uint64_t w2, uint64_t w3)
+{
+    uint64_t n = _header->head.load(std::memory_order_relaxed);
+    auto& e = _ring[n & _mask];
+    e.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.meta.store(meta, std::memory_order_relaxed);
+    e.timestamp.store(timestamp, std::memory_order_relaxed);
+    e.words[0].store(w0, std::memory_order_relaxed);
+    e.words[1].store(w1, std::memory_order_relaxed);
+    e.words[2].store(w2, std::memory_order_relaxed);
+    e.words[3].store(w3, std::memory_order_relaxed);
+    e.seq.store(2 * n + 2, std::memory_order_release);
+    _header->head.store(n + 1, std::memory_order_release);
+}
+
+bus_reader::bus_reader(const string& name)
+    : _lost{0}
+{
+    string path = shm_name(name);
+    int fd = ::shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw system_error(err, system_category(), path);
+    }
+    _size = st.st_size;
+    if (_size < sizeof(bus::header)) {
+        ::close(fd);
+        throw runtime_error(path + ": not a market data bus");
+    }
+    void* base = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        throw system_error(errno, system_category(), path);
+    }
+    _base = static_cast<char*>(base);
+    _header = reinterpret_cast<const bus::header*>(_base);
+    bool valid = !memcmp(_header->magic, bus::magic, sizeof(bus::magic));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || _header->version != bus::version ||
+        ring_offset() + _header->capacity * sizeof(bus::event) + _header->max_symbols * _header->symbol_stride > _size) {
+        ::munmap(_base, _size);
+        throw runtime_error(path + ": not a market data bus");
+    }
+    _ring = reinterpret_cast<const bus::event*>(_base + ring_offset());
+    _symbols = _base + ring_offset() + _header->capacity * sizeof(bus::event);
+    _mask = _header->capacity - 1;
+    _tail = _header->head.load(std::memory_order_acquire);
+}
+
+bus_reader::~bus_reader()
+{
+    ::munmap(_base, _size);
+}
+
+bool bus_reader::poll(bus_event& ev)
+{
+    for (;;) {
+        uint64_t head = _header->head.load(std::memory_order_acquire);
+        if (_tail == head) {
+            return false;
+        }
+        auto& e = _ring[_tail & _mask];
+        uint64_t seq = e.seq.load(std::memory_order_acquire);
+        uint64_t meta = e.meta.load(std::memory_order_relaxed);
+        uint64_t timestamp = e.timestamp.load(std::memory_order_relaxed);
+        uint64_t w0 = e.words[0].load(std::memory_order_relaxed);
+        uint64_t w1 = e.words[1].load(std::memory_order_relaxed);
+        uint64_t w2 = e.words[2].load(std::memory_order_relaxed);
+        uint64_t w3 = e.words[3].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != 2 * _tail + 2 || e.seq.load(std::memory_order_relaxed) != seq) {
+            // The publisher lapped the reader, so skip to the newest event.
+            head = _header->head.load(std::memory_order_acquire);
+            _lost += head - _tail;
+            _tail = head;
+            continue;
+        }
+        _tail++;
+        ev.type = static_cast<bus::event_type>(meta & 0xff);
+        ev.symbol = meta >> 32;
+        ev.timestamp = timestamp;
+        if (ev.type == bus::event_type::trade) {
+            ev.sign = static_cast<trade_sign>((meta >> 8) & 0xff);
+            ev.price = w0;
+            ev.size = w1;
+        } else {
+            ev.state = static_cast<trading_state>((meta >> 8) & 0xff);
+            ev.bid = depth_level{w0, w1};
+            ev.ask = depth_level{w2, w3};
+        }
+        return true;
+    }
+}
+
+size_t bus_reader::symbol_count() const
+{
+    return _header->symbol_count.load(std::memory_order_acquire);
+}
+
+const char* bus_reader::symbol(uint32_t idx) const
+{
+    if (idx >= symbol_count()) {
+        return nullptr;
+    }
+    // Symbols are shorter than the entry, so they are NUL-terminated.
+    return entry(idx).symbol;
+}
+
+bool bus_reader::find(const string& symbol, uint32_t& idx) const
+{
+    size_t len = symbol_length(symbol.data(), symbol.size());
+    size_t count = symbol_count();
+    for (size_t i = 0; i < count; i++) {
+        auto& e = entry(i);
+        if (symbol_length(e.symbol, strnlen(e.symbol, sizeof(e.symbol))) == len && !memcmp(e.symbol, symbol.data(), len)) {
+            idx = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t bus_reader::read(uint32_t idx, uint64_t& timestamp, trading_state& state,
+                          depth_level* bids, depth_level* asks, size_t levels) const
+{
+    if (idx >= symbol_count()) {
+        return 0;
+    }
+    size_t depth = _header->depth;
+    levels = std::min(levels, depth);
+    auto& e = entry(idx);
+    auto* words = entry_levels(e);
+    for (;;) {
+        uint64_t seq = e.seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        timestamp = e.timestamp.load(std::memory_order_relaxed);
+        state = static_cast<trading_state>(e.state.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < levels; i++) {
+            bids[i].price = words[2 * i].load(std::memory_order_relaxed);
+            bids[i].size  = words[2 * i + 1].load(std::memory_order_relaxed);
+            asks[i].price = words[2 * (depth + i)].load(std::memory_order_relaxed);
+            asks[i].size  = words[2 * (depth + i) + 1].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.seq.load(std::memory_order_relaxed) == seq) {
+            return seq / 2;
+        }
+    }
+}
+
+const bus::symbol_entry& bus_reader::entry(uint32_t idx) const
+{
+    return *reinterpret_cast<const bus::symbol_entry*>(_symbols + idx * _header->symbol_stride);
+}
+
+}
+
+}
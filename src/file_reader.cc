@@ -0,0 +1,396 @@
+#include "helix/file_reader.hh"
+
+#include "helix/replay.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifdef HELIX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HELIX_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace core {
+
+constexpr size_t file_reader::default_chunk_size;
+constexpr size_t file_reader::max_message_size;
+
+// Size of the reads of compressed input.
+static constexpr size_t input_size = 1024 * 1024;
+
+// Reads up to len bytes and returns fewer only at end of file.
+static size_t read_fully(int fd, char* buf, size_t len, const string& path)
+{
+    size_t nr = 0;
+    while (nr < len) {
+        ssize_t ret = ::read(fd, buf + nr, len - nr);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, system_category(), path);
+        }
+        if (!ret) {
+            break;
+        }
+        nr += ret;
+    }
+    return nr;
+}
+
+class file_decoder {
+protected:
+    int _fd;
+    string _path;
+public:
+    file_decoder(int fd, const string& path)
+        : _fd{fd}
+        , _path{path}
+    { }
+
+    virtual ~file_decoder() {
+        ::close(_fd);
+    }
+
+    virtual file_compression compression() const = 0;
+
+    // Decompresses up to len bytes and returns fewer only at end of file.
+    virtual size_t read(char* buf, size_t len) = 0;
+};
+
+class raw_decoder : public file_decoder {
+public:
+    using file_decoder::file_decoder;
+
+    file_compression compression() const override {
+        return file_compression::none;
+    }
+
+    size_t read(char* buf, size_t len) override {
+        return read_fully(_fd, buf, len, _path);
+    }
+};
+
+#ifdef HELIX_HAVE_ZLIB
+
+class gzip_decoder : public file_decoder {
+    z_stream _stream;
+    vector<char> _input;
+    bool _eof = false;
+    bool _member_end = false;
+public:
+    gzip_decoder(int fd, const string& path)
+        : file_decoder{fd, path}
+        , _input(input_size)
+    {
+        memset(&_stream, 0, sizeof(_stream));
+        // Decode gzip members only (15 window bits + 16).
+        if (inflateInit2(&_stream, 15 + 16) != Z_OK) {
+            throw runtime_error(path + ": unable to initialize gzip decoder");
+        }
+    }
+
+    ~gzip_decoder() {
+        inflateEnd(&_stream);
+    }
+
+    file_compression compression() const override {
+        return file_compression::gzip;
+    }
+
+    size_t read(char* buf, size_t len) override {
+        size_t nr = 0;
+        while (nr < len) {
+            if (!_stream.avail_in && !_eof) {
+                _stream.next_in = reinterpret_cast<Bytef*>(_input.data());
+                _stream.avail_in = read_fully(_fd, _input.data(), _input.size(), _path);
+                _eof = _stream.avail_in < _input.size();
+            }
+            size_t avail = len - nr;
+            _stream.next_out = reinterpret_cast<Bytef*>(buf + nr);
+            _stream.avail_out = avail;
+            int ret = inflate(&_stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                throw runtime_error(_path + ": " + (_stream.msg ? _stream.msg : "invalid gzip stream"));
+            }
+            size_t produced = avail - _stream.avail_out;
+            nr += produced;
+            if (ret == Z_STREAM_END) {
+                // A file can consist of several concatenated gzip members.
+                _member_end = true;
+                inflateReset(&_stream);
+            } else if (produced) {
+                _member_end = false;
+            }
+            if (!produced && !_stream.avail_in && _eof) {
+                if (!_member_end) {
+                    throw runtime_error(_path + ": truncated gzip stream");
+                }
+                break;
+            }
+        }
+        return nr;
+    }
+};
+
+#endif
+
+#ifdef HELIX_HAVE_ZSTD
+
+class zstd_decoder : public file_decoder {
+    ZSTD_DStream* _stream;
+    vector<char> _input;
+    ZSTD_inBuffer _in;
+    bool _eof = false;
+    bool _frame_end = false;
+public:
+    zstd_decoder(int fd, const string& path)
+        : file_decoder{fd, path}
+        , _stream{ZSTD_createDStream()}
+        , _input(max(input_size, ZSTD_DStreamInSize()))
+        , _in{_input.data(), 0, 0}
+    {
+        if (!_stream) {
+            throw runtime_error(path + ": unable to initialize zstd decoder");
+        }
+        ZSTD_initDStream(_stream);
+    }
+
+    ~zstd_decoder() {
+        ZSTD_freeDStream(_stream);
+    }
+
+    file_compression compression() const override {
+        return file_compression::zstd;
+    }
+
+    size_t read(char* buf, size_t len) override {
+        ZSTD_outBuffer out{buf, len, 0};
+        while (out.pos < out.size) {
+            if (_in.pos == _in.size && !_eof) {
+                _in.size = read_fully(_fd, _input.data(), _input.size(), _path);
+                _in.pos = 0;
+                _eof = _in.size < _input.size();
+            }
+            size_t pos = out.pos;
+            size_t ret = ZSTD_decompressStream(_stream, &out, &_in);
+            if (ZSTD_isError(ret)) {
+                throw runtime_error(_path + ": " + ZSTD_getErrorName(ret));
+            }
+            // A file can consist of several concatenated zstd frames.
+            if (!ret) {
+                _frame_end = true;
+            } else if (out.pos != pos) {
+                _frame_end = false;
+            }
+            if (out.pos == pos && _in.pos == _in.size && _eof) {
+                if (!_frame_end) {
+                    throw runtime_error(_path + ": truncated zstd stream");
+                }
+                break;
+            }
+        }
+        return out.pos;
+    }
+};
+
+#endif
+
+static file_compression detect_compression(int fd, const string& path)
+{
+    unsigned char magic[4] = {};
+    ssize_t nr;
+    do {
+        nr = ::pread(fd, magic, sizeof(magic), 0);
+    } while (nr < 0 && errno == EINTR);
+    if (nr < 0) {
+        throw system_error(errno, system_category(), path);
+    }
+    if (nr >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return file_compression::gzip;
+    }
+    if (nr >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return file_compression::zstd;
+    }
+    return file_compression::none;
+}
+
+static unique_ptr<file_decoder> make_decoder(const string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), path);
+    }
+    file_compression compression;
+    try {
+        compression = detect_compression(fd, path);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    // The decoder owns the file descriptor once it is constructed.
+    switch (compression) {
+    case file_compression::gzip:
+#ifdef HELIX_HAVE_ZLIB
+        return unique_ptr<file_decoder>{new gzip_decoder{fd, path}};
+#else
+        ::close(fd);
+        throw runtime_error(path + ": gzip compressed files are not supported by this build");
+#endif
+    case file_compression::zstd:
+#ifdef HELIX_HAVE_ZSTD
+        return unique_ptr<file_decoder>{new zstd_decoder{fd, path}};
+#else
+        ::close(fd);
+        throw runtime_error(path + ": zstd compressed files are not supported by this build");
+#endif
+    case file_compression::none:
+        break;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return unique_ptr<file_decoder>{new raw_decoder{fd, path}};
+}
+
+file_reader::file_reader(const std::string& path, size_t chunk_size)
+    : _path{path}
+    , _chunk_size{chunk_size}
+{
+    if (chunk_size < max_message_size) {
+        throw invalid_argument("chunk size is smaller than the maximum message size");
+    }
+    _decoder = make_decoder(path);
+    for (auto&& b : _buffers) {
+        b.data.resize(max_message_size + chunk_size);
+    }
+    _thread = std::thread{&file_reader::run, this};
+}
+
+file_reader::~file_reader()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+file_compression file_reader::compression() const
+{
+    return _decoder->compression();
+}
+
+void file_reader::run()
+{
+    try {
+        for (size_t idx = 0;; idx ^= 1) {
+            auto&& b = _buffers[idx];
+            {
+                std::unique_lock<std::mutex> lock{_mutex};
+                _cond.wait(lock, [&] { return !b.full || _stop; });
+                if (_stop) {
+                    return;
+                }
+            }
+            size_t size = _decoder->read(chunk(b), _chunk_size);
+            {
+                std::lock_guard<std::mutex> lock{_mutex};
+                b.size = size;
+                b.last = size < _chunk_size;
+                b.full = true;
+            }
+            _cond.notify_all();
+            if (b.last) {
+                return;
+            }
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _error = std::current_exception();
+        }
+        _cond.notify_all();
+    }
+}
+
+file_reader::buffer& file_reader::acquire(size_t idx)
+{
+    auto&& b = _buffers[idx];
+    std::unique_lock<std::mutex> lock{_mutex};
+    _cond.wait(lock, [&] { return b.full || _error; });
+    if (!b.full) {
+        std::rethrow_exception(_error);
+    }
+    return b;
+}
+
+void file_reader::release(size_t idx)
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _buffers[idx].full = false;
+    }
+    _cond.notify_all();
+}
+
+uint64_t file_reader::replay(session& s)
+{
+    return replay_records(s, nullptr);
+}
+
+uint64_t file_reader::replay(session& s, replay_clock& clock)
+{
+    return replay_records(s, &clock);
+}
+
+uint64_t file_reader::replay_records(session& s, replay_clock* clock)
+{
+    uint64_t total = 0;
+    const char* tail = nullptr;
+    size_t carry = 0;
+    for (size_t idx = 0;; idx ^= 1) {
+        auto&& b = acquire(idx);
+        // Move the unprocessed tail of the previous chunk in front of this
+        // chunk so that a straddling message is contiguous.
+        char* start = chunk(b) - carry;
+        if (tail) {
+            memcpy(start, tail, carry);
+            release(idx ^ 1);
+        }
+        const char* p = start;
+        const char* end = chunk(b) + b.size;
+        while (p < end && (b.last || size_t(end - p) >= max_message_size)) {
+            net::packet_view packet{p, size_t(end - p)};
+            if (clock) {
+                clock->wait(s.packet_time(packet));
+            }
+            size_t nr = s.process_packet(packet);
+            if (!nr) {
+                return total;
+            }
+            p += nr;
+            total += nr;
+        }
+        if (b.last) {
+            return total;
+        }
+        tail = p;
+        carry = end - p;
+    }
+}
+
+}
+
+}
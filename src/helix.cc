@@ -2,10 +2,25 @@
 
 #include "helix/nasdaq/nordic_itch_session.hh"
 #include "helix/nasdaq/itch50_session.hh"
+#include "helix/nasdaq/itch50_index.hh"
+#include "helix/nasdaq/moldudp_sender.hh"
+#include "helix/file_reader.hh"
+#include "helix/aggregator.hh"
+#include "helix/bus.hh"
+#include "helix/latency.hh"
+#include "helix/replay.hh"
+#include "helix/snapshot.hh"
 #include "helix/net.hh"
+#include "helix/udp.hh"
 
+#include <system_error>
+#include <stdexcept>
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
 #include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -31,6 +46,110 @@ inline helix::core::trade* unwrap(helix_trade_t ob)
     return reinterpret_cast<helix::core::trade*>(ob);
 }
 
+inline helix_udp_receiver_t wrap(helix::net::udp_receiver* rx)
+{
+    return reinterpret_cast<helix_udp_receiver_t>(rx);
+}
+
+inline helix::net::udp_receiver* unwrap(helix_udp_receiver_t rx)
+{
+    return reinterpret_cast<helix::net::udp_receiver*>(rx);
+}
+
+inline helix_snapshot_t wrap(helix::core::snapshot* s)
+{
+    return reinterpret_cast<helix_snapshot_t>(s);
+}
+
+inline helix::core::snapshot* unwrap(helix_snapshot_t s)
+{
+    return reinterpret_cast<helix::core::snapshot*>(s);
+}
+
+inline helix_index_t wrap(helix::nasdaq::itch50_index* index)
+{
+    return reinterpret_cast<helix_index_t>(index);
+}
+
+inline helix::nasdaq::itch50_index* unwrap(helix_index_t index)
+{
+    return reinterpret_cast<helix::nasdaq::itch50_index*>(index);
+}
+
+namespace {
+
+// Aggregator of the C API, which carries the opaque context data.
+struct c_aggregator : public helix::core::aggregator {
+    void* data;
+
+    c_aggregator(size_t depth, void* data_)
+        : helix::core::aggregator{depth}
+        , data{data_}
+    { }
+};
+
+}
+
+inline helix_aggregator_t wrap(c_aggregator* agg)
+{
+    return reinterpret_cast<helix_aggregator_t>(agg);
+}
+
+inline c_aggregator* unwrap(helix_aggregator_t agg)
+{
+    return reinterpret_cast<c_aggregator*>(agg);
+}
+
+inline helix_consolidated_book_t wrap(const helix::core::consolidated_book* book)
+{
+    return reinterpret_cast<helix_consolidated_book_t>(const_cast<helix::core::consolidated_book*>(book));
+}
+
+inline const helix::core::consolidated_book* unwrap(helix_consolidated_book_t book)
+{
+    return reinterpret_cast<const helix::core::consolidated_book*>(book);
+}
+
+inline helix_bus_t wrap(helix::core::bus_publisher* bus)
+{
+    return reinterpret_cast<helix_bus_t>(bus);
+}
+
+inline helix::core::bus_publisher* unwrap(helix_bus_t bus)
+{
+    return reinterpret_cast<helix::core::bus_publisher*>(bus);
+}
+
+inline helix_bus_reader_t wrap(helix::core::bus_reader* reader)
+{
+    return reinterpret_cast<helix_bus_reader_t>(reader);
+}
+
+inline helix::core::bus_reader* unwrap(helix_bus_reader_t reader)
+{
+    return reinterpret_cast<helix::core::bus_reader*>(reader);
+}
+
+inline helix_moldudp_sender_t wrap(helix::nasdaq::moldudp_sender* sender)
+{
+    return reinterpret_cast<helix_moldudp_sender_t>(sender);
+}
+
+inline helix::nasdaq::moldudp_sender* unwrap(helix_moldudp_sender_t sender)
+{
+    return reinterpret_cast<helix::nasdaq::moldudp_sender*>(sender);
+}
+
+inline helix_published_book_t wrap(const helix::core::published_book* book)
+{
+    return reinterpret_cast<helix_published_book_t>(const_cast<helix::core::published_book*>(book));
+}
+
+inline const helix::core::published_book* unwrap(helix_published_book_t book)
+{
+    return reinterpret_cast<const helix::core::published_book*>(book);
+}
+
 inline helix_protocol_t wrap(helix::core::protocol* proto)
 {
     return reinterpret_cast<helix_protocol_t>(proto);
@@ -62,10 +181,9 @@ helix_protocol_t helix_protocol_lookup(const char *name)
     return NULL;
 }
 
-helix_session_t
-helix_session_create(helix_protocol_t proto, helix_order_book_callback_t ob_callback, helix_trade_callback_t trade_callback, void *data)
+static helix_session_t
+register_callbacks(helix::core::session* session, helix_order_book_callback_t ob_callback, helix_trade_callback_t trade_callback)
 {
-    auto session = unwrap(proto)->new_session(data);
     session->register_callback([session, ob_callback](const helix::core::order_book& ob) {
         ob_callback(wrap(session), wrap(const_cast<helix::core::order_book*>(&ob)));
     });
@@ -75,11 +193,154 @@ helix_session_create(helix_protocol_t proto, helix_order_book_callback_t ob_call
     return wrap(session);
 }
 
+helix_session_t
+helix_session_create(helix_protocol_t proto, helix_order_book_callback_t ob_callback, helix_trade_callback_t trade_callback, void *data)
+{
+    auto session = unwrap(proto)->new_session(data);
+    return register_callbacks(session, ob_callback, trade_callback);
+}
+
+helix_session_t
+helix_session_create_sharded(helix_protocol_t proto, size_t shards, helix_order_book_callback_t ob_callback, helix_trade_callback_t trade_callback, void *data)
+{
+    auto session = unwrap(proto)->new_sharded_session(shards, data);
+    if (!session) {
+        return NULL;
+    }
+    return register_callbacks(session, ob_callback, trade_callback);
+}
+
+static helix::core::level_config to_level_config(const helix_level_config_t *config)
+{
+    helix::core::level_config levels;
+    if (!config) {
+        return levels;
+    }
+    if (config->storage == HELIX_LEVEL_STORAGE_LADDER) {
+        levels.storage = helix::core::level_storage::ladder;
+    }
+    if (config->tick_size) {
+        levels.tick_size = config->tick_size;
+    }
+    if (config->window) {
+        levels.window = config->window;
+    }
+    levels.depth = config->depth;
+    levels.published_depth = config->published_depth;
+    levels.order_queues = config->order_queues;
+    return levels;
+}
+
 void helix_session_subscribe(helix_session_t session, const char *symbol, size_t max_orders)
 {
     unwrap(session)->subscribe(symbol, max_orders);
 }
 
+void helix_session_subscribe_ex(helix_session_t session, const char *symbol, size_t max_orders,
+                                const helix_level_config_t *levels)
+{
+    unwrap(session)->subscribe(symbol, max_orders, to_level_config(levels));
+}
+
+void helix_session_set_conflation(helix_session_t session, int enabled)
+{
+    unwrap(session)->set_conflation(enabled);
+}
+
+void helix_session_subscribe_depth(helix_session_t session, const char *symbol, size_t max_orders, size_t depth)
+{
+    helix_level_config_t levels = {};
+    levels.depth = depth;
+    helix_session_subscribe_ex(session, symbol, max_orders, &levels);
+}
+
+void helix_session_subscribe_published(helix_session_t session, const char *symbol, size_t max_orders, size_t depth)
+{
+    helix_level_config_t levels = {};
+    levels.published_depth = depth;
+    helix_session_subscribe_ex(session, symbol, max_orders, &levels);
+}
+
+void helix_session_subscribe_orders(helix_session_t session, const char *symbol, size_t max_orders)
+{
+    helix_level_config_t levels = {};
+    levels.order_queues = 1;
+    helix_session_subscribe_ex(session, symbol, max_orders, &levels);
+}
+
+void helix_session_subscribe_all(helix_session_t session, size_t max_orders)
+{
+    helix_session_subscribe_all_ex(session, max_orders, NULL);
+}
+
+void helix_session_subscribe_all_ex(helix_session_t session, size_t max_orders, const helix_level_config_t *levels)
+{
+    unwrap(session)->subscribe_all(max_orders, to_level_config(levels));
+}
+
+size_t helix_session_memory_usage(helix_session_t session)
+{
+    return unwrap(session)->memory_usage();
+}
+
+void helix_session_set_order_callback(helix_session_t session, helix_order_callback_t order_callback)
+{
+    auto s = unwrap(session);
+    s->register_callback([s, order_callback](const helix::core::order_event& e) {
+        helix_order_event_t event;
+        event.type = static_cast<helix_order_event_type_t>(e.type);
+        event.order_book = wrap(const_cast<helix::core::order_book*>(e.book));
+        event.timestamp = e.timestamp;
+        event.order_id = e.id;
+        event.side = static_cast<helix_side_t>(e.side);
+        event.price = e.price;
+        event.quantity = e.quantity;
+        event.previous_quantity = e.previous_quantity;
+        order_callback(wrap(s), &event);
+    });
+}
+
+int helix_session_queue_position(helix_session_t session, uint64_t order_id, helix_queue_position_t *pos)
+{
+    helix::core::queue_position p;
+    try {
+        if (unwrap(session)->position(order_id, p) != helix::core::status::ok) {
+            errno = ENOENT;
+            return -1;
+        }
+    } catch (const std::logic_error& e) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    pos->orders = p.orders;
+    pos->quantity = p.quantity;
+    return 0;
+}
+
+void helix_session_set_retransmit_callback(helix_session_t session, helix_retransmit_callback_t retransmit_callback)
+{
+    auto s = unwrap(session);
+    s->set_retransmit_callback([s, retransmit_callback](uint64_t seq_num, uint64_t count) {
+        retransmit_callback(wrap(s), seq_num, count);
+    });
+}
+
+void helix_session_set_error_callback(helix_session_t session, helix_error_callback_t error_callback)
+{
+    auto s = unwrap(session);
+    s->set_error_callback([s, error_callback](helix::core::status status, uint64_t value) {
+        error_callback(wrap(s), static_cast<helix_error_t>(status), value);
+    });
+}
+
+uint64_t helix_session_error_count(helix_session_t session, helix_error_t error)
+{
+    if (error < HELIX_ERROR_UNKNOWN_ORDER || error > HELIX_ERROR_MESSAGES_LOST) {
+        return 0;
+    }
+    return unwrap(session)->error_count(static_cast<helix::core::status>(error));
+}
+
 void *helix_session_data(helix_session_t session)
 {
     return unwrap(session)->data();
@@ -90,6 +351,78 @@ size_t helix_session_process_packet(helix_session_t session, const char* buf, si
     return unwrap(session)->process_packet(helix::net::packet_view{buf, len});
 }
 
+size_t helix_session_process_line_packet(helix_session_t session, helix_feed_line_t line, const char* buf, size_t len)
+{
+    auto l = line == HELIX_FEED_LINE_B ? helix::core::feed_line::b : helix::core::feed_line::a;
+    return unwrap(session)->process_line_packet(l, helix::net::packet_view{buf, len});
+}
+
+size_t helix_session_process_packets(helix_session_t session, const struct iovec *packets, size_t count)
+{
+    static thread_local std::vector<helix::net::packet_view> views;
+    views.clear();
+    for (size_t i = 0; i < count; i++) {
+        views.emplace_back(static_cast<const char*>(packets[i].iov_base), packets[i].iov_len);
+    }
+    return unwrap(session)->process_packets(views.data(), views.size());
+}
+
+int64_t helix_session_replay_file(helix_session_t session, const char *path)
+{
+    try {
+        helix::core::file_reader reader{path};
+        return reader.replay(*unwrap(session));
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+int64_t helix_session_replay_file_paced(helix_session_t session, const char *path, double speed, uint64_t max_gap,
+                                        helix_replay_stats_t *stats)
+{
+    try {
+        helix::core::replay_clock clock{speed, max_gap};
+        helix::core::file_reader reader{path};
+        int64_t nr = reader.replay(*unwrap(session), clock);
+        if (stats) {
+            stats->late = clock.late_count();
+            stats->lag_p50 = clock.lag().percentile(50);
+            stats->lag_p99 = clock.lag().percentile(99);
+            stats->lag_max = clock.lag().max();
+        }
+        return nr;
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+        return -1;
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+int helix_session_set_mirror(helix_session_t session, helix_moldudp_sender_t sender)
+{
+    // The caller owns the sender, so the session only borrows it.
+    std::shared_ptr<helix::net::message_parser> mirror;
+    if (sender) {
+        mirror.reset(unwrap(sender), [](helix::net::message_parser*) { });
+    }
+    try {
+        unwrap(session)->set_mirror(std::move(mirror));
+    } catch (const std::logic_error& e) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    return 0;
+}
+
 const char *helix_order_book_symbol(helix_order_book_t ob)
 {
     return unwrap(ob)->symbol().c_str();
@@ -115,6 +448,11 @@ size_t helix_order_book_order_count(helix_order_book_t ob)
     return unwrap(ob)->order_count();
 }
 
+size_t helix_order_book_memory_usage(helix_order_book_t ob)
+{
+    return unwrap(ob)->memory_usage();
+}
+
 helix_price_t helix_order_book_bid_price(helix_order_book_t ob, size_t level)
 {
     return unwrap(ob)->bid_price(level);
@@ -140,10 +478,20 @@ helix_price_t helix_order_book_midprice(helix_order_book_t ob, size_t level)
     return unwrap(ob)->midprice(level);
 }
 
-helix_trading_state_t helix_order_book_state(helix_order_book_t ob)
+static_assert(sizeof(helix_price_level_t) == sizeof(helix::core::depth_level), "depth level layout mismatch");
+static_assert(offsetof(helix_price_level_t, price) == offsetof(helix::core::depth_level, price), "depth level layout mismatch");
+static_assert(offsetof(helix_price_level_t, size) == offsetof(helix::core::depth_level, size), "depth level layout mismatch");
+
+void helix_order_book_depth(helix_order_book_t ob, helix_price_level_t *bids, helix_price_level_t *asks, size_t depth)
+{
+    unwrap(ob)->depth(reinterpret_cast<helix::core::depth_level*>(bids),
+                      reinterpret_cast<helix::core::depth_level*>(asks), depth);
+}
+
+static helix_trading_state_t wrap(helix::core::trading_state state)
 {
     using namespace helix::core;
-    switch (unwrap(ob)->state()) {
+    switch (state) {
     case trading_state::unknown:        return HELIX_TRADING_STATE_UNKNOWN;
     case trading_state::halted:         return HELIX_TRADING_STATE_HALTED;
     case trading_state::paused:         return HELIX_TRADING_STATE_PAUSED;
@@ -154,9 +502,47 @@ helix_trading_state_t helix_order_book_state(helix_order_book_t ob)
     assert(0);
 }
 
+helix_trading_state_t helix_order_book_state(helix_order_book_t ob)
+{
+    return wrap(unwrap(ob)->state());
+}
+
+helix_published_book_t helix_order_book_published(helix_order_book_t ob)
+{
+    return wrap(unwrap(ob)->published());
+}
+
+size_t helix_published_book_depth(helix_published_book_t book)
+{
+    return unwrap(book)->depth();
+}
+
+uint64_t helix_published_book_version(helix_published_book_t book)
+{
+    return unwrap(book)->version();
+}
+
+uint64_t helix_published_book_read(helix_published_book_t book, helix_timestamp_t *timestamp, helix_trading_state_t *state,
+                                   helix_price_level_t *bids, helix_price_level_t *asks, size_t depth)
+{
+    auto* pb = unwrap(book);
+    auto* b = reinterpret_cast<helix::core::depth_level*>(bids);
+    auto* a = reinterpret_cast<helix::core::depth_level*>(asks);
+    helix::core::trading_state s;
+    uint64_t version = pb->read(*timestamp, s, b, a, depth);
+    *state = wrap(s);
+    for (size_t i = pb->depth(); i < depth; i++) {
+        b[i].price = std::numeric_limits<uint64_t>::min();
+        b[i].size  = 0;
+        a[i].price = std::numeric_limits<uint64_t>::max();
+        a[i].size  = 0;
+    }
+    return version;
+}
+
 const char *helix_trade_symbol(helix_trade_t trade)
 {
-    return unwrap(trade)->symbol.c_str();
+    return unwrap(trade)->symbol;
 }
 
 uint64_t helix_trade_timestamp(helix_trade_t trade)
@@ -174,9 +560,9 @@ uint64_t helix_trade_size(helix_trade_t trade)
     return unwrap(trade)->size;
 }
 
-helix_trade_sign_t helix_trade_sign(helix_trade_t trade)
+static helix_trade_sign_t wrap(helix::core::trade_sign sign)
 {
-    switch (unwrap(trade)->sign) {
+    switch (sign) {
     case helix::core::trade_sign::buyer_initiated:  return HELIX_TRADE_SIGN_BUYER_INITIATED;
     case helix::core::trade_sign::seller_initiated: return HELIX_TRADE_SIGN_SELLER_INITIATED;
     case helix::core::trade_sign::crossing:         return HELIX_TRADE_SIGN_CROSSING;
@@ -184,3 +570,472 @@ helix_trade_sign_t helix_trade_sign(helix_trade_t trade)
     }
     assert(0);
 }
+
+helix_trade_sign_t helix_trade_sign(helix_trade_t trade)
+{
+    return wrap(unwrap(trade)->sign);
+}
+
+helix_timestamp_t helix_session_clock(helix_session_t session)
+{
+    return unwrap(session)->clock();
+}
+
+static void summarize(const helix::core::latency_histogram& h, double ticks_per_nsec, helix_latency_t* latency)
+{
+    latency->count = h.count();
+    latency->p50   = h.percentile(50.0) / ticks_per_nsec;
+    latency->p99   = h.percentile(99.0) / ticks_per_nsec;
+    latency->p999  = h.percentile(99.9) / ticks_per_nsec;
+    latency->max   = h.max() / ticks_per_nsec;
+}
+
+int helix_session_latency(helix_session_t session, char message_type, helix_latency_t* latency)
+{
+    auto* stats = unwrap(session)->latency();
+    if (!stats) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    auto* h = stats->processing(message_type);
+    if (!h) {
+        errno = ENOENT;
+        return -1;
+    }
+    summarize(*h, helix::core::tsc_ticks_per_nsec(), latency);
+    return 0;
+}
+
+int helix_session_wire_latency(helix_session_t session, helix_latency_t* latency)
+{
+    auto* stats = unwrap(session)->latency();
+    if (!stats) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    if (!stats->wire().count()) {
+        errno = ENOENT;
+        return -1;
+    }
+    summarize(stats->wire(), 1.0, latency);
+    return 0;
+}
+
+helix_snapshot_t helix_session_snapshot(helix_session_t session)
+{
+    std::unique_ptr<helix::core::snapshot> s{new helix::core::snapshot};
+    try {
+        unwrap(session)->save(*s);
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+        return NULL;
+    } catch (const std::logic_error& e) {
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+    return wrap(s.release());
+}
+
+int helix_snapshot_write(helix_snapshot_t s, const char *path)
+{
+    try {
+        unwrap(s)->write(path);
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t helix_snapshot_seq_num(helix_snapshot_t s)
+{
+    return unwrap(s)->seq_num();
+}
+
+void helix_snapshot_free(helix_snapshot_t s)
+{
+    delete unwrap(s);
+}
+
+int helix_session_restore(helix_session_t session, const char *path)
+{
+    try {
+        helix::core::mapped_snapshot s{path};
+        unwrap(session)->restore(s);
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+        return -1;
+    } catch (const std::logic_error& e) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int helix_index_build(const char *input, const char *output, helix_timestamp_t interval)
+{
+    try {
+        if (interval) {
+            helix::nasdaq::itch50_index::build(input, output, interval);
+        } else {
+            helix::nasdaq::itch50_index::build(input, output);
+        }
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+helix_index_t helix_index_open(const char *path)
+{
+    try {
+        return wrap(new helix::nasdaq::itch50_index{path});
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_index_close(helix_index_t index)
+{
+    delete unwrap(index);
+}
+
+uint64_t helix_index_file_size(helix_index_t index)
+{
+    return unwrap(index)->file_size();
+}
+
+uint64_t helix_index_seek(helix_index_t index, helix_timestamp_t timestamp)
+{
+    return unwrap(index)->seek(timestamp);
+}
+
+const uint64_t *helix_index_symbol_offsets(helix_index_t index, const char *symbol, size_t *count)
+{
+    return unwrap(index)->offsets(symbol, *count);
+}
+
+helix_udp_receiver_t helix_udp_receiver_open(const helix_udp_config_t *config)
+{
+    helix::net::udp_config cfg;
+    cfg.multicast_addr = config->multicast_addr;
+    if (config->interface_addr) {
+        cfg.interface_addr = config->interface_addr;
+    }
+    cfg.port = config->port;
+    if (config->batch_size) {
+        cfg.batch_size = config->batch_size;
+    }
+    cfg.rcvbuf_size = config->rcvbuf_size;
+    cfg.busy_poll_usec = config->busy_poll_usec;
+    cfg.timestamps = config->timestamps;
+    cfg.line = config->line == HELIX_FEED_LINE_B ? helix::core::feed_line::b : helix::core::feed_line::a;
+    try {
+        return wrap(new helix::net::udp_receiver{cfg});
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_udp_receiver_close(helix_udp_receiver_t rx)
+{
+    delete unwrap(rx);
+}
+
+int helix_udp_receiver_fd(helix_udp_receiver_t rx)
+{
+    return unwrap(rx)->fd();
+}
+
+int helix_udp_receiver_process(helix_udp_receiver_t rx, helix_session_t session, int wait)
+{
+    try {
+        return unwrap(rx)->receive(*unwrap(session), wait);
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    }
+    return -1;
+}
+
+helix_timestamp_t helix_udp_receiver_timestamp(helix_udp_receiver_t rx)
+{
+    return unwrap(rx)->timestamp();
+}
+
+helix_moldudp_sender_t helix_moldudp_sender_open(const helix_moldudp_sender_config_t *config)
+{
+    helix::nasdaq::moldudp_sender_config cfg;
+    cfg.multicast_addr = config->multicast_addr;
+    if (config->interface_addr) {
+        cfg.interface_addr = config->interface_addr;
+    }
+    cfg.port = config->port;
+    if (config->ttl) {
+        cfg.ttl = config->ttl;
+    }
+    cfg.loopback = config->loopback;
+    if (config->session) {
+        cfg.session = config->session;
+    }
+    if (config->max_packet_size) {
+        cfg.max_packet_size = config->max_packet_size;
+    }
+    try {
+        return wrap(new helix::nasdaq::moldudp_sender{cfg});
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_moldudp_sender_close(helix_moldudp_sender_t sender)
+{
+    delete unwrap(sender);
+}
+
+int helix_moldudp_sender_end_session(helix_moldudp_sender_t sender)
+{
+    try {
+        unwrap(sender)->end_session();
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t helix_moldudp_sender_packet_count(helix_moldudp_sender_t sender)
+{
+    return unwrap(sender)->packet_count();
+}
+
+helix_aggregator_t helix_aggregator_create(size_t depth, helix_nbbo_callback_t nbbo_callback, void *data)
+{
+    try {
+        auto* agg = new c_aggregator{depth, data};
+        agg->register_callback([agg, nbbo_callback](const helix::core::consolidated_book& book) {
+            nbbo_callback(wrap(agg), wrap(&book));
+        });
+        return wrap(agg);
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_aggregator_destroy(helix_aggregator_t agg)
+{
+    delete unwrap(agg);
+}
+
+void *helix_aggregator_data(helix_aggregator_t agg)
+{
+    return unwrap(agg)->data;
+}
+
+size_t helix_aggregator_add_venue(helix_aggregator_t agg)
+{
+    return unwrap(agg)->add_venue();
+}
+
+int helix_aggregator_map_symbol(helix_aggregator_t agg, size_t venue, const char *venue_symbol, const char *instrument)
+{
+    try {
+        unwrap(agg)->map_symbol(venue, venue_symbol, instrument);
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void helix_aggregator_update(helix_aggregator_t agg, size_t venue, helix_order_book_t ob)
+{
+    unwrap(agg)->update(venue, *unwrap(ob));
+}
+
+helix_consolidated_book_t helix_aggregator_lookup(helix_aggregator_t agg, const char *instrument)
+{
+    auto* book = unwrap(agg)->find(instrument);
+    if (!book) {
+        return NULL;
+    }
+    return wrap(book);
+}
+
+const char *helix_consolidated_book_symbol(helix_consolidated_book_t book)
+{
+    return unwrap(book)->symbol().c_str();
+}
+
+helix_timestamp_t helix_consolidated_book_timestamp(helix_consolidated_book_t book)
+{
+    return unwrap(book)->timestamp();
+}
+
+helix_price_t helix_consolidated_book_bid_price(helix_consolidated_book_t book, size_t level)
+{
+    return unwrap(book)->bid_price(level);
+}
+
+uint64_t helix_consolidated_book_bid_size(helix_consolidated_book_t book, size_t level)
+{
+    return unwrap(book)->bid_size(level);
+}
+
+helix_price_t helix_consolidated_book_ask_price(helix_consolidated_book_t book, size_t level)
+{
+    return unwrap(book)->ask_price(level);
+}
+
+uint64_t helix_consolidated_book_ask_size(helix_consolidated_book_t book, size_t level)
+{
+    return unwrap(book)->ask_size(level);
+}
+
+size_t helix_consolidated_book_bid_venue(helix_consolidated_book_t book)
+{
+    return unwrap(book)->bid_venue();
+}
+
+size_t helix_consolidated_book_ask_venue(helix_consolidated_book_t book)
+{
+    return unwrap(book)->ask_venue();
+}
+
+helix_bus_t helix_bus_create(const char *name, size_t capacity, size_t max_symbols, size_t depth)
+{
+    try {
+        return wrap(new helix::core::bus_publisher{name, capacity, max_symbols, depth});
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    } catch (const std::invalid_argument& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_bus_destroy(helix_bus_t bus)
+{
+    delete unwrap(bus);
+}
+
+int helix_bus_publish_order_book(helix_bus_t bus, helix_order_book_t ob)
+{
+    if (!unwrap(bus)->publish(*unwrap(ob))) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return 0;
+}
+
+int helix_bus_publish_trade(helix_bus_t bus, helix_trade_t trade)
+{
+    if (!unwrap(bus)->publish(*unwrap(trade))) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return 0;
+}
+
+helix_bus_reader_t helix_bus_reader_open(const char *name)
+{
+    try {
+        return wrap(new helix::core::bus_reader{name});
+    } catch (const std::system_error& e) {
+        errno = e.code().value();
+    } catch (const std::runtime_error& e) {
+        errno = EINVAL;
+    }
+    return NULL;
+}
+
+void helix_bus_reader_close(helix_bus_reader_t reader)
+{
+    delete unwrap(reader);
+}
+
+int helix_bus_reader_poll(helix_bus_reader_t reader, helix_bus_event_t *event)
+{
+    helix::core::bus_event e;
+    if (!unwrap(reader)->poll(e)) {
+        return 0;
+    }
+    memset(event, 0, sizeof(*event));
+    event->type = static_cast<helix_bus_event_type_t>(e.type);
+    event->symbol = e.symbol;
+    event->timestamp = e.timestamp;
+    if (e.type == helix::core::bus::event_type::trade) {
+        event->sign = wrap(e.sign);
+        event->price = e.price;
+        event->size = e.size;
+    } else {
+        event->state = wrap(e.state);
+        event->bid = helix_price_level_t{e.bid.price, e.bid.size};
+        event->ask = helix_price_level_t{e.ask.price, e.ask.size};
+    }
+    return 1;
+}
+
+uint64_t helix_bus_reader_lost(helix_bus_reader_t reader)
+{
+    return unwrap(reader)->lost();
+}
+
+size_t helix_bus_reader_depth(helix_bus_reader_t reader)
+{
+    return unwrap(reader)->depth();
+}
+
+size_t helix_bus_reader_symbol_count(helix_bus_reader_t reader)
+{
+    return unwrap(reader)->symbol_count();
+}
+
+const char *helix_bus_reader_symbol(helix_bus_reader_t reader, uint32_t symbol)
+{
+    return unwrap(reader)->symbol(symbol);
+}
+
+int64_t helix_bus_reader_find(helix_bus_reader_t reader, const char *symbol)
+{
+    uint32_t idx;
+    if (!unwrap(reader)->find(symbol, idx)) {
+        return -1;
+    }
+    return idx;
+}
+
+uint64_t helix_bus_reader_read(helix_bus_reader_t reader, uint32_t symbol, helix_timestamp_t *timestamp, helix_trading_state_t *state,
+                               helix_price_level_t *bids, helix_price_level_t *asks, size_t depth)
+{
+    auto* r = unwrap(reader);
+    auto* b = reinterpret_cast<helix::core::depth_level*>(bids);
+    auto* a = reinterpret_cast<helix::core::depth_level*>(asks);
+    helix::core::trading_state s = helix::core::trading_state::unknown;
+    *timestamp = 0;
+    uint64_t version = r->read(symbol, *timestamp, s, b, a, depth);
+    *state = wrap(s);
+    for (size_t i = version ? r->depth() : 0; i < depth; i++) {
+        b[i].price = std::numeric_limits<uint64_t>::min();
+        b[i].size  = 0;
+        a[i].price = std::numeric_limits<uint64_t>::max();
+        a[i].size  = 0;
+    }
+    return version;
+}
@@ -0,0 +1,115 @@
+#include "helix/latency.hh"
+
+#include <algorithm>
+
+namespace helix {
+
+namespace core {
+
+constexpr unsigned latency_histogram::sub_bucket_bits;
+constexpr uint64_t latency_histogram::sub_buckets;
+constexpr unsigned latency_histogram::max_value_bits;
+constexpr size_t latency_histogram::bucket_count;
+
+static uint64_t monotonic_nsec()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static double calibrate_tsc()
+{
+    struct timespec interval = {0, 10000000};
+    uint64_t start_nsec = monotonic_nsec();
+    uint64_t start_tsc = read_tsc();
+    ::nanosleep(&interval, nullptr);
+    uint64_t end_tsc = read_tsc();
+    uint64_t end_nsec = monotonic_nsec();
+    return double(end_tsc - start_tsc) / double(end_nsec - start_nsec);
+}
+
+double tsc_ticks_per_nsec()
+{
+    static const double ticks_per_nsec = calibrate_tsc();
+    return ticks_per_nsec;
+}
+
+latency_histogram::latency_histogram()
+    : _max{0}
+{
+    for (auto&& count : _counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t latency_histogram::count() const
+{
+    uint64_t total = 0;
+    for (auto&& count : _counts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t latency_histogram::highest_equivalent(size_t idx)
+{
+    if (idx < 2 * sub_buckets) {
+        return idx;
+    }
+    unsigned shift = idx / sub_buckets - 1;
+    uint64_t lowest = (sub_buckets + idx % sub_buckets) << shift;
+    return lowest + (uint64_t(1) << shift) - 1;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (!total) {
+        return 0;
+    }
+    // Rank of the sample at the percentile, rounded up.
+    uint64_t rank = p / 100.0 * total;
+    if (rank < total && double(rank) < p / 100.0 * total) {
+        rank++;
+    }
+    if (!rank) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; i++) {
+        seen += _counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(highest_equivalent(i), max());
+        }
+    }
+    return max();
+}
+
+latency_stats::latency_stats()
+    : _rx_timestamp{0}
+{
+    for (auto&& h : _processing) {
+        h.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+latency_stats::~latency_stats()
+{
+    for (auto&& h : _processing) {
+        delete h.load(std::memory_order_relaxed);
+    }
+}
+
+latency_histogram* latency_stats::create(uint8_t type)
+{
+    // Only the writer creates histograms, which it does once per message
+    // type, so readers only need to see the histogram initialized.
+    auto* h = new latency_histogram{};
+    _processing[type].store(h, std::memory_order_release);
+    return h;
+}
+
+}
+
+}
@@ -23,6 +23,11 @@ size_t binaryfile_session::parse(const net::packet_view& packet)
         return 0;
     }
     size_t offset = sizeof(uint16_t);
+    // Prefetch the header of the next message while this one is processed.
+    size_t next = offset + payload_len;
+    if (next < packet.len()) {
+        __builtin_prefetch(packet.buf() + next);
+    }
     while (payload_len) {
         size_t nr = _parser->parse(net::packet_view{packet.buf() + offset, payload_len});
         if (nr > payload_len) {
@@ -31,6 +36,7 @@ size_t binaryfile_session::parse(const net::packet_view& packet)
         payload_len -= nr;
         offset += nr;
     }
+    _parser->flush();
     return offset;
 }
 
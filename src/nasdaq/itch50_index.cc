@@ -0,0 +1,239 @@
+#include "helix/nasdaq/itch50_index.hh"
+
+#include "helix/nasdaq/itch50_handler.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <limits>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace nasdaq {
+
+static const char index_magic[8] = {'H', 'E', 'L', 'I', 'X', 'I', 'D', 'X'};
+
+static constexpr uint32_t locate_count = numeric_limits<uint16_t>::max() + 1;
+
+constexpr uint32_t itch50_index::version;
+constexpr uint64_t itch50_index::default_interval;
+
+static const char* map_file(const string& path, size_t& size)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw system_error(err, system_category(), path);
+    }
+    size = st.st_size;
+    if (!size) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw system_error(err, system_category(), path);
+    }
+    return static_cast<const char*>(addr);
+}
+
+itch50_index::itch50_index(const std::string& path)
+{
+    _data = map_file(path, _size);
+    if (_size < sizeof(header)) {
+        if (_data) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+        throw runtime_error(path + ": not an index");
+    }
+    try {
+        validate();
+    } catch (const runtime_error& e) {
+        ::munmap(const_cast<char*>(_data), _size);
+        throw runtime_error(path + ": " + e.what());
+    }
+}
+
+itch50_index::~itch50_index()
+{
+    ::munmap(const_cast<char*>(_data), _size);
+}
+
+void itch50_index::validate() const
+{
+    auto&& h = hdr();
+    if (memcmp(h.magic, index_magic, sizeof(h.magic))) {
+        throw runtime_error("not an index");
+    }
+    if (h.version != version) {
+        throw runtime_error("unsupported index version: " + to_string(h.version));
+    }
+    if (h.locate_count != locate_count) {
+        throw runtime_error("invalid number of stock locate codes: " + to_string(h.locate_count));
+    }
+    size_t size = _size - sizeof(header);
+    if (h.checkpoint_count > size / sizeof(checkpoint)) {
+        throw runtime_error("truncated index");
+    }
+    size -= h.checkpoint_count * sizeof(checkpoint);
+    if (size < h.locate_count * sizeof(locate)) {
+        throw runtime_error("truncated index");
+    }
+    size -= h.locate_count * sizeof(locate);
+    if (h.offset_count > size / sizeof(uint64_t)) {
+        throw runtime_error("truncated index");
+    }
+    for (uint32_t i = 0; i < h.locate_count; i++) {
+        auto&& l = locates()[i];
+        if (l.first > h.offset_count || l.count > h.offset_count - l.first) {
+            throw runtime_error("invalid stock locate offsets");
+        }
+    }
+}
+
+uint64_t itch50_index::seek(uint64_t timestamp) const
+{
+    auto* first = checkpoints();
+    auto* last = first + hdr().checkpoint_count;
+    auto it = std::upper_bound(first, last, timestamp, [](uint64_t ts, const checkpoint& c) {
+        return ts < c.timestamp;
+    });
+    if (it == first) {
+        return 0;
+    }
+    return (it - 1)->offset;
+}
+
+const uint64_t* itch50_index::offsets(const std::string& symbol, size_t& count) const
+{
+    char sym[ITCH_SYMBOL_LEN];
+    memset(sym, ' ', sizeof(sym));
+    memcpy(sym, symbol.data(), std::min(symbol.size(), sizeof(sym)));
+    for (uint32_t i = 0; i < hdr().locate_count; i++) {
+        auto&& l = locates()[i];
+        if (!memcmp(l.symbol, sym, sizeof(sym))) {
+            count = l.count;
+            return all_offsets() + l.first;
+        }
+    }
+    return nullptr;
+}
+
+static void write_all(FILE* f, const void* buf, size_t len, const string& path)
+{
+    if (len && fwrite(buf, len, 1, f) != 1) {
+        throw system_error(errno, system_category(), path);
+    }
+}
+
+void itch50_index::build(const std::string& input, const std::string& output, uint64_t interval)
+{
+    if (!interval) {
+        throw invalid_argument("invalid checkpoint interval: 0");
+    }
+    size_t size;
+    const char* data = map_file(input, size);
+
+    vector<checkpoint> checkpoints;
+    vector<locate> locates(locate_count);
+    vector<vector<uint64_t>> offsets(locate_count);
+    try {
+        uint64_t boundary = 0;
+        size_t offset = 0;
+        while (offset + sizeof(uint16_t) <= size) {
+            uint16_t payload_len = be16toh(*reinterpret_cast<const uint16_t*>(data + offset));
+            if (!payload_len) {
+                // End of session.
+                break;
+            }
+            if (payload_len < sizeof(itch50_system_event) - sizeof(char) || offset + sizeof(uint16_t) + payload_len > size) {
+                throw runtime_error(input + ": truncated record at offset " + to_string(offset));
+            }
+            // Every ITCH 5.0 message starts with the same header as the
+            // system event message.
+            auto* m = reinterpret_cast<const itch50_system_event*>(data + offset + sizeof(uint16_t));
+            uint16_t stock_locate = be16toh(m->StockLocate);
+            uint64_t timestamp = itch50_timestamp(m->Timestamp);
+            if (timestamp >= boundary) {
+                checkpoints.push_back(checkpoint{timestamp, offset});
+                boundary = (timestamp / interval + 1) * interval;
+            }
+            if (m->MessageType == 'R' && payload_len >= sizeof(itch50_stock_directory)) {
+                auto* dir = reinterpret_cast<const itch50_stock_directory*>(m);
+                memcpy(locates[stock_locate].symbol, dir->Stock, sizeof(dir->Stock));
+            }
+            offsets[stock_locate].push_back(offset);
+            offset += sizeof(uint16_t) + payload_len;
+        }
+    } catch (...) {
+        if (data) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+        throw;
+    }
+    if (data) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+
+    header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, index_magic, sizeof(h.magic));
+    h.version = version;
+    h.locate_count = locate_count;
+    h.file_size = size;
+    h.interval = interval;
+    h.checkpoint_count = checkpoints.size();
+    for (uint32_t i = 0; i < locate_count; i++) {
+        locates[i].first = h.offset_count;
+        locates[i].count = offsets[i].size();
+        h.offset_count += offsets[i].size();
+    }
+
+    string tmp_path = output + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        throw system_error(errno, system_category(), tmp_path);
+    }
+    try {
+        write_all(f, &h, sizeof(h), tmp_path);
+        write_all(f, checkpoints.data(), checkpoints.size() * sizeof(checkpoint), tmp_path);
+        write_all(f, locates.data(), locates.size() * sizeof(locate), tmp_path);
+        for (auto&& o : offsets) {
+            write_all(f, o.data(), o.size() * sizeof(uint64_t), tmp_path);
+        }
+        if (fflush(f) || ::fsync(fileno(f)) < 0) {
+            throw system_error(errno, system_category(), tmp_path);
+        }
+    } catch (...) {
+        fclose(f);
+        ::unlink(tmp_path.c_str());
+        throw;
+    }
+    if (fclose(f) || ::rename(tmp_path.c_str(), output.c_str()) < 0) {
+        int err = errno;
+        ::unlink(tmp_path.c_str());
+        throw system_error(err, system_category(), output);
+    }
+}
+
+}
+
+}
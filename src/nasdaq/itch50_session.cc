@@ -1,12 +1,21 @@
 #include "helix/nasdaq/itch50_session.hh"
 
 #include "helix/nasdaq/itch50_handler.hh"
+#include "helix/spsc_queue.hh"
 #include "binaryfile.hh"
+#include "helix/snapshot.hh"
 #include "helix/net.hh"
 
+#include <stdexcept>
+#include <algorithm>
+#include <exception>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <vector>
 
+#include <endian.h>
+
 using namespace std;
 
 namespace helix {
@@ -22,9 +31,90 @@ itch50_session::itch50_session(shared_ptr<itch50_handler> handler,
 {
 }
 
-void itch50_session::subscribe(const std::string& symbol, size_t max_orders)
+void itch50_session::subscribe(const std::string& symbol, size_t max_orders, const core::level_config& levels)
+{
+    _handler->subscribe(symbol, max_orders, levels);
+}
+
+void itch50_session::subscribe_all(size_t max_orders, const core::level_config& levels)
+{
+    _handler->subscribe_all(max_orders, levels);
+}
+
+void itch50_session::set_retransmit_callback(core::retransmit_callback retransmit)
+{
+    // BinaryFILE is not sequenced, so there is nothing to retransmit.
+}
+
+uint64_t itch50_session::clock() const
+{
+    return _handler->clock();
+}
+
+uint64_t itch50_session::packet_time(const net::packet_view& packet) const
+{
+    // The packet starts with a BinaryFILE record.
+    if (packet.len() < sizeof(uint16_t) + sizeof(itch50_system_event)) {
+        return 0;
+    }
+    uint16_t payload_len = be16toh(*reinterpret_cast<const uint16_t*>(packet.buf()));
+    if (payload_len < sizeof(itch50_system_event)) {
+        return 0;
+    }
+    // Every ITCH 5.0 message starts with the same header as the system
+    // event message.
+    auto* header = reinterpret_cast<const itch50_system_event*>(packet.buf() + sizeof(uint16_t));
+    return itch50_timestamp(header->Timestamp);
+}
+
+void itch50_session::set_mirror(shared_ptr<net::message_parser> mirror)
+{
+    _handler->set_mirror(std::move(mirror));
+}
+
+void itch50_session::set_rx_timestamp(uint64_t timestamp)
+{
+    _handler->set_rx_timestamp(timestamp);
+}
+
+const core::latency_stats* itch50_session::latency() const
+{
+    return _handler->latency();
+}
+
+void itch50_session::set_error_callback(core::error_callback process_error)
+{
+    _handler->set_error_callback(std::move(process_error));
+}
+
+void itch50_session::set_strict(bool strict)
+{
+    _handler->set_strict(strict);
+}
+
+uint64_t itch50_session::error_count(core::status s) const
 {
-    _handler->subscribe(symbol, max_orders);
+    return _handler->error_count(s);
+}
+
+size_t itch50_session::memory_usage() const
+{
+    return _handler->memory_usage();
+}
+
+core::status itch50_session::position(uint64_t order_id, core::queue_position& pos) const
+{
+    return _handler->position(order_id, pos);
+}
+
+void itch50_session::save(core::snapshot& s) const
+{
+    _handler->save(s);
+}
+
+void itch50_session::restore(const core::mapped_snapshot& s)
+{
+    _handler->restore(s);
 }
 
 size_t itch50_session::process_packet(const net::packet_view& packet)
@@ -32,14 +122,451 @@ size_t itch50_session::process_packet(const net::packet_view& packet)
     return _transport_session->parse(packet);
 }
 
+size_t itch50_session::process_packets(const net::packet_view* packets, size_t count)
+{
+    size_t nr = 0;
+    _handler->begin_batch();
+    try {
+        for (size_t i = 0; i < count; i++) {
+            nr += _transport_session->parse(packets[i]);
+        }
+    } catch (...) {
+        _handler->end_batch();
+        throw;
+    }
+    _handler->end_batch();
+    return nr;
+}
+
+void itch50_session::set_conflation(bool enabled)
+{
+    _handler->set_conflation(enabled);
+}
+
 void itch50_session::register_callback(core::ob_callback process_ob)
 {
-   _handler->register_callback(process_ob);
+   _handler->listener().register_callback(process_ob);
 }
 
 void itch50_session::register_callback(core::trade_callback process_trade)
 {
-   _handler->register_callback(process_trade);
+   _handler->listener().register_callback(process_trade);
+}
+
+void itch50_session::register_callback(core::order_callback process_order)
+{
+   _handler->listener().register_callback(process_order);
+}
+
+// A BinaryFILE record and its length prefix.
+struct binaryfile_record {
+    const char* buf;
+    size_t len;
+};
+
+struct itch50_sharded_session::shard {
+    static constexpr size_t queue_size = 64 * 1024;
+    //! Number of times a thread yields on an empty or full queue before it
+    //! blocks.
+    static constexpr unsigned spin_limit = 128;
+
+    shared_ptr<itch50_handler> handler;
+    binaryfile_session framing;
+    core::spsc_queue<binaryfile_record> queue;
+    exception_ptr error;
+    std::thread worker;
+    //! Protects blocking on the queue, which is itself lock-free.
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    //! Is the worker blocked on an empty queue?
+    std::atomic<bool> consumer_waiting;
+    //! Is the producer blocked on a full queue?
+    std::atomic<bool> producer_waiting;
+
+    shard()
+        : handler{make_shared<itch50_handler>()}
+        , framing{handler}
+        , queue{queue_size}
+        , consumer_waiting{false}
+        , producer_waiting{false}
+    { }
+
+    void run(itch50_sharded_session& session);
+    void process(const atomic<bool>& done, atomic<bool>& failed);
+    void push(const binaryfile_record& record, const atomic<bool>& failed);
+    bool pop(binaryfile_record& record, const atomic<bool>& done);
+    void wake_consumer();
+    void wake();
+};
+
+constexpr size_t itch50_sharded_session::shard::queue_size;
+
+constexpr unsigned itch50_sharded_session::shard::spin_limit;
+
+// A thread that blocks sets its flag and then checks the queue again, and
+// the other thread changes the queue and then checks the flag. A fence on
+// both sides orders the two, so that either the blocking thread sees the
+// change or the other thread sees the flag and wakes it up.
+
+void itch50_sharded_session::shard::push(const binaryfile_record& record, const atomic<bool>& failed)
+{
+    for (unsigned spins = 0; !queue.try_push(record); spins++) {
+        if (failed.load(memory_order_acquire)) {
+            return;
+        }
+        if (spins < spin_limit) {
+            this_thread::yield();
+            continue;
+        }
+        unique_lock<mutex> lock{queue_mutex};
+        producer_waiting.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        queue_cond.wait(lock, [&] { return !queue.full(); });
+        producer_waiting.store(false, memory_order_relaxed);
+        spins = 0;
+    }
+    wake_consumer();
+}
+
+bool itch50_sharded_session::shard::pop(binaryfile_record& record, const atomic<bool>& done)
+{
+    for (unsigned spins = 0;; spins++) {
+        if (queue.try_pop(record)) {
+            // A producer that has just blocked may be missed here, but
+            // not by the check before this worker blocks on an empty queue.
+            if (producer_waiting.load(memory_order_relaxed)) {
+                wake();
+            }
+            return true;
+        }
+        // The producer sets the flag after its last push, so the queue
+        // has to be checked once more after seeing it.
+        if (done.load(memory_order_acquire)) {
+            return queue.try_pop(record);
+        }
+        if (spins < spin_limit) {
+            this_thread::yield();
+            continue;
+        }
+        unique_lock<mutex> lock{queue_mutex};
+        consumer_waiting.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (producer_waiting.load(memory_order_relaxed)) {
+            queue_cond.notify_all();
+        }
+        queue_cond.wait(lock, [&] { return !queue.empty() || done.load(memory_order_acquire); });
+        consumer_waiting.store(false, memory_order_relaxed);
+        spins = 0;
+    }
+}
+
+void itch50_sharded_session::shard::wake_consumer()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (consumer_waiting.load(memory_order_relaxed)) {
+        wake();
+    }
+}
+
+void itch50_sharded_session::shard::wake()
+{
+    {
+        // Taking the lock makes sure that the other thread is either
+        // before its check of the queue or already waiting.
+        lock_guard<mutex> lock{queue_mutex};
+    }
+    queue_cond.notify_all();
+}
+
+void itch50_sharded_session::shard::run(itch50_sharded_session& session)
+{
+    uint64_t epoch = 0;
+    for (;;) {
+        {
+            unique_lock<mutex> lock{session._mutex};
+            session._cond.wait(lock, [&] { return session._stop || session._epoch != epoch; });
+            if (session._stop) {
+                return;
+            }
+            epoch = session._epoch;
+        }
+        process(session._done, session._failed);
+        bool last;
+        {
+            lock_guard<mutex> lock{session._mutex};
+            last = !--session._running;
+        }
+        if (last) {
+            session._cond.notify_all();
+        }
+    }
+}
+
+void itch50_sharded_session::shard::process(const atomic<bool>& done, atomic<bool>& failed)
+{
+    binaryfile_record record;
+    // Every record is a packet of its own to the framing layer, so deliver
+    // conflated updates only when the worker runs out of records.
+    handler->begin_batch();
+    while (pop(record, done)) {
+        if (error) {
+            continue;
+        }
+        try {
+            framing.parse(net::packet_view{record.buf, record.len});
+        } catch (...) {
+            error = current_exception();
+            failed.store(true, memory_order_release);
+        }
+    }
+    try {
+        handler->end_batch();
+    } catch (...) {
+        if (!error) {
+            error = current_exception();
+        }
+        failed.store(true, memory_order_release);
+    }
+}
+
+itch50_sharded_session::itch50_sharded_session(size_t shards, void *data)
+    : session{data}
+    , _epoch{0}
+    , _running{0}
+    , _stop{false}
+    , _done{false}
+    , _failed{false}
+{
+    if (!shards) {
+        throw invalid_argument("invalid number of shards: 0");
+    }
+    for (size_t i = 0; i < shards; i++) {
+        _shards.emplace_back(new shard);
+    }
+    try {
+        for (auto&& s : _shards) {
+            s->worker = std::thread{&shard::run, s.get(), std::ref(*this)};
+        }
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+itch50_sharded_session::~itch50_sharded_session()
+{
+    stop();
+}
+
+void itch50_sharded_session::stop()
+{
+    {
+        lock_guard<mutex> lock{_mutex};
+        _stop = true;
+    }
+    _cond.notify_all();
+    for (auto&& s : _shards) {
+        if (s->worker.joinable()) {
+            s->worker.join();
+        }
+    }
+}
+
+void itch50_sharded_session::subscribe(const std::string& symbol, size_t max_orders, const core::level_config& levels)
+{
+    // The stock locate code of a symbol is only known from its stock
+    // directory message, so every shard subscribes. Only the shard that
+    // receives that message creates the book and allocates its orders.
+    for (auto&& s : _shards) {
+        s->handler->subscribe(symbol, max_orders, levels);
+    }
+}
+
+void itch50_sharded_session::subscribe_all(size_t max_orders, const core::level_config& levels)
+{
+    // Stock locate codes spread the orders evenly over the shards.
+    size_t shard_max_orders = (max_orders + _shards.size() - 1) / _shards.size();
+    for (auto&& s : _shards) {
+        s->handler->subscribe_all(shard_max_orders, levels);
+    }
+}
+
+void itch50_sharded_session::set_conflation(bool enabled)
+{
+    for (auto&& s : _shards) {
+        s->handler->set_conflation(enabled);
+    }
+}
+
+void itch50_sharded_session::register_callback(core::ob_callback process_ob)
+{
+    for (auto&& s : _shards) {
+        s->handler->listener().register_callback(process_ob);
+    }
+}
+
+void itch50_sharded_session::register_callback(core::trade_callback process_trade)
+{
+    for (auto&& s : _shards) {
+        s->handler->listener().register_callback(process_trade);
+    }
+}
+
+void itch50_sharded_session::register_callback(core::order_callback process_order)
+{
+    for (auto&& s : _shards) {
+        s->handler->listener().register_callback(process_order);
+    }
+}
+
+void itch50_sharded_session::set_retransmit_callback(core::retransmit_callback retransmit)
+{
+}
+
+uint64_t itch50_sharded_session::clock() const
+{
+    uint64_t clock = 0;
+    for (auto&& s : _shards) {
+        clock = std::max(clock, s->handler->clock());
+    }
+    return clock;
+}
+
+void itch50_sharded_session::set_error_callback(core::error_callback process_error)
+{
+    for (auto&& s : _shards) {
+        s->handler->set_error_callback(process_error);
+    }
+}
+
+void itch50_sharded_session::set_strict(bool strict)
+{
+    for (auto&& s : _shards) {
+        s->handler->set_strict(strict);
+    }
+}
+
+uint64_t itch50_sharded_session::error_count(core::status s) const
+{
+    uint64_t count = 0;
+    for (auto&& sh : _shards) {
+        count += sh->handler->error_count(s);
+    }
+    return count;
+}
+
+size_t itch50_sharded_session::memory_usage() const
+{
+    size_t size = 0;
+    for (auto&& s : _shards) {
+        size += s->handler->memory_usage();
+    }
+    return size;
+}
+
+core::status itch50_sharded_session::position(uint64_t order_id, core::queue_position& pos) const
+{
+    // Order reference numbers are unique across the feed, so at most one
+    // shard has the order.
+    for (auto&& s : _shards) {
+        if (s->handler->position(order_id, pos) == core::status::ok) {
+            return core::status::ok;
+        }
+    }
+    return core::status::unknown_order;
+}
+
+void itch50_sharded_session::save(core::snapshot& s) const
+{
+    for (auto&& sh : _shards) {
+        sh->handler->save(s);
+    }
+}
+
+void itch50_sharded_session::restore(const core::mapped_snapshot& s)
+{
+    for (size_t i = 0; i < _shards.size(); i++) {
+        _shards[i]->handler->restore(s, i, _shards.size());
+    }
+}
+
+size_t itch50_sharded_session::process_packet(const net::packet_view& packet)
+{
+    return process_packets(&packet, 1);
+}
+
+size_t itch50_sharded_session::process_packets(const net::packet_view* packets, size_t count)
+{
+    {
+        lock_guard<mutex> lock{_mutex};
+        _done.store(false, memory_order_relaxed);
+        _failed.store(false, memory_order_relaxed);
+        _running = _shards.size();
+        _epoch++;
+    }
+    _cond.notify_all();
+    size_t nr = 0;
+    // The workers have to finish the records that were queued before a
+    // dispatch error, so it is rethrown only after they are done.
+    exception_ptr dispatch_error;
+    try {
+        for (size_t i = 0; i < count && !_failed.load(memory_order_acquire); i++) {
+            nr += dispatch(packets[i]);
+        }
+    } catch (...) {
+        dispatch_error = current_exception();
+    }
+    _done.store(true, memory_order_release);
+    for (auto&& s : _shards) {
+        s->wake_consumer();
+    }
+    {
+        unique_lock<mutex> lock{_mutex};
+        _cond.wait(lock, [&] { return !_running; });
+    }
+    // Clear the errors of every shard so that none of them is reported
+    // again by a later call. Records that failed in a shard precede the
+    // record that failed to dispatch.
+    exception_ptr error;
+    for (auto&& s : _shards) {
+        if (s->error && !error) {
+            error = s->error;
+        }
+        s->error = nullptr;
+    }
+    if (!error) {
+        error = dispatch_error;
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    return nr;
+}
+
+size_t itch50_sharded_session::dispatch(const net::packet_view& packet)
+{
+    const char* p = packet.buf();
+    while (p + sizeof(uint16_t) + sizeof(itch50_message) <= packet.end() && !_failed.load(memory_order_acquire)) {
+        uint16_t payload_len = be16toh(*reinterpret_cast<const uint16_t*>(p));
+        if (!payload_len) {
+            // End of session.
+            break;
+        }
+        size_t len = sizeof(uint16_t) + payload_len;
+        if (p + len > packet.end()) {
+            break;
+        }
+        if (payload_len < sizeof(itch50_system_event) - sizeof(char)) {
+            throw runtime_error("truncated ITCH 5.0 record at offset " + to_string(p - packet.buf()));
+        }
+        // Every ITCH 5.0 message starts with the same header as the
+        // system event message.
+        auto* header = reinterpret_cast<const itch50_system_event*>(p + sizeof(uint16_t));
+        auto&& s = *_shards[itch50_shard(header->StockLocate, _shards.size())];
+        s.push(binaryfile_record{p, len}, _failed);
+        p += len;
+    }
+    return p - packet.buf();
 }
 
 itch50_session*
@@ -55,6 +582,15 @@ itch50_protocol::new_session(void *data)
     return new itch50_session(std::move(is), std::move(ts), data);
 }
 
+itch50_sharded_session*
+itch50_protocol::new_sharded_session(size_t shards, void *data)
+{
+    if (_name != "nasdaq-binaryfile-itch50") {
+        throw std::invalid_argument("unknown protocol: " + _name);
+    }
+    return new itch50_sharded_session(shards, data);
+}
+
 }
 
 }
@@ -1,9 +1,10 @@
 #include "moldudp.hh"
 
 #include "helix/nasdaq/moldudp_messages.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
-#include <string>
+#include <utility>
 
 using namespace std;
 
@@ -11,37 +12,246 @@ namespace helix {
 
 namespace nasdaq {
 
-moldudp_session::moldudp_session(shared_ptr<net::message_parser> parser)
+// Message count of an end of session packet.
+static constexpr uint16_t end_of_session = 0xFFFF;
+
+constexpr size_t moldudp_session::default_buffer_size;
+
+constexpr uint32_t moldudp_session::default_retransmit_interval;
+
+constexpr uint32_t moldudp_arbiter::default_max_lag;
+
+moldudp_session::moldudp_session(shared_ptr<net::message_parser> parser, size_t buffer_size, uint32_t retransmit_interval)
     : _parser(parser)
     , _seq_num{1}
+    , _high_seq_num{1}
+    , _buffer(buffer_size)
+    , _buffered{0}
+    , _since_request{0}
+    , _retransmit_interval{retransmit_interval}
 {
 }
 
-size_t moldudp_session::parse(const net::packet_view& packet)
+void moldudp_session::reset(uint32_t seq_num)
 {
-    auto* p = packet.buf();
+    _seq_num = seq_num;
+    _high_seq_num = seq_num;
+    for (auto&& bp : _buffer) {
+        bp.data.clear();
+    }
+    _buffered = 0;
+    _since_request = 0;
+}
 
+size_t moldudp_session::parse(const net::packet_view& packet)
+{
     assert(packet.len() >= sizeof(moldudp_header));
 
     auto* header = packet.cast<moldudp_header>();
-    if (header->SequenceNumber != _seq_num) {
-        throw runtime_error(string("invalid sequence number: ") + to_string(header->SequenceNumber) + ", expected: " + to_string(_seq_num));
+    uint32_t seq_num = header->SequenceNumber;
+    uint16_t count = header->MessageCount;
+    if (count == end_of_session) {
+        count = 0;
+    }
+    if (seq_num > _seq_num) {
+        if (seq_num > _high_seq_num && _retransmit) {
+            _retransmit(_high_seq_num, seq_num - _high_seq_num);
+        }
+        if (count) {
+            buffer(packet, seq_num, count);
+        }
+    } else if (seq_num + count > _seq_num) {
+        process(packet.buf() + sizeof(moldudp_header), seq_num, count);
+        process_buffered();
     }
-    p += sizeof(moldudp_header);
+    if (seq_num + count > _high_seq_num) {
+        _high_seq_num = seq_num + count;
+    }
+    if (_seq_num >= _high_seq_num) {
+        _since_request = 0;
+    } else if (++_since_request >= _retransmit_interval) {
+        request_missing();
+    }
+    return packet.len();
+}
 
-    for (int i = 0; i < header->MessageCount; i++) {
+void moldudp_session::process(const char* p, uint32_t seq_num, uint16_t count)
+{
+    for (int i = 0; i < count; i++) {
         auto* msg_block = reinterpret_cast<const moldudp_message_block*>(p);
 
         p += sizeof(moldudp_message_block);
 
-        _parser->parse(net::packet_view{p, msg_block->MessageLength});
+        // Skip messages that were already processed from another packet.
+        if (seq_num == _seq_num) {
+            _parser->parse(net::packet_view{p, msg_block->MessageLength});
+
+            _seq_num++;
+        }
+        seq_num++;
 
         p += msg_block->MessageLength;
+    }
+
+    _parser->flush();
+}
+
+void moldudp_session::process_buffered()
+{
+    bool progress = true;
+    while (_buffered && progress) {
+        progress = false;
+        for (auto&& bp : _buffer) {
+            if (bp.data.empty() || bp.seq_num > _seq_num) {
+                continue;
+            }
+            if (bp.seq_num + bp.count > _seq_num) {
+                process(bp.data.data() + sizeof(moldudp_header), bp.seq_num, bp.count);
+            }
+            bp.data.clear();
+            _buffered--;
+            progress = true;
+        }
+    }
+}
+
+void moldudp_session::buffer(const net::packet_view& packet, uint32_t seq_num, uint16_t count)
+{
+    for (;;) {
+        buffered_packet* slot = nullptr;
+        for (auto&& bp : _buffer) {
+            if (bp.data.empty()) {
+                slot = &bp;
+            } else if (bp.seq_num == seq_num && bp.count >= count) {
+                return;
+            }
+        }
+        if (slot) {
+            slot->seq_num = seq_num;
+            slot->count = count;
+            slot->data.assign(packet.buf(), packet.end());
+            _buffered++;
+            return;
+        }
+        skip_gap(seq_num);
+        // Skipping the gap may have caught up with the packet.
+        if (seq_num <= _seq_num) {
+            if (seq_num + count > _seq_num) {
+                process(packet.buf() + sizeof(moldudp_header), seq_num, count);
+                process_buffered();
+            }
+            return;
+        }
+    }
+}
 
-        _seq_num++;
+// Requests the messages between the next sequence number and the highest
+// one seen that are not in the reorder buffer.
+void moldudp_session::request_missing()
+{
+    _since_request = 0;
+    if (!_retransmit) {
+        return;
+    }
+    vector<pair<uint32_t, uint32_t>> buffered;
+    for (auto&& bp : _buffer) {
+        if (!bp.data.empty()) {
+            buffered.emplace_back(bp.seq_num, bp.seq_num + bp.count);
+        }
+    }
+    sort(buffered.begin(), buffered.end());
+    uint32_t seq_num = _seq_num;
+    for (auto&& range : buffered) {
+        if (range.first > seq_num) {
+            _retransmit(seq_num, range.first - seq_num);
+        }
+        seq_num = std::max(seq_num, range.second);
+    }
+    if (_high_seq_num > seq_num) {
+        _retransmit(seq_num, _high_seq_num - seq_num);
+    }
+}
+
+// Gives up on the messages that are missing before the first buffered
+// packet, or before \p seq_num if it comes first, and processes the
+// buffered packets that follow them.
+void moldudp_session::skip_gap(uint32_t seq_num)
+{
+    uint32_t first = seq_num;
+    for (auto&& bp : _buffer) {
+        if (!bp.data.empty()) {
+            first = std::min(first, bp.seq_num);
+        }
+    }
+    assert(first > _seq_num);
+    uint32_t lost = first - _seq_num;
+    _seq_num = first;
+    process_buffered();
+    _errors.report(core::status::messages_lost, lost);
+}
+
+moldudp_arbiter::moldudp_arbiter(shared_ptr<net::message_parser> parser, uint32_t max_lag)
+    : _session{std::move(parser)}
+    , _line_high{0, 0}
+    , _line{core::feed_line::a}
+    , _max_lag{max_lag}
+{
+    _session.set_retransmit_callback([this](uint64_t seq_num, uint64_t count) {
+        _gaps.push_back(gap{uint32_t(seq_num), uint32_t(seq_num + count), _line});
+    });
+}
+
+void moldudp_arbiter::reset(uint32_t seq_num)
+{
+    _session.reset(seq_num);
+    _line_high[0] = 0;
+    _line_high[1] = 0;
+    _gaps.clear();
+}
+
+size_t moldudp_arbiter::parse(const net::packet_view& packet, core::feed_line line)
+{
+    assert(packet.len() >= sizeof(moldudp_header));
+
+    auto* header = packet.cast<moldudp_header>();
+    uint32_t seq_num = header->SequenceNumber;
+    uint16_t count = header->MessageCount;
+    if (count == end_of_session) {
+        count = 0;
+    }
+    auto&& high = _line_high[static_cast<size_t>(line)];
+    if (seq_num + count > high) {
+        high = seq_num + count;
+    }
+    size_t nr = packet.len();
+    // Copies of messages that already arrived on the other line are dropped
+    // here without going through the session.
+    if (!count || seq_num + count > _session.seq_num()) {
+        _line = line;
+        nr = _session.parse(packet);
     }
+    release_gaps();
+    return nr;
+}
 
-    return p - packet.buf();
+void moldudp_arbiter::release_gaps()
+{
+    uint32_t leading = std::max(_line_high[0], _line_high[1]);
+    while (!_gaps.empty()) {
+        auto&& g = _gaps.front();
+        uint32_t seq_num = _session.seq_num();
+        if (g.end > seq_num) {
+            auto other = _line_high[1 - static_cast<size_t>(g.line)];
+            if (other && other < g.end && leading - g.end < _max_lag) {
+                break;
+            }
+            if (_retransmit) {
+                auto first = std::max(g.seq_num, seq_num);
+                _retransmit(first, g.end - first);
+            }
+        }
+        _gaps.pop_front();
+    }
 }
 
 }
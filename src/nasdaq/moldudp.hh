@@ -17,23 +17,166 @@
 
 #pragma once
 
+#include "helix/helix.hh"
 #include "helix/net.hh"
 
 #include <cstdint>
 #include <memory>
+#include <vector>
+#include <deque>
 
 namespace helix {
 
 namespace nasdaq {
 
+// MoldUDP session.
+//
+// Packets that arrive ahead of the expected sequence number are copied to a
+// bounded reorder buffer and a retransmission of the missing messages is
+// requested through the retransmission callback. Once the gap is filled,
+// either by a late packet or by a retransmitted one that is passed to
+// parse(), the buffered packets are processed in sequence. Messages that
+// have already been processed are skipped, so duplicate and overlapping
+// packets are harmless. Retransmission of the messages that are still
+// missing is requested again every retransmit_interval packets until the
+// gap is filled. If the reorder buffer fills up first, the session gives up
+// on the oldest gap: the missing messages are reported to the error callback
+// as core::status::messages_lost and processing continues from the first
+// buffered packet.
 class moldudp_session : public net::message_parser {
 private:
+    struct buffered_packet {
+        uint32_t seq_num;
+        uint16_t count;
+        std::vector<char> data;
+    };
+
     std::shared_ptr<net::message_parser> _parser;
+    //! Sequence number of the next message to process.
     uint32_t _seq_num;
+    //! Sequence number following the highest message seen so far.
+    uint32_t _high_seq_num;
+    //! Out-of-order packets waiting for a gap to be filled.
+    std::vector<buffered_packet> _buffer;
+    //! Number of packets in the reorder buffer.
+    size_t _buffered;
+    //! Number of packets parsed since the missing messages were last
+    //! requested.
+    uint32_t _since_request;
+    uint32_t _retransmit_interval;
+    core::retransmit_callback _retransmit;
+    core::error_reporter _errors;
 public:
-    explicit moldudp_session(std::shared_ptr<net::message_parser> parser);
+    static constexpr size_t default_buffer_size = 1024;
+    static constexpr uint32_t default_retransmit_interval = 256;
+
+    explicit moldudp_session(std::shared_ptr<net::message_parser> parser,
+                             size_t buffer_size = default_buffer_size,
+                             uint32_t retransmit_interval = default_retransmit_interval);
+
+    void set_retransmit_callback(core::retransmit_callback retransmit) {
+        _retransmit = std::move(retransmit);
+    }
+
+    void set_error_callback(core::error_callback process_error) {
+        _errors.set_callback(std::move(process_error));
+    }
+
+    void set_strict(bool strict) {
+        _errors.set_strict(strict);
+    }
+
+    uint64_t error_count(core::status s) const {
+        return _errors.count(s);
+    }
+
+    //! Sequence number of the next message to process.
+    uint32_t seq_num() const {
+        return _seq_num;
+    }
+
+    //! Discards buffered packets and continues from \p seq_num.
+    void reset(uint32_t seq_num);
 
     virtual size_t parse(const net::packet_view& packet) override;
+private:
+    void process(const char* p, uint32_t seq_num, uint16_t count);
+    void process_buffered();
+    void buffer(const net::packet_view& packet, uint32_t seq_num, uint16_t count);
+    void request_missing();
+    void skip_gap(uint32_t seq_num);
+};
+
+// MoldUDP A/B line arbitration.
+//
+// NASDAQ publishes every MoldUDP stream on two redundant multicast lines.
+// The arbiter passes packets from both lines to one moldudp_session, so the
+// copy of a message that arrives first is processed and the other copy is
+// dropped. A gap on one line is reported to the retransmission callback only
+// when the other line has also passed it without filling it, or when the
+// leading line is max_lag messages past the gap, which covers a line that
+// has stopped. A line that has not received any packets is ignored, so a
+// feed that uses a single line behaves like a plain moldudp_session.
+class moldudp_arbiter : public net::message_parser {
+private:
+    struct gap {
+        uint32_t seq_num;
+        uint32_t end;
+        core::feed_line line;
+    };
+
+    moldudp_session _session;
+    //! Sequence number following the highest message seen on each line,
+    //! or zero if the line has not received any packets.
+    uint32_t _line_high[2];
+    //! Line of the packet that is being parsed.
+    core::feed_line _line;
+    //! Gaps that are waiting for the other line, in the order in which
+    //! the session requested them.
+    std::deque<gap> _gaps;
+    uint32_t _max_lag;
+    core::retransmit_callback _retransmit;
+public:
+    static constexpr uint32_t default_max_lag = 4096;
+
+    explicit moldudp_arbiter(std::shared_ptr<net::message_parser> parser,
+                             uint32_t max_lag = default_max_lag);
+
+    moldudp_arbiter(const moldudp_arbiter&) = delete;
+    moldudp_arbiter& operator=(const moldudp_arbiter&) = delete;
+
+    void set_retransmit_callback(core::retransmit_callback retransmit) {
+        _retransmit = std::move(retransmit);
+    }
+
+    void set_error_callback(core::error_callback process_error) {
+        _session.set_error_callback(std::move(process_error));
+    }
+
+    void set_strict(bool strict) {
+        _session.set_strict(strict);
+    }
+
+    uint64_t error_count(core::status s) const {
+        return _session.error_count(s);
+    }
+
+    //! Sequence number of the next message to process.
+    uint32_t seq_num() const {
+        return _session.seq_num();
+    }
+
+    //! Discards buffered packets and pending gaps and continues from
+    //! \p seq_num.
+    void reset(uint32_t seq_num);
+
+    virtual size_t parse(const net::packet_view& packet) override {
+        return parse(packet, core::feed_line::a);
+    }
+
+    size_t parse(const net::packet_view& packet, core::feed_line line);
+private:
+    void release_gaps();
 };
 
 }
@@ -0,0 +1,139 @@
+#include "helix/nasdaq/moldudp_sender.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace nasdaq {
+
+static constexpr uint16_t end_of_session = 0xFFFF;
+
+static void throw_errno(const char* what)
+{
+    throw system_error(errno, system_category(), what);
+}
+
+moldudp_sender::moldudp_sender(const moldudp_sender_config& config)
+    : _fd{-1}
+    , _seq_num{1}
+    , _count{0}
+    , _packet_count{0}
+    , _packet(config.max_packet_size)
+    , _len{sizeof(moldudp_header)}
+{
+    if (config.session.size() > sizeof(_session)) {
+        throw invalid_argument("session name is longer than " + to_string(sizeof(_session)) + " characters: " + config.session);
+    }
+    if (config.max_packet_size <= sizeof(moldudp_header) + sizeof(moldudp_message_block)
+        || config.max_packet_size > numeric_limits<uint16_t>::max()) {
+        throw invalid_argument("invalid maximum packet size: " + to_string(config.max_packet_size));
+    }
+    memset(_session, ' ', sizeof(_session));
+    memcpy(_session, config.session.data(), config.session.size());
+    memset(&_addr, 0, sizeof(_addr));
+    _addr.sin_family = AF_INET;
+    _addr.sin_port = htons(config.port);
+    if (!inet_aton(config.multicast_addr.c_str(), &_addr.sin_addr)) {
+        throw invalid_argument("invalid multicast address: " + config.multicast_addr);
+    }
+    struct in_addr interface;
+    interface.s_addr = htonl(INADDR_ANY);
+    if (!config.interface_addr.empty() && !inet_aton(config.interface_addr.c_str(), &interface)) {
+        throw invalid_argument("invalid interface address: " + config.interface_addr);
+    }
+    _fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0) {
+        throw_errno("socket");
+    }
+    try {
+        if (::setsockopt(_fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) < 0) {
+            throw_errno("setsockopt(IP_MULTICAST_IF)");
+        }
+        unsigned char ttl = config.ttl;
+        if (::setsockopt(_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+            throw_errno("setsockopt(IP_MULTICAST_TTL)");
+        }
+        unsigned char loop = config.loopback;
+        if (::setsockopt(_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+            throw_errno("setsockopt(IP_MULTICAST_LOOP)");
+        }
+    } catch (...) {
+        ::close(_fd);
+        throw;
+    }
+}
+
+moldudp_sender::~moldudp_sender()
+{
+    ::close(_fd);
+}
+
+size_t moldudp_sender::parse(const net::packet_view& message)
+{
+    size_t block_len = sizeof(moldudp_message_block) + message.len();
+    if (sizeof(moldudp_header) + block_len > _packet.size()) {
+        throw invalid_argument("message does not fit in a packet: " + to_string(message.len()) + " bytes");
+    }
+    if (_len + block_len > _packet.size() || _count == end_of_session - 1) {
+        flush();
+    }
+    moldudp_message_block block;
+    block.MessageLength = message.len();
+    memcpy(&_packet[_len], &block, sizeof(block));
+    memcpy(&_packet[_len + sizeof(block)], message.buf(), message.len());
+    _len += block_len;
+    _count++;
+    return message.len();
+}
+
+void moldudp_sender::flush()
+{
+    if (!_count) {
+        return;
+    }
+    send(_count);
+    _seq_num += _count;
+    _count = 0;
+    _len = sizeof(moldudp_header);
+}
+
+void moldudp_sender::end_session()
+{
+    flush();
+    send(end_of_session);
+}
+
+void moldudp_sender::send(uint16_t count)
+{
+    moldudp_header header;
+    memcpy(header.Session, _session, sizeof(header.Session));
+    header.SequenceNumber = _seq_num;
+    header.MessageCount = count;
+    memcpy(_packet.data(), &header, sizeof(header));
+    size_t len = count == end_of_session ? sizeof(header) : _len;
+    for (;;) {
+        ssize_t nr = ::sendto(_fd, _packet.data(), len, 0, reinterpret_cast<const struct sockaddr*>(&_addr), sizeof(_addr));
+        if (nr >= 0) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        throw_errno("sendto");
+    }
+    _packet_count++;
+}
+
+}
+
+}
@@ -1,10 +1,12 @@
 #include "helix/nasdaq/nordic_itch_session.hh"
 
 #include "helix/nasdaq/nordic_itch_handler.hh"
+#include "helix/snapshot.hh"
 #include "helix/net.hh"
 #include "soupfile.hh"
 #include "moldudp.hh"
 
+#include <stdexcept>
 #include <memory>
 #include <vector>
 
@@ -20,12 +22,103 @@ nordic_itch_session::nordic_itch_session(shared_ptr<nordic_itch_handler> handler
     : session{data}
     , _handler{std::move(handler)}
     , _transport_session{std::move(transport_session)}
+    , _arbiter{dynamic_pointer_cast<moldudp_arbiter>(_transport_session)}
 {
 }
 
-void nordic_itch_session::subscribe(const std::string& symbol, size_t max_orders)
+void nordic_itch_session::subscribe(const std::string& symbol, size_t max_orders, const core::level_config& levels)
 {
-    _handler->subscribe(symbol, max_orders);
+    _handler->subscribe(symbol, max_orders, levels);
+}
+
+void nordic_itch_session::subscribe_all(size_t max_orders, const core::level_config& levels)
+{
+    _handler->subscribe_all(max_orders, levels);
+}
+
+void nordic_itch_session::set_retransmit_callback(core::retransmit_callback retransmit)
+{
+    if (_arbiter) {
+        _arbiter->set_retransmit_callback(std::move(retransmit));
+    }
+}
+
+uint64_t nordic_itch_session::clock() const
+{
+    return _handler->clock();
+}
+
+uint64_t nordic_itch_session::packet_time(const net::packet_view& packet) const
+{
+    // Messages carry no timestamp of their own, but the time message that
+    // precedes them has already been processed.
+    return _handler->clock() * 1000000;
+}
+
+void nordic_itch_session::set_mirror(shared_ptr<net::message_parser> mirror)
+{
+    _handler->set_mirror(std::move(mirror));
+}
+
+void nordic_itch_session::set_rx_timestamp(uint64_t timestamp)
+{
+    _handler->set_rx_timestamp(timestamp);
+}
+
+const core::latency_stats* nordic_itch_session::latency() const
+{
+    return _handler->latency();
+}
+
+void nordic_itch_session::set_error_callback(core::error_callback process_error)
+{
+    if (_arbiter) {
+        _arbiter->set_error_callback(process_error);
+    }
+    _handler->set_error_callback(std::move(process_error));
+}
+
+void nordic_itch_session::set_strict(bool strict)
+{
+    if (_arbiter) {
+        _arbiter->set_strict(strict);
+    }
+    _handler->set_strict(strict);
+}
+
+uint64_t nordic_itch_session::error_count(core::status s) const
+{
+    uint64_t count = _handler->error_count(s);
+    if (_arbiter) {
+        count += _arbiter->error_count(s);
+    }
+    return count;
+}
+
+size_t nordic_itch_session::memory_usage() const
+{
+    return _handler->memory_usage();
+}
+
+core::status nordic_itch_session::position(uint64_t order_id, core::queue_position& pos) const
+{
+    return _handler->position(order_id, pos);
+}
+
+void nordic_itch_session::save(core::snapshot& s) const
+{
+    _handler->save(s);
+    if (_arbiter) {
+        s.set_seq_num(_arbiter->seq_num());
+    }
+}
+
+void nordic_itch_session::restore(const core::mapped_snapshot& s)
+{
+    _handler->restore(s);
+    if (_arbiter && s.seq_num()) {
+        _arbiter->reset(s.seq_num());
+    }
 }
 
 size_t nordic_itch_session::process_packet(const net::packet_view& packet)
@@ -33,14 +126,48 @@ size_t nordic_itch_session::process_packet(const net::packet_view& packet)
     return _transport_session->parse(packet);
 }
 
+size_t nordic_itch_session::process_line_packet(core::feed_line line, const net::packet_view& packet)
+{
+    if (_arbiter) {
+        return _arbiter->parse(packet, line);
+    }
+    return _transport_session->parse(packet);
+}
+
+size_t nordic_itch_session::process_packets(const net::packet_view* packets, size_t count)
+{
+    size_t nr = 0;
+    _handler->begin_batch();
+    try {
+        for (size_t i = 0; i < count; i++) {
+            nr += _transport_session->parse(packets[i]);
+        }
+    } catch (...) {
+        _handler->end_batch();
+        throw;
+    }
+    _handler->end_batch();
+    return nr;
+}
+
+void nordic_itch_session::set_conflation(bool enabled)
+{
+    _handler->set_conflation(enabled);
+}
+
 void nordic_itch_session::register_callback(core::ob_callback process_ob)
 {
-   _handler->register_callback(process_ob);
+   _handler->listener().register_callback(process_ob);
 }
 
 void nordic_itch_session::register_callback(core::trade_callback process_trade)
 {
-   _handler->register_callback(process_trade);
+   _handler->listener().register_callback(process_trade);
+}
+
+void nordic_itch_session::register_callback(core::order_callback process_order)
+{
+   _handler->listener().register_callback(process_order);
 }
 
 nordic_itch_session*
@@ -49,7 +176,7 @@ nordic_itch_protocol::new_session(void *data)
     auto is = make_shared<nordic_itch_handler>();
     shared_ptr<net::message_parser> ts;
     if (_name == "nasdaq-nordic-moldudp-itch") {
-        ts = make_shared<moldudp_session>(is);
+        ts = make_shared<moldudp_arbiter>(is);
     } else if (_name == "nasdaq-nordic-soupfile-itch") {
         ts = make_shared<soupfile_session>(is);
     } else {
@@ -32,6 +32,7 @@ size_t soupfile_session::parse(const net::packet_view& packet)
     if (*terminator++ != 0x0d || *terminator != 0x0a) {
         throw runtime_error("terminator mismatch");
     }
+    _parser->flush();
     return nr + terminator_size;
 }
 
@@ -1,7 +1,7 @@
 #include "helix/order_book.hh"
 
-#include <boost/version.hpp>
 #include <stdexcept>
+#include <algorithm>
 #include <limits>
 
 using namespace std;
@@ -10,136 +10,492 @@ namespace helix {
 
 namespace core {
 
-order_book::order_book(std::string symbol, uint64_t timestamp, size_t max_orders)
+const char* status_string(status s)
+{
+    switch (s) {
+    case status::ok:                    return "ok";
+    case status::unknown_order:         return "invalid order id";
+    case status::duplicate_order:       return "duplicate order id";
+    case status::invalid_side:          return "invalid side";
+    case status::invalid_trading_state: return "invalid trading state";
+    case status::invalid_price:         return "invalid price";
+    case status::invalid_quantity:      return "invalid quantity";
+    case status::messages_lost:         return "messages lost";
+    }
+    return "unknown status";
+}
+
+void error_reporter::report(status s, uint64_t value)
+{
+    _counts[static_cast<size_t>(s)]++;
+    if (_strict) {
+        throw invalid_argument(string(status_string(s)) + ": " + to_string(value));
+    }
+    if (_process_error) {
+        _process_error(s, value);
+    }
+}
+
+template<side_type Side>
+constexpr uint64_t price_ladder<Side>::empty;
+
+template<side_type Side>
+price_ladder<Side>::price_ladder(const level_config& config)
+    : _capacity{config.storage == level_storage::ladder ? config.window : 0}
+    , _tick{config.tick_size ? config.tick_size : 1}
+    , _origin{0}
+    , _window_levels{0}
+    , _best{_capacity}
+{
+}
+
+template<side_type Side>
+price_level& price_ladder<Side>::lookup(uint64_t price)
+{
+    size_t idx;
+    if (slot(price, idx) && _window[idx].price != empty) {
+        return _window[idx];
+    }
+    auto it = _overflow.find(price);
+    if (it == _overflow.end()) {
+        throw invalid_argument(string("invalid price: ") + to_string(price));
+    }
+    return it->second;
+}
+
+template<side_type Side>
+void price_ladder<Side>::erase(price_level& level)
+{
+    if (&level < _window.data() || &level >= _window.data() + _window.size()) {
+        _overflow.erase(level.price);
+        return;
+    }
+    level = price_level{empty};
+    _window_levels--;
+    size_t idx = &level - _window.data();
+    if (idx == _best) {
+        if (!_window_levels) {
+            _best = _capacity;
+            return;
+        }
+        while (_window[_best].price == empty) {
+            _best++;
+        }
+    }
+}
+
+template<side_type Side>
+const price_level* price_ladder<Side>::level(size_t depth) const
+{
+    size_t idx = _best;
+    auto it = _overflow.begin();
+    for (;;) {
+        while (idx < _capacity && _window[idx].price == empty) {
+            idx++;
+        }
+        const price_level* next;
+        if (idx < _capacity && (it == _overflow.end() || better(_window[idx].price, it->first))) {
+            next = &_window[idx++];
+        } else if (it != _overflow.end()) {
+            next = &it->second;
+            it++;
+        } else {
+            return nullptr;
+        }
+        if (!depth--) {
+            return next;
+        }
+    }
+}
+
+template<side_type Side>
+size_t price_ladder<Side>::copy(depth_level* levels, size_t depth) const
+{
+    size_t idx = _best;
+    auto it = _overflow.begin();
+    size_t nr = 0;
+    while (nr < depth) {
+        while (idx < _capacity && _window[idx].price == empty) {
+            idx++;
+        }
+        const price_level* next;
+        if (idx < _capacity && (it == _overflow.end() || better(_window[idx].price, it->first))) {
+            next = &_window[idx++];
+        } else if (it != _overflow.end()) {
+            next = &it->second;
+            it++;
+        } else {
+            break;
+        }
+        levels[nr].price = next->price;
+        levels[nr].size  = next->size;
+        nr++;
+    }
+    return nr;
+}
+
+template<side_type Side>
+void price_ladder<Side>::recentre(uint64_t price)
+{
+    // Leave a quarter of the window for prices that improve on the new best.
+    uint64_t margin = (_capacity / 4) * _tick;
+    uint64_t origin;
+    if (Side == side_type::buy) {
+        origin = price <= empty - margin ? price + margin : price;
+    } else {
+        origin = price >= margin ? price - margin : 0;
+    }
+    std::vector<price_level> old_window(_capacity, price_level{empty});
+    old_window.swap(_window);
+    _origin = origin;
+    _window_levels = 0;
+    _best = _capacity;
+    for (auto&& level : old_window) {
+        if (level.price == empty) {
+            continue;
+        }
+        size_t idx;
+        if (slot(level.price, idx)) {
+            occupy(idx, level.price) = level;
+        } else {
+            _overflow.emplace(level.price, level);
+        }
+    }
+    for (auto it = _overflow.begin(); it != _overflow.end(); ) {
+        size_t idx;
+        if (slot(it->first, idx)) {
+            occupy(idx, it->first) = it->second;
+            it = _overflow.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+template<side_type Side>
+size_t price_ladder<Side>::memory_usage() const
+{
+    // A tree node holds the key and the level and three links and a colour.
+    size_t node_size = sizeof(uint64_t) + sizeof(price_level) + 4 * sizeof(void*);
+    return _window.capacity() * sizeof(price_level) + _overflow.size() * node_size;
+}
+
+template class price_ladder<side_type::buy>;
+template class price_ladder<side_type::sell>;
+
+order_book::order_book(std::string symbol, uint64_t timestamp, size_t max_orders, const level_config& levels)
     : _symbol{std::move(symbol)}
     , _timestamp{timestamp}
     , _state{trading_state::unknown}
+    , _max_orders{max_orders}
+    , _own_pool{new order_pool{max_orders}}
+    , _pool{_own_pool.get()}
+    , _order_count{0}
+    , _linked{levels.order_queues || levels.storage == level_storage::ladder}
+    , _bids{levels}
+    , _asks{levels}
+    , _levels{levels}
+    , _depth_changed{false}
+    , _bid_depth_price{0}
+    , _ask_depth_price{std::numeric_limits<uint64_t>::max()}
+    , _published{levels.published_depth ? new published_book{levels.published_depth} : nullptr}
 {
-#if BOOST_VERSION >= 105600
-    _orders.reserve(max_orders);
-#endif
 }
 
-void order_book::add(order order)
+order_book::order_book(std::string symbol, uint64_t timestamp, order_pool& pool, const level_config& levels)
+    : _symbol{std::move(symbol)}
+    , _timestamp{timestamp}
+    , _state{trading_state::unknown}
+    , _max_orders{0}
+    , _pool{&pool}
+    , _order_count{0}
+    , _linked{true}
+    , _bids{levels}
+    , _asks{levels}
+    , _levels{levels}
+    , _depth_changed{false}
+    , _bid_depth_price{0}
+    , _ask_depth_price{std::numeric_limits<uint64_t>::max()}
+    , _published{levels.published_depth ? new published_book{levels.published_depth} : nullptr}
 {
-    switch (order.side) {
-    case side_type::buy: {
-        auto&& level = lookup_or_create(_bids, order.price);
-        order.level = &level;
-        level.size += order.quantity;
-        break;
+}
+
+status order_book::add(order order)
+{
+    if (order.side != side_type::buy && order.side != side_type::sell) {
+        return status::invalid_side;
     }
-    case side_type::sell: {
-        auto&& level = lookup_or_create(_asks, order.price);
-        order.level = &level;
-        level.size += order.quantity;
-        break;
+    // The order ID index is only needed for orders added by ID, so it is
+    // sized on first use.
+    if (!_orders.size()) {
+        _orders.reserve(_max_orders);
     }
-    default:
+    if (_orders.find(order.id)) {
+        return status::duplicate_order;
+    }
+    uint64_t order_id = order.id;
+    _orders.insert(order_id, insert(std::move(order)));
+    return status::ok;
+}
+
+uint32_t order_book::insert(order order)
+{
+    if (order.side != side_type::buy && order.side != side_type::sell) {
         throw invalid_argument(string("invalid side: ") + static_cast<char>(order.side));
     }
-    _orders.emplace(std::move(order));
+    // The order is in the pool without a price level until it is added to
+    // one, so relocating levels skips it.
+    order.level = nullptr;
+    uint32_t slot = _pool->alloc(order);
+    if (order.side == side_type::buy) {
+        add(slot, _bids);
+    } else {
+        add(slot, _asks);
+    }
+    return slot;
 }
 
-void order_book::replace(uint64_t order_id, order order)
+template<side_type Side>
+void order_book::add(uint32_t slot, price_ladder<Side>& levels)
 {
-    remove(order_id);
-    add(std::move(order));
+    auto&& level = levels.lookup_or_create((*_pool)[slot].price, [this, &levels] {
+        relocate(levels);
+    });
+    auto&& o = (*_pool)[slot];
+    o.level = &level;
+    level.size += o.quantity;
+    if (_linked) {
+        link(level, slot);
+    }
+    _order_count++;
+    touch(levels, o.price);
 }
 
-void order_book::cancel(uint64_t order_id, uint64_t quantity)
+void order_book::link(price_level& level, uint32_t slot)
 {
-    auto it = _orders.find(order_id);
-    if (it == _orders.end()) {
-        throw invalid_argument(string("invalid order id: ") + to_string(order_id));
+    auto&& o = (*_pool)[slot];
+    o.prev = level.tail;
+    o.next = null_slot;
+    if (level.tail != null_slot) {
+        (*_pool)[level.tail].next = slot;
+    } else {
+        level.head = slot;
     }
-    _orders.modify(it, [quantity](order& order) {
-        order.quantity -= quantity;
-        order.level->size -= quantity;
-    });
-    if (!it->quantity) {
-        remove(it);
+    level.tail = slot;
+}
+
+void order_book::unlink(price_level& level, uint32_t slot)
+{
+    auto&& o = (*_pool)[slot];
+    if (o.prev != null_slot) {
+        (*_pool)[o.prev].next = o.next;
+    } else {
+        level.head = o.next;
+    }
+    if (o.next != null_slot) {
+        (*_pool)[o.next].prev = o.prev;
+    } else {
+        level.tail = o.prev;
+    }
+}
+
+void order_book::check_order_queues() const
+{
+    if (!_linked) {
+        throw logic_error("order book does not keep order queues: " + _symbol);
     }
 }
 
-std::pair<uint64_t, side_type> order_book::execute(uint64_t order_id, uint64_t quantity)
+queue_position order_book::position_at(uint32_t slot) const
 {
-    auto it = _orders.find(order_id);
-    if (it == _orders.end()) {
-        throw invalid_argument(string("invalid order id: ") + to_string(order_id));
+    check_order_queues();
+    queue_position pos{0, 0};
+    for (uint32_t s = (*_pool)[slot].prev; s != null_slot; s = (*_pool)[s].prev) {
+        pos.orders++;
+        pos.quantity += (*_pool)[s].quantity;
     }
-    auto ret = std::make_pair(it->price, it->side);
-    _orders.modify(it, [quantity](order& order) {
-        order.quantity -= quantity;
-        order.level->size -= quantity;
+    return pos;
+}
+
+status order_book::position(uint64_t order_id, queue_position& pos) const
+{
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    pos = position_at(e->value);
+    return status::ok;
+}
+
+template<side_type Side>
+void order_book::relocate(price_ladder<Side>& levels)
+{
+    // Only ladders re-centre and books with a ladder link their orders, so
+    // the orders of every level can be found without scanning the pool.
+    levels.for_each_level([this](price_level& level) {
+        for (uint32_t slot = level.head; slot != null_slot; slot = (*_pool)[slot].next) {
+            (*_pool)[slot].level = &level;
+        }
     });
-    if (!it->quantity) {
-        remove(it);
+}
+
+status order_book::replace(uint64_t order_id, order order)
+{
+    if (order.side != side_type::buy && order.side != side_type::sell) {
+        return status::invalid_side;
+    }
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    if (order.id != order_id && _orders.find(order.id)) {
+        return status::duplicate_order;
     }
-    return ret;
+    remove_at(e->value);
+    _orders.erase(e);
+    return add(std::move(order));
 }
 
-void order_book::remove(uint64_t order_id)
+status order_book::cancel(uint64_t order_id, uint64_t quantity)
 {
-    auto it = _orders.find(order_id);
-    if (it == _orders.end()) {
-        throw invalid_argument(string("invalid order id: ") + to_string(order_id));
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    if (quantity > (*_pool)[e->value].quantity) {
+        return status::invalid_quantity;
+    }
+    if (cancel_at(e->value, quantity)) {
+        _orders.erase(e);
     }
-    remove(it);
+    return status::ok;
 }
 
-void order_book::remove(iterator& iter)
+status order_book::execute(uint64_t order_id, uint64_t quantity, uint64_t& price, side_type& side)
 {
-    auto && order = *iter;
-    switch (order.side) {
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    auto&& order = (*_pool)[e->value];
+    if (quantity > order.quantity) {
+        return status::invalid_quantity;
+    }
+    price = order.price;
+    side = order.side;
+    if (execute_at(e->value, quantity)) {
+        _orders.erase(e);
+    }
+    return status::ok;
+}
+
+status order_book::remove(uint64_t order_id)
+{
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    remove_at(e->value);
+    _orders.erase(e);
+    return status::ok;
+}
+
+bool order_book::cancel_at(uint32_t slot, uint64_t quantity)
+{
+    auto&& order = (*_pool)[slot];
+    if (quantity > order.quantity) {
+        throw invalid_argument("invalid quantity: " + to_string(quantity));
+    }
+    order.quantity -= quantity;
+    order.level->size -= quantity;
+    if (!order.quantity) {
+        remove_at(slot);
+        return true;
+    }
+    touch(order.side, order.price);
+    return false;
+}
+
+bool order_book::execute_at(uint32_t slot, uint64_t quantity)
+{
+    return cancel_at(slot, quantity);
+}
+
+void order_book::remove_at(uint32_t slot)
+{
+    switch ((*_pool)[slot].side) {
     case side_type::buy: {
-        remove(order, _bids);
+        remove(slot, _bids);
         break;
     }
     case side_type::sell: {
-        remove(order, _asks);
+        remove(slot, _asks);
         break;
     }
     default:
-        throw invalid_argument(string("invalid side: ") + static_cast<char>(order.side));
+        throw invalid_argument(string("invalid side: ") + static_cast<char>((*_pool)[slot].side));
     }
-    _orders.erase(iter);
+    _pool->free(slot);
 }
 
-template<typename T>
-void order_book::remove(const order& o, T& levels)
+template<side_type Side>
+void order_book::remove(uint32_t slot, price_ladder<Side>& levels)
 {
-    auto it = levels.find(o.price);
-    if (it == levels.end()) {
-        throw invalid_argument(string("invalid price: ") + to_string(o.price));
+    auto&& o = (*_pool)[slot];
+    auto&& level = *o.level;
+    if (_linked) {
+        unlink(level, slot);
     }
-    auto&& level = it->second;
-    o.level->size -= o.quantity;
+    _order_count--;
+    level.size -= o.quantity;
     if (level.size == 0) {
-        levels.erase(it);
+        levels.erase(level);
     }
+    touch(levels, o.price);
 }
 
-template<typename T>
-price_level& order_book::lookup_or_create(T& levels, uint64_t price)
+void order_book::touch(side_type side, uint64_t price)
 {
-    auto it = levels.find(price);
-    if (it != levels.end()) {
-        return it->second;
+    switch (side) {
+    case side_type::buy:  touch(_bids, price); break;
+    case side_type::sell: touch(_asks, price); break;
+    default:              throw invalid_argument(string("invalid side: ") + static_cast<char>(side));
     }
-    price_level level{price};
-    levels.emplace(price, level);
-    it = levels.find(price);
-    return it->second;
 }
 
-side_type order_book::side(uint64_t order_id) const
+// A change at a price is within the top levels unless there are at least
+// that many levels strictly better than the price. This holds for levels
+// that were created, modified or removed by the change, so the change is
+// compared with the price of the last top level before it. Only a change
+// at or inside that level can move it, which is when it is looked up again.
+template<side_type Side>
+void order_book::touch(const price_ladder<Side>& levels, uint64_t price)
 {
-    auto it = _orders.find(order_id);
-    if (it == _orders.end()) {
-        throw invalid_argument(string("invalid order id: ") + to_string(order_id));
+    if (!_levels.depth) {
+        _depth_changed = true;
+        return;
+    }
+    auto&& depth_price = Side == side_type::buy ? _bid_depth_price : _ask_depth_price;
+    if (Side == side_type::buy ? price < depth_price : price > depth_price) {
+        return;
     }
-    return it->side;
+    _depth_changed = true;
+    auto* last = levels.level(_levels.depth - 1);
+    if (last) {
+        depth_price = last->price;
+    } else {
+        depth_price = Side == side_type::buy ? 0 : std::numeric_limits<uint64_t>::max();
+    }
+}
+
+status order_book::side(uint64_t order_id, side_type& side) const
+{
+    auto* e = _orders.find(order_id);
+    if (!e) {
+        return status::unknown_order;
+    }
+    side = (*_pool)[e->value].side;
+    return status::ok;
 }
 
 
@@ -155,57 +511,56 @@ size_t order_book::ask_levels() const
 
 size_t order_book::order_count() const
 {
-    return _orders.size();
+    return _order_count;
 }
 
-uint64_t order_book::bid_price(size_t level) const
+size_t order_book::memory_usage() const
 {
-    auto it = _bids.begin();
-    while (it != _bids.end() && level--) {
-        it++;
+    size_t size = sizeof(*this) + _symbol.capacity() + _orders.memory_usage()
+                + _bids.memory_usage() + _asks.memory_usage();
+    if (_own_pool) {
+        size += sizeof(order_pool) + _own_pool->memory_usage();
+    } else {
+        size += _order_count * sizeof(order);
     }
-    if (it != _bids.end()) {
-        auto&& level = it->second;
-        return level.price;
+    if (_published) {
+        size += _published->memory_usage();
+    }
+    return size;
+}
+
+uint64_t order_book::bid_price(size_t level) const
+{
+    auto* l = _bids.level(level);
+    if (l) {
+        return l->price;
     }
     return std::numeric_limits<uint64_t>::min();
 }
 
 uint64_t order_book::bid_size(size_t level) const
 {
-    auto it = _bids.begin();
-    while (it != _bids.end() && level--) {
-        it++;
-    }
-    if (it != _bids.end()) {
-        auto&& level = it->second;
-        return level.size;
+    auto* l = _bids.level(level);
+    if (l) {
+        return l->size;
     }
     return 0;
 }
 
 uint64_t order_book::ask_price(size_t level) const
 {
-    auto it = _asks.begin();
-    while (it != _asks.end() && level--) {
-        it++;
-    }
-    if (it != _asks.end()) {
-        auto&& level = it->second;
-        return level.price;
+    auto* l = _asks.level(level);
+    if (l) {
+        return l->price;
     }
     return std::numeric_limits<uint64_t>::max();
 }
 
 uint64_t order_book::ask_size(size_t level) const
 {
-    auto it = _asks.begin();
-    while (it != _asks.end() && level--) {
-        it++;
-    }
-    if (it != _asks.end()) {
-        auto&& level = it->second;
-        return level.size;
+    auto* l = _asks.level(level);
+    if (l) {
+        return l->size;
     }
     return 0;
 }
@@ -217,6 +572,75 @@ uint64_t order_book::midprice(size_t level) const
     return (bid + ask) / 2;
 }
 
+void order_book::depth(depth_level* bids, depth_level* asks, size_t levels) const
+{
+    for (size_t i = _bids.copy(bids, levels); i < levels; i++) {
+        bids[i].price = std::numeric_limits<uint64_t>::min();
+        bids[i].size  = 0;
+    }
+    for (size_t i = _asks.copy(asks, levels); i < levels; i++) {
+        asks[i].price = std::numeric_limits<uint64_t>::max();
+        asks[i].size  = 0;
+    }
+}
+
+published_book::published_book(size_t depth)
+    : _seq{0}
+    , _depth{depth}
+    , _words{new std::atomic<uint64_t>[2 + 4 * depth]}
+    , _scratch(2 * depth)
+{
+    for (size_t i = 0; i < 2 + 4 * depth; i++) {
+        _words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t published_book::memory_usage() const
+{
+    return sizeof(*this) + (2 + 4 * _depth) * sizeof(uint64_t) + _scratch.capacity() * sizeof(depth_level);
+}
+
+void published_book::store(const order_book& ob)
+{
+    auto* bids = _scratch.data();
+    auto* asks = bids + _depth;
+    ob.depth(bids, asks, _depth);
+    uint64_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _words[0].store(ob.timestamp(), std::memory_order_relaxed);
+    _words[1].store(static_cast<uint64_t>(ob.state()), std::memory_order_relaxed);
+    for (size_t i = 0; i < 2 * _depth; i++) {
+        _words[2 + 2 * i].store(bids[i].price, std::memory_order_relaxed);
+        _words[3 + 2 * i].store(bids[i].size, std::memory_order_relaxed);
+    }
+    _seq.store(seq + 2, std::memory_order_release);
+}
+
+uint64_t published_book::read(uint64_t& timestamp, trading_state& state,
+                              depth_level* bids, depth_level* asks, size_t levels) const
+{
+    levels = std::min(levels, _depth);
+    for (;;) {
+        uint64_t seq = _seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        timestamp = _words[0].load(std::memory_order_relaxed);
+        state = static_cast<trading_state>(_words[1].load(std::memory_order_relaxed));
+        for (size_t i = 0; i < levels; i++) {
+            bids[i].price = _words[2 + 2 * i].load(std::memory_order_relaxed);
+            bids[i].size  = _words[3 + 2 * i].load(std::memory_order_relaxed);
+            asks[i].price = _words[2 + 2 * (_depth + i)].load(std::memory_order_relaxed);
+            asks[i].size  = _words[3 + 2 * (_depth + i)].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) == seq) {
+            return seq / 2;
+        }
+    }
+}
+
 }
 
 }
@@ -0,0 +1,66 @@
+#include "helix/replay.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace helix {
+
+namespace core {
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+replay_clock::replay_clock(double speed, uint64_t max_gap)
+    : _ticks_per_nsec{0}
+    , _paced{speed > 0}
+    , _started{false}
+    , _origin_tsc{0}
+    , _origin_time{0}
+    , _last_time{0}
+    , _max_gap{max_gap}
+    , _late{0}
+{
+    if (speed < 0) {
+        throw invalid_argument("invalid replay speed: " + to_string(speed));
+    }
+    if (_paced) {
+        _ticks_per_nsec = tsc_ticks_per_nsec() / speed;
+    }
+}
+
+void replay_clock::wait(uint64_t time)
+{
+    if (!_paced || !time) {
+        return;
+    }
+    uint64_t now = read_tsc();
+    if (!_started || time < _last_time) {
+        _started = true;
+        _origin_tsc = now;
+        _origin_time = time;
+        _last_time = time;
+        return;
+    }
+    if (_max_gap && time - _last_time > _max_gap) {
+        _origin_time += time - _last_time - _max_gap;
+    }
+    _last_time = time;
+    uint64_t target = _origin_tsc + uint64_t(double(time - _origin_time) * _ticks_per_nsec);
+    if (now > target) {
+        _late++;
+    }
+    while (now < target) {
+        cpu_relax();
+        now = read_tsc();
+    }
+    _lag.record(uint64_t(double(now - target) / tsc_ticks_per_nsec()));
+}
+
+}
+
+}
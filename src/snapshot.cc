@@ -0,0 +1,213 @@
+#include "helix/snapshot.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <cstring>
+#include <limits>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace core {
+
+static const char snapshot_magic[8] = {'H', 'E', 'L', 'I', 'X', 'S', 'N', 'P'};
+
+constexpr uint32_t snapshot::version;
+
+snapshot::snapshot()
+    : _data(sizeof(header))
+{
+    auto* h = reinterpret_cast<header*>(_data.data());
+    memcpy(h->magic, snapshot_magic, sizeof(h->magic));
+    h->version = version;
+    h->book_count = 0;
+    h->seq_num = 0;
+    h->clock = 0;
+}
+
+uint64_t snapshot::seq_num() const
+{
+    return reinterpret_cast<const header*>(_data.data())->seq_num;
+}
+
+void snapshot::set_seq_num(uint64_t seq_num)
+{
+    reinterpret_cast<header*>(_data.data())->seq_num = seq_num;
+}
+
+uint64_t snapshot::clock() const
+{
+    return reinterpret_cast<const header*>(_data.data())->clock;
+}
+
+void snapshot::set_clock(uint64_t clock)
+{
+    reinterpret_cast<header*>(_data.data())->clock = clock;
+}
+
+void snapshot::add(const order_book& ob, uint64_t key)
+{
+    if (ob.symbol().size() >= sizeof(book::symbol)) {
+        throw invalid_argument("symbol is too long: " + ob.symbol());
+    }
+    size_t offset = _data.size();
+    _data.resize(offset + sizeof(book) + ob.order_count() * sizeof(order));
+    auto* b = reinterpret_cast<book*>(&_data[offset]);
+    memset(b, 0, sizeof(*b));
+    memcpy(b->symbol, ob.symbol().data(), ob.symbol().size());
+    b->key = key;
+    b->timestamp = ob.timestamp();
+    b->max_orders = ob.max_orders();
+    b->tick_size = ob.levels().tick_size;
+    b->window = ob.levels().window;
+    b->depth = ob.levels().depth;
+    b->state = static_cast<uint8_t>(ob.state());
+    b->storage = static_cast<uint8_t>(ob.levels().storage);
+    b->order_queues = ob.levels().order_queues;
+    b->published_depth = ob.levels().published_depth;
+    auto* orders = reinterpret_cast<order*>(b + 1);
+    size_t count = 0;
+    ob.for_each_order([&](const core::order& o) {
+        auto&& r = orders[count++];
+        memset(&r, 0, sizeof(r));
+        r.id = o.id;
+        r.price = o.price;
+        r.timestamp = o.timestamp;
+        r.quantity = o.quantity;
+        r.side = static_cast<uint8_t>(o.side);
+    });
+    b->order_count = count;
+    reinterpret_cast<header*>(_data.data())->book_count++;
+}
+
+void snapshot::write(const std::string& path) const
+{
+    string tmp_path = path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), tmp_path);
+    }
+    const char* p = _data.data();
+    size_t len = _data.size();
+    while (len) {
+        ssize_t nr = ::write(fd, p, len);
+        if (nr < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            ::close(fd);
+            ::unlink(tmp_path.c_str());
+            throw system_error(err, system_category(), tmp_path);
+        }
+        p += nr;
+        len -= nr;
+    }
+    if (::fsync(fd) < 0 || ::close(fd) < 0) {
+        int err = errno;
+        ::unlink(tmp_path.c_str());
+        throw system_error(err, system_category(), tmp_path);
+    }
+    if (::rename(tmp_path.c_str(), path.c_str()) < 0) {
+        int err = errno;
+        ::unlink(tmp_path.c_str());
+        throw system_error(err, system_category(), path);
+    }
+}
+
+level_config snapshot::levels(const book& b)
+{
+    level_config levels;
+    levels.storage = static_cast<level_storage>(b.storage);
+    levels.tick_size = b.tick_size;
+    levels.window = b.window;
+    levels.depth = b.depth;
+    levels.published_depth = b.published_depth;
+    levels.order_queues = b.order_queues;
+    return levels;
+}
+
+core::order snapshot::to_order(const order& o)
+{
+    static_assert(numeric_limits<decltype(o.quantity)>::max() <= numeric_limits<decltype(core::order::quantity)>::max(),
+                  "order records hold quantities that do not fit in an order");
+    auto side = static_cast<side_type>(o.side);
+    if (o.price > core::order::max_price || !o.quantity || (side != side_type::buy && side != side_type::sell)) {
+        throw runtime_error("corrupt snapshot: invalid order " + to_string(o.id));
+    }
+    return core::order{o.id, static_cast<uint32_t>(o.price), o.quantity, side, o.timestamp};
+}
+
+mapped_snapshot::mapped_snapshot(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, system_category(), path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw system_error(err, system_category(), path);
+    }
+    _size = st.st_size;
+    if (_size < sizeof(snapshot::header)) {
+        ::close(fd);
+        throw runtime_error(path + ": not a snapshot");
+    }
+    void* addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw system_error(err, system_category(), path);
+    }
+    _data = static_cast<const char*>(addr);
+    try {
+        validate();
+    } catch (...) {
+        ::munmap(const_cast<char*>(_data), _size);
+        throw;
+    }
+}
+
+mapped_snapshot::~mapped_snapshot()
+{
+    ::munmap(const_cast<char*>(_data), _size);
+}
+
+void mapped_snapshot::validate() const
+{
+    auto&& h = header();
+    if (memcmp(h.magic, snapshot_magic, sizeof(h.magic))) {
+        throw runtime_error("not a snapshot");
+    }
+    if (h.version != snapshot::version) {
+        throw runtime_error("unsupported snapshot version: " + to_string(h.version));
+    }
+    size_t offset = sizeof(snapshot::header);
+    for (uint32_t i = 0; i < h.book_count; i++) {
+        if (_size - offset < sizeof(snapshot::book)) {
+            throw runtime_error("truncated snapshot");
+        }
+        auto* b = reinterpret_cast<const snapshot::book*>(_data + offset);
+        offset += sizeof(snapshot::book);
+        if (b->symbol[sizeof(b->symbol) - 1] != '\0') {
+            throw runtime_error("invalid symbol in snapshot");
+        }
+        if (b->order_count > (_size - offset) / sizeof(snapshot::order)) {
+            throw runtime_error("truncated snapshot");
+        }
+        offset += b->order_count * sizeof(snapshot::order);
+    }
+}
+
+}
+
+}
@@ -0,0 +1,162 @@
+#include "helix/udp.hh"
+
+#include <system_error>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace std;
+
+namespace helix {
+
+namespace net {
+
+// Large enough for any UDP datagram.
+static constexpr size_t max_datagram_size = 65536;
+
+static constexpr size_t control_size = CMSG_SPACE(sizeof(struct timespec));
+
+static void throw_errno(const char* what)
+{
+    throw system_error(errno, system_category(), what);
+}
+
+udp_receiver::udp_receiver(const udp_config& config)
+    : _fd{-1}
+    , _timestamps{config.timestamps}
+    , _line{config.line}
+    , _timestamp{0}
+{
+    if (!config.batch_size) {
+        throw invalid_argument("invalid batch size: 0");
+    }
+    _fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_fd < 0) {
+        throw_errno("socket");
+    }
+    try {
+        int one = 1;
+        if (::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) {
+            throw_errno("setsockopt(SO_REUSEADDR)");
+        }
+        if (config.rcvbuf_size) {
+            int size = config.rcvbuf_size;
+            if (::setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+                throw_errno("setsockopt(SO_RCVBUF)");
+            }
+        }
+        if (config.busy_poll_usec) {
+            int usec = config.busy_poll_usec;
+            if (::setsockopt(_fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+                throw_errno("setsockopt(SO_BUSY_POLL)");
+            }
+        }
+        if (config.timestamps) {
+            if (::setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0) {
+                throw_errno("setsockopt(SO_TIMESTAMPNS)");
+            }
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(config.port);
+        if (::bind(_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw_errno("bind");
+        }
+        struct ip_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        if (!inet_aton(config.multicast_addr.c_str(), &mreq.imr_multiaddr)) {
+            throw invalid_argument("invalid multicast address: " + config.multicast_addr);
+        }
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (!config.interface_addr.empty() && !inet_aton(config.interface_addr.c_str(), &mreq.imr_interface)) {
+            throw invalid_argument("invalid interface address: " + config.interface_addr);
+        }
+        if (::setsockopt(_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            throw_errno("setsockopt(IP_ADD_MEMBERSHIP)");
+        }
+    } catch (...) {
+        ::close(_fd);
+        throw;
+    }
+    size_t batch_size = config.batch_size;
+    _buffers.resize(batch_size * max_datagram_size);
+    _controls.resize(batch_size * control_size);
+    _iovecs.resize(batch_size);
+    _msgs.resize(batch_size);
+    _packets.reserve(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+        _iovecs[i].iov_base = &_buffers[i * max_datagram_size];
+        _iovecs[i].iov_len  = max_datagram_size;
+    }
+}
+
+udp_receiver::~udp_receiver()
+{
+    ::close(_fd);
+}
+
+size_t udp_receiver::receive(core::session& session, bool wait)
+{
+    // The kernel overwrites the header lengths, so reset them every time.
+    for (size_t i = 0; i < _msgs.size(); i++) {
+        auto&& hdr = _msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &_iovecs[i];
+        hdr.msg_iovlen = 1;
+        if (_timestamps) {
+            hdr.msg_control = &_controls[i * control_size];
+            hdr.msg_controllen = control_size;
+        }
+    }
+    if (wait) {
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+        if (::poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) {
+                return 0;
+            }
+            throw_errno("poll");
+        }
+    }
+    int nr = ::recvmmsg(_fd, _msgs.data(), _msgs.size(), MSG_DONTWAIT, nullptr);
+    if (nr < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        throw_errno("recvmmsg");
+    }
+    if (!_timestamps && _line == core::feed_line::a) {
+        _packets.clear();
+        for (int i = 0; i < nr; i++) {
+            _packets.emplace_back(static_cast<const char*>(_iovecs[i].iov_base), _msgs[i].msg_len);
+        }
+        session.process_packets(_packets.data(), _packets.size());
+        return nr;
+    }
+    for (int i = 0; i < nr; i++) {
+        auto&& hdr = _msgs[i].msg_hdr;
+        _timestamp = 0;
+        for (auto* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                _timestamp = uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            }
+        }
+        session.set_rx_timestamp(_timestamp);
+        session.process_line_packet(_line, packet_view{static_cast<const char*>(_iovecs[i].iov_base), _msgs[i].msg_len});
+    }
+    return nr;
+}
+
+}
+
+}
@@ -0,0 +1,99 @@
+// Checks the ASCII decimal field decoders against a reference decoder for
+// every field width, with values that fill the field, values that are
+// padded with leading spaces or zeroes, and empty fields. The word-based
+// decoder is always checked and the SSE decoder is checked if the test is
+// built for SSE4.1.
+//
+// Every field is decoded from a buffer of exactly its width, so a build
+// with AddressSanitizer also checks that no decoder reads past the end.
+
+#include <helix/ascii.hh>
+
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace helix;
+
+struct result {
+    size_t checked = 0;
+    size_t failed = 0;
+};
+
+static uint64_t reference(const std::string& field)
+{
+    uint64_t value = 0;
+    for (char c : field) {
+        value = value * 10 + (c == ' ' ? 0 : c - '0');
+    }
+    return value;
+}
+
+template<size_t N>
+static void check(const std::string& field, result& r)
+{
+    std::unique_ptr<char[]> buf{new char[N]};
+    field.copy(buf.get(), N);
+    auto&& array = *reinterpret_cast<const char(*)[N]>(buf.get());
+    uint64_t expected = reference(field);
+    bool ok = core::detail::decode_swar<N>(buf.get()) == expected;
+#ifdef __SSE4_1__
+    ok &= core::detail::decode_sse<N>(buf.get()) == expected;
+#endif
+    ok &= core::decode_decimal(array) == expected;
+    r.checked++;
+    if (!ok) {
+        r.failed++;
+        std::cout << "error: width " << N << ": '" << field << "' decoded wrong" << std::endl;
+    }
+}
+
+// Right-justifies \p digits in a field of \p N characters.
+template<size_t N>
+static std::string pad(const std::string& digits, char padding)
+{
+    return std::string(N - digits.size(), padding) + digits;
+}
+
+template<size_t N>
+static void check_width(std::mt19937_64& rng, result& r)
+{
+    check<N>(std::string(N, ' '), r);
+    check<N>(std::string(N, '0'), r);
+    check<N>(std::string(N, '9'), r);
+    for (size_t len = 1; len <= N; len++) {
+        for (int i = 0; i < 100; i++) {
+            std::string digits;
+            for (size_t j = 0; j < len; j++) {
+                digits += static_cast<char>('0' + rng() % 10);
+            }
+            check<N>(pad<N>(digits, ' '), r);
+            check<N>(pad<N>(digits, '0'), r);
+        }
+        check<N>(pad<N>("1" + std::string(len - 1, '0'), ' '), r);
+    }
+    check_width<N - 1>(rng, r);
+}
+
+template<>
+void check_width<0>(std::mt19937_64&, result&)
+{
+}
+
+int main()
+{
+    std::mt19937_64 rng{1};
+    result r;
+    check_width<16>(rng, r);
+#ifdef __SSE4_1__
+    const char* decoders = "SWAR and SSE";
+#else
+    const char* decoders = "SWAR";
+#endif
+    bool ok = r.failed == 0;
+    std::cout << "decode_decimal, " << decoders << ", " << r.checked << " fields: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
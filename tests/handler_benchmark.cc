@@ -0,0 +1,662 @@
+// End-to-end feed handler benchmarks.
+//
+// The synthetic benchmarks generate add, execute, cancel, delete and replace
+// message mixes with prices spread over a configurable book depth around a
+// drifting midpoint, encode them as ITCH 5.0 and Nordic ITCH messages and
+// replay them through itch50_handler and nordic_itch_handler. Recorded
+// message mixes are replayed from uncompressed files through a session:
+//
+//   handler_benchmark --itch50=FILE --nordic-soup=FILE --symbol=AAPL
+//
+// Besides the time per message, the benchmarks report heap allocations and,
+// where perf events are available, last-level cache misses per message.
+
+#include <helix/nasdaq/nordic_itch_handler.hh>
+#include <helix/nasdaq/nordic_itch_session.hh>
+// Both protocols define their own ITCH_SYMBOL_LEN.
+#undef ITCH_SYMBOL_LEN
+#include <helix/nasdaq/itch50_handler.hh>
+#include <helix/nasdaq/itch50_session.hh>
+#include <helix/order_book.hh>
+#include <helix/net.hh>
+
+#include <benchmark/benchmark.h>
+
+#include <system_error>
+#include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <new>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <endian.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace helix;
+
+static std::atomic<uint64_t> allocations{0};
+
+// The replacement allocation functions are not inlined so that the compiler
+// keeps pairing new and delete instead of seeing malloc() and free().
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc{};
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Hardware event counter of the calling thread, or an invalid counter if
+// perf events are not available.
+class perf_counter {
+    int _fd;
+public:
+    perf_counter(uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~perf_counter() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    perf_counter(const perf_counter&) = delete;
+    perf_counter& operator=(const perf_counter&) = delete;
+
+    bool valid() const {
+        return _fd >= 0;
+    }
+
+    void start() {
+        if (_fd >= 0) {
+            ::ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        if (_fd >= 0) {
+            ::ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    uint64_t value() const {
+        uint64_t count = 0;
+        if (_fd >= 0 && ::read(_fd, &count, sizeof(count)) != sizeof(count)) {
+            count = 0;
+        }
+        return count;
+    }
+};
+
+// Measures the timed region of every iteration and reports per-message
+// counters when it goes out of scope.
+class measurement {
+    benchmark::State& _state;
+    size_t _messages;
+    perf_counter _cache_misses{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    uint64_t _allocations = 0;
+    uint64_t _allocations_start = 0;
+public:
+    measurement(benchmark::State& state, size_t messages)
+        : _state{state}
+        , _messages{messages}
+    { }
+
+    ~measurement() {
+        auto total = double(_state.iterations()) * _messages;
+        _state.SetItemsProcessed(_state.iterations() * _messages);
+        _state.counters["time/msg"] = benchmark::Counter(_messages, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+        _state.counters["allocs/msg"] = total ? _allocations / total : 0.0;
+        if (_cache_misses.valid()) {
+            _state.counters["cache-misses/msg"] = total ? _cache_misses.value() / total : 0.0;
+        }
+    }
+
+    void start() {
+        _allocations_start = allocations.load(std::memory_order_relaxed);
+        _cache_misses.start();
+    }
+
+    void stop() {
+        _cache_misses.stop();
+        _allocations += allocations.load(std::memory_order_relaxed) - _allocations_start;
+    }
+};
+
+// Message mix of a synthetic feed.
+struct message_mix {
+    const char* name;
+    // Relative frequencies of the message types.
+    unsigned add;
+    unsigned execute;
+    unsigned cancel;
+    unsigned remove;
+    unsigned replace;
+    // Number of price levels per side that orders are placed on.
+    unsigned depth;
+    // Average number of resting orders per order book.
+    size_t resting_orders;
+};
+
+static const message_mix mixes[] = {
+    // Roughly the message type frequencies of a NASDAQ trading day.
+    {"nasdaq",        40,  3, 2, 37, 18,  100,  2000},
+    // Quotes that are added and deleted at the top of the book.
+    {"top-of-book",   50,  1, 0, 49,  0,    4,   200},
+    // Deep books with many price levels.
+    {"deep",          40,  3, 5, 32, 20, 1000, 20000},
+    // Market makers that update their quotes with replaces.
+    {"replace-heavy", 20,  2, 3, 15, 60,   50,  2000},
+};
+
+static constexpr size_t symbol_count = 8;
+static constexpr size_t message_count = 1000000;
+static constexpr uint64_t tick_size = 100;
+static constexpr uint64_t initial_midpoint = 1000000;
+
+enum class event_type { add, execute, cancel, remove, replace };
+
+struct event {
+    event_type type;
+    uint16_t book;
+    uint64_t order_id;
+    uint64_t new_order_id;
+    core::side_type side;
+    uint64_t price;
+    uint32_t quantity;
+};
+
+struct resting_order {
+    uint64_t id;
+    core::side_type side;
+    uint64_t price;
+    uint32_t quantity;
+};
+
+static std::string symbol_name(size_t book)
+{
+    return "SYM" + std::to_string(book);
+}
+
+// Generates a deterministic event stream for a message mix. Every book keeps
+// the number of resting orders around the average of the mix and its
+// midpoint takes a random walk, so price levels are created and erased
+// throughout the stream.
+static std::vector<event> generate_events(const message_mix& mix)
+{
+    std::mt19937_64 rng{42};
+    std::vector<std::vector<resting_order>> books(symbol_count);
+    std::vector<uint64_t> midpoints(symbol_count, initial_midpoint);
+    std::geometric_distribution<unsigned> level_dist{4.0 / (mix.depth + 4.0)};
+    std::uniform_int_distribution<uint32_t> quantity_dist{1, 10};
+    std::discrete_distribution<int> type_dist{double(mix.add), double(mix.execute), double(mix.cancel), double(mix.remove), double(mix.replace)};
+    uint64_t next_order_id = 1;
+    auto price = [&](uint16_t book, core::side_type side) {
+        uint64_t offset = (1 + std::min(level_dist(rng), mix.depth - 1)) * tick_size;
+        return side == core::side_type::buy ? midpoints[book] - offset : midpoints[book] + offset;
+    };
+    std::vector<event> events;
+    events.reserve(message_count);
+    while (events.size() < message_count) {
+        uint16_t book = rng() % symbol_count;
+        auto&& orders = books[book];
+        if (rng() % 64 == 0) {
+            midpoints[book] += rng() % 2 ? tick_size : -tick_size;
+        }
+        auto type = static_cast<event_type>(type_dist(rng));
+        if (orders.size() < mix.resting_orders / 2) {
+            type = event_type::add;
+        } else if (orders.size() > mix.resting_orders * 2) {
+            type = event_type::remove;
+        }
+        event e{type, book, 0, 0, core::side_type::buy, 0, 0};
+        if (type == event_type::add) {
+            e.order_id = next_order_id++;
+            e.side = rng() % 2 ? core::side_type::buy : core::side_type::sell;
+            e.price = price(book, e.side);
+            e.quantity = quantity_dist(rng) * 100;
+            orders.push_back(resting_order{e.order_id, e.side, e.price, e.quantity});
+            events.push_back(e);
+            continue;
+        }
+        size_t idx = rng() % orders.size();
+        auto&& o = orders[idx];
+        e.order_id = o.id;
+        e.side = o.side;
+        switch (type) {
+        case event_type::execute:
+            e.quantity = std::min(o.quantity, quantity_dist(rng) * 100);
+            o.quantity -= e.quantity;
+            break;
+        case event_type::cancel:
+            if (o.quantity < 2) {
+                e.type = event_type::remove;
+                o.quantity = 0;
+                break;
+            }
+            e.quantity = 1 + rng() % (o.quantity - 1);
+            o.quantity -= e.quantity;
+            break;
+        case event_type::remove:
+            o.quantity = 0;
+            break;
+        case event_type::replace:
+            e.new_order_id = next_order_id++;
+            e.price = price(book, o.side);
+            e.quantity = quantity_dist(rng) * 100;
+            o.id = e.new_order_id;
+            o.price = e.price;
+            o.quantity = e.quantity;
+            break;
+        case event_type::add:
+            break;
+        }
+        if (!o.quantity) {
+            o = orders.back();
+            orders.pop_back();
+        }
+        events.push_back(e);
+    }
+    return events;
+}
+
+// Encoded messages of a feed that are parsed back to back.
+struct feed {
+    std::vector<char> data;
+    size_t messages = 0;
+
+    template<typename T>
+    T* append() {
+        size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        messages++;
+        return reinterpret_cast<T*>(data.data() + offset);
+    }
+};
+
+static uint64_t itch50_raw_timestamp(uint64_t timestamp)
+{
+    return htobe64(timestamp) >> 16;
+}
+
+static feed encode_itch50(const std::vector<event>& events)
+{
+    feed f;
+    uint64_t timestamp = 34200000000000;
+    for (size_t book = 0; book < symbol_count; book++) {
+        auto* m = f.append<itch50_stock_directory>();
+        std::memset(m, ' ', sizeof(*m));
+        m->MessageType = 'R';
+        m->StockLocate = htobe16(book + 1);
+        m->TrackingNumber = 0;
+        m->Timestamp = itch50_raw_timestamp(timestamp);
+        auto sym = symbol_name(book);
+        std::memcpy(m->Stock, sym.data(), sym.size());
+        m->RoundLotSize = htobe32(100);
+        m->ETPLeverageFactor = 0;
+    }
+    for (auto&& e : events) {
+        timestamp += 1000;
+        uint16_t locate = htobe16(e.book + 1);
+        switch (e.type) {
+        case event_type::add: {
+            auto* m = f.append<itch50_add_order>();
+            m->MessageType = 'A';
+            m->StockLocate = locate;
+            m->TrackingNumber = 0;
+            m->Timestamp = itch50_raw_timestamp(timestamp);
+            m->OrderReferenceNumber = htobe64(e.order_id);
+            m->BuySellIndicator = e.side == core::side_type::buy ? 'B' : 'S';
+            m->Shares = htobe32(e.quantity);
+            std::memset(m->Stock, ' ', sizeof(m->Stock));
+            auto sym = symbol_name(e.book);
+            std::memcpy(m->Stock, sym.data(), sym.size());
+            m->Price = htobe32(e.price);
+            break;
+        }
+        case event_type::execute: {
+            auto* m = f.append<itch50_order_executed>();
+            m->MessageType = 'E';
+            m->StockLocate = locate;
+            m->TrackingNumber = 0;
+            m->Timestamp = itch50_raw_timestamp(timestamp);
+            m->OrderReferenceNumber = htobe64(e.order_id);
+            m->ExecutedShares = htobe32(e.quantity);
+            m->MatchNumber = htobe64(f.messages);
+            break;
+        }
+        case event_type::cancel: {
+            auto* m = f.append<itch50_order_cancel>();
+            m->MessageType = 'X';
+            m->StockLocate = locate;
+            m->TrackingNumber = 0;
+            m->Timestamp = itch50_raw_timestamp(timestamp);
+            m->OrderReferenceNumber = htobe64(e.order_id);
+            m->CanceledShares = htobe32(e.quantity);
+            break;
+        }
+        case event_type::remove: {
+            auto* m = f.append<itch50_order_delete>();
+            m->MessageType = 'D';
+            m->StockLocate = locate;
+            m->TrackingNumber = 0;
+            m->Timestamp = itch50_raw_timestamp(timestamp);
+            m->OrderReferenceNumber = htobe64(e.order_id);
+            break;
+        }
+        case event_type::replace: {
+            auto* m = f.append<itch50_order_replace>();
+            m->MessageType = 'U';
+            m->StockLocate = locate;
+            m->TrackingNumber = 0;
+            m->Timestamp = itch50_raw_timestamp(timestamp);
+            m->OriginalOrderReferenceNumber = htobe64(e.order_id);
+            m->NewOrderReferenceNumber = htobe64(e.new_order_id);
+            m->Shares = htobe32(e.quantity);
+            m->Price = htobe32(e.price);
+            break;
+        }
+        }
+    }
+    return f;
+}
+
+// Formats a zero-padded ASCII number into a fixed-width field.
+template<size_t N>
+static void itch_format(char (&field)[N], uint64_t value)
+{
+    for (size_t i = N; i > 0; i--) {
+        field[i - 1] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+static void encode_nordic_add(feed& f, const event& e, uint64_t order_id, uint64_t price, uint32_t quantity)
+{
+    auto* m = f.append<itch_add_order>();
+    m->MsgType = 'A';
+    itch_format(m->OrderReferenceNumber, order_id);
+    m->BuySellIndicator = e.side == core::side_type::buy ? 'B' : 'S';
+    itch_format(m->Quantity, quantity);
+    itch_format(m->OrderBook, e.book + 1);
+    itch_format(m->Price, price);
+}
+
+static void encode_nordic_delete(feed& f, uint64_t order_id)
+{
+    auto* m = f.append<itch_order_delete>();
+    m->MsgType = 'D';
+    itch_format(m->OrderReferenceNumber, order_id);
+}
+
+// Nordic ITCH has no order replace message, so replaces are encoded as a
+// delete followed by an add.
+static feed encode_nordic(const std::vector<event>& events)
+{
+    feed f;
+    auto* seconds = f.append<itch_seconds>();
+    seconds->MsgType = 'T';
+    itch_format(seconds->Second, 32400);
+    for (size_t book = 0; book < symbol_count; book++) {
+        auto* m = f.append<itch_order_book_directory>();
+        std::memset(m, ' ', sizeof(*m));
+        m->MsgType = 'R';
+        itch_format(m->OrderBook, book + 1);
+        auto sym = symbol_name(book);
+        std::memcpy(m->Symbol, sym.data(), sym.size());
+        itch_format(m->RoundLotSize, 100);
+    }
+    uint64_t millisecond = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        auto&& e = events[i];
+        if (i % 1000 == 0) {
+            auto* m = f.append<itch_milliseconds>();
+            m->MsgType = 'M';
+            itch_format(m->Millisecond, millisecond++ % 1000);
+        }
+        switch (e.type) {
+        case event_type::add:
+            encode_nordic_add(f, e, e.order_id, e.price, e.quantity);
+            break;
+        case event_type::execute: {
+            auto* m = f.append<itch_order_executed>();
+            std::memset(m, ' ', sizeof(*m));
+            m->MsgType = 'E';
+            itch_format(m->OrderReferenceNumber, e.order_id);
+            itch_format(m->ExecutedQuantity, e.quantity);
+            itch_format(m->MatchNumber, f.messages);
+            break;
+        }
+        case event_type::cancel: {
+            auto* m = f.append<itch_order_cancel>();
+            m->MsgType = 'X';
+            itch_format(m->OrderReferenceNumber, e.order_id);
+            itch_format(m->CanceledQuantity, e.quantity);
+            break;
+        }
+        case event_type::remove:
+            encode_nordic_delete(f, e.order_id);
+            break;
+        case event_type::replace:
+            encode_nordic_delete(f, e.order_id);
+            encode_nordic_add(f, e, e.new_order_id, e.price, e.quantity);
+            break;
+        }
+    }
+    return f;
+}
+
+template<typename Handler>
+static void replay_feed(benchmark::State& state, const feed& f, const message_mix& mix, const core::level_config& levels)
+{
+    uint64_t events = 0;
+    measurement m{state, f.messages};
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<Handler> handler{new Handler};
+        handler->listener().register_callback(core::ob_callback{[&events](const core::order_book&) { events++; }});
+        handler->listener().register_callback(core::trade_callback{[&events](const core::trade&) { events++; }});
+        for (size_t book = 0; book < symbol_count; book++) {
+            handler->subscribe(symbol_name(book), mix.resting_orders * 4, levels);
+        }
+        m.start();
+        state.ResumeTiming();
+        const char* p = f.data.data();
+        const char* end = p + f.data.size();
+        while (p < end) {
+            p += handler->parse(net::packet_view{p, size_t(end - p)});
+        }
+        state.PauseTiming();
+        m.stop();
+        handler.reset();
+        state.ResumeTiming();
+    }
+    benchmark::DoNotOptimize(events);
+}
+
+static std::vector<char> read_file(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), path);
+    }
+    std::vector<char> data;
+    char buf[1024 * 1024];
+    for (;;) {
+        ssize_t nr = ::read(fd, buf, sizeof(buf));
+        if (nr < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), path);
+        }
+        if (!nr) {
+            break;
+        }
+        data.insert(data.end(), buf, buf + nr);
+    }
+    ::close(fd);
+    return data;
+}
+
+static std::unique_ptr<core::session> new_recorded_session(core::protocol& proto, const std::vector<std::string>& symbols, uint64_t& events)
+{
+    std::unique_ptr<core::session> session{proto.new_session(nullptr)};
+    session->register_callback(core::ob_callback{[&events](const core::order_book&) { events++; }});
+    session->register_callback(core::trade_callback{[&events](const core::trade&) { events++; }});
+    for (auto&& sym : symbols) {
+        session->subscribe(sym, 1000000);
+    }
+    return session;
+}
+
+// Replays a recorded file through a session and returns the number of
+// records processed.
+static size_t replay_recorded(core::session& session, const std::vector<char>& data)
+{
+    size_t records = 0;
+    const char* p = data.data();
+    const char* end = p + data.size();
+    while (p < end) {
+        size_t nr = session.process_packet(net::packet_view{p, size_t(end - p)});
+        if (!nr) {
+            break;
+        }
+        p += nr;
+        records++;
+    }
+    return records;
+}
+
+static void register_recorded(const std::string& name, std::shared_ptr<core::protocol> proto, const std::string& path, const std::vector<std::string>& symbols)
+{
+    auto data = std::make_shared<std::vector<char>>(read_file(path));
+    benchmark::RegisterBenchmark(name.c_str(), [proto, data, symbols](benchmark::State& state) {
+        uint64_t events = 0;
+        size_t records = replay_recorded(*new_recorded_session(*proto, symbols, events), *data);
+        measurement m{state, records};
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto session = new_recorded_session(*proto, symbols, events);
+            m.start();
+            state.ResumeTiming();
+            replay_recorded(*session, *data);
+            state.PauseTiming();
+            m.stop();
+            session.reset();
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(events);
+    })->Unit(benchmark::kMillisecond);
+}
+
+static void register_synthetic()
+{
+    core::level_config tree;
+    tree.storage = core::level_storage::tree;
+    core::level_config ladder;
+    ladder.storage = core::level_storage::ladder;
+    ladder.tick_size = tick_size;
+    const std::pair<const char*, core::level_config> level_configs[] = {
+        {"tree", tree},
+        {"ladder", ladder},
+    };
+    for (auto&& mix : mixes) {
+        auto events = generate_events(mix);
+        auto itch50 = std::make_shared<feed>(encode_itch50(events));
+        auto nordic = std::make_shared<feed>(encode_nordic(events));
+        for (auto&& lc : level_configs) {
+            auto suffix = std::string{"/"} + mix.name + "/" + lc.first;
+            auto levels = lc.second;
+            benchmark::RegisterBenchmark(("itch50_handler" + suffix).c_str(), [itch50, mix, levels](benchmark::State& state) {
+                replay_feed<nasdaq::itch50_handler>(state, *itch50, mix, levels);
+            })->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("nordic_itch_handler" + suffix).c_str(), [nordic, mix, levels](benchmark::State& state) {
+                replay_feed<nasdaq::nordic_itch_handler>(state, *nordic, mix, levels);
+            })->Unit(benchmark::kMillisecond);
+        }
+    }
+}
+
+static bool parse_option(const char* arg, const char* name, std::string& value)
+{
+    size_t len = std::strlen(name);
+    if (std::strncmp(arg, name, len) || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    std::string itch50_file;
+    std::string nordic_file;
+    std::vector<std::string> symbols;
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (parse_option(argv[i], "--itch50", itch50_file) || parse_option(argv[i], "--nordic-soup", nordic_file)) {
+            continue;
+        }
+        if (parse_option(argv[i], "--symbol", value)) {
+            symbols.push_back(value);
+            continue;
+        }
+        std::fprintf(stderr, "error: unknown option '%s'\n", argv[i]);
+        return 1;
+    }
+    if (symbols.empty()) {
+        symbols.push_back("AAPL");
+    }
+    try {
+        register_synthetic();
+        if (!itch50_file.empty()) {
+            register_recorded("itch50_session/recorded", std::make_shared<nasdaq::itch50_protocol>("nasdaq-binaryfile-itch50"), itch50_file, symbols);
+        }
+        if (!nordic_file.empty()) {
+            register_recorded("nordic_itch_session/recorded", std::make_shared<nasdaq::nordic_itch_protocol>("nasdaq-nordic-soupfile-itch"), nordic_file, symbols);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,486 @@
+// Checks that the sharded ITCH 5.0 session builds the same order books as
+// the single-threaded one, both when it replays a feed from the start and
+// when it resumes from a snapshot of a single-threaded session, and whether
+// the feed is passed in one packet or one record per packet.
+//
+// The feed is synthetic: a stock directory of several hundred symbols, whose
+// locate codes differ in both bytes, followed by random adds, executions,
+// cancellations and deletions.
+
+#include <helix/nasdaq/itch50_session.hh>
+#include <helix/nasdaq/itch50_messages.h>
+#include <helix/order_book.hh>
+#include <helix/snapshot.hh>
+#include <helix/net.hh>
+
+#include <stdexcept>
+
+#include <unordered_map>
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace helix;
+
+static constexpr uint16_t symbol_count = 300;
+static constexpr size_t order_count = 200000;
+static constexpr size_t max_orders = 100000;
+
+// BinaryFILE records of a synthetic feed.
+class feed {
+    std::vector<char> _data;
+    uint64_t _timestamp = 34200000000000;
+public:
+    template<typename T>
+    T message(char type, uint16_t locate) {
+        T m;
+        std::memset(&m, 0, sizeof(m));
+        m.MessageType = type;
+        m.StockLocate = htobe16(locate);
+        m.Timestamp = htobe64(_timestamp++) >> 16;
+        return m;
+    }
+
+    template<typename T>
+    void append(const T& m) {
+        append(reinterpret_cast<const char*>(&m), sizeof(m));
+    }
+
+    void append(const char* p, uint16_t size) {
+        uint16_t len = htobe16(size);
+        _data.insert(_data.end(), reinterpret_cast<const char*>(&len), reinterpret_cast<const char*>(&len) + sizeof(len));
+        _data.insert(_data.end(), p, p + size);
+    }
+
+    size_t size() const {
+        return _data.size();
+    }
+
+    const char* data() const {
+        return _data.data();
+    }
+};
+
+static std::string symbol_of(uint16_t locate)
+{
+    std::string symbol = "S" + std::to_string(locate);
+    symbol.resize(ITCH_SYMBOL_LEN, ' ');
+    return symbol;
+}
+
+struct resting_order {
+    uint16_t locate;
+    uint64_t id;
+    uint32_t quantity;
+};
+
+// Builds the feed and returns the offset of the record that the snapshot is
+// taken before.
+static size_t build_feed(feed& f)
+{
+    std::mt19937_64 rng{42};
+    for (uint16_t locate = 1; locate <= symbol_count; locate++) {
+        auto m = f.message<itch50_stock_directory>('R', locate);
+        std::memcpy(m.Stock, symbol_of(locate).data(), sizeof(m.Stock));
+        m.RoundLotSize = htobe32(100);
+        f.append(m);
+    }
+    std::vector<resting_order> resting;
+    uint64_t next_id = 1;
+    auto add = [&](uint16_t locate) {
+        auto m = f.message<itch50_add_order>('A', locate);
+        resting_order o{locate, next_id++, uint32_t(100 + rng() % 900)};
+        m.OrderReferenceNumber = htobe64(o.id);
+        m.BuySellIndicator = rng() % 2 ? 'B' : 'S';
+        m.Shares = htobe32(o.quantity);
+        std::memcpy(m.Stock, symbol_of(locate).data(), sizeof(m.Stock));
+        uint32_t price = m.BuySellIndicator == 'B' ? 990000 - rng() % 5000 : 1000000 + rng() % 5000;
+        m.Price = htobe32(price / 100 * 100);
+        f.append(m);
+        resting.push_back(o);
+    };
+    size_t snapshot_offset = 0;
+    for (size_t i = 0; i < order_count; i++) {
+        if (i == order_count / 2) {
+            snapshot_offset = f.size();
+            // Change every book after the snapshot so that all of them are
+            // delivered to the callback.
+            for (uint16_t locate = 1; locate <= symbol_count; locate++) {
+                add(locate);
+            }
+        }
+        unsigned action = rng() % 10;
+        if (resting.empty() || action < 5) {
+            add(1 + rng() % symbol_count);
+            continue;
+        }
+        size_t idx = rng() % resting.size();
+        auto&& o = resting[idx];
+        if (action < 7) {
+            auto m = f.message<itch50_order_executed>('E', o.locate);
+            m.OrderReferenceNumber = htobe64(o.id);
+            uint32_t shares = 1 + rng() % o.quantity;
+            m.ExecutedShares = htobe32(shares);
+            m.MatchNumber = htobe64(i);
+            f.append(m);
+            o.quantity -= shares;
+        } else if (action < 8) {
+            auto m = f.message<itch50_order_cancel>('X', o.locate);
+            m.OrderReferenceNumber = htobe64(o.id);
+            uint32_t shares = 1 + rng() % o.quantity;
+            m.CanceledShares = htobe32(shares);
+            f.append(m);
+            o.quantity -= shares;
+        } else {
+            auto m = f.message<itch50_order_delete>('D', o.locate);
+            m.OrderReferenceNumber = htobe64(o.id);
+            f.append(m);
+            o.quantity = 0;
+        }
+        if (!o.quantity) {
+            o = resting.back();
+            resting.pop_back();
+        }
+    }
+    return snapshot_offset;
+}
+
+// Last delivered order book of every symbol.
+struct books {
+    std::unordered_map<std::string, const core::order_book*> by_symbol;
+
+    void attach(core::session& s) {
+        s.register_callback([this](const core::order_book& ob) {
+            // Books are only touched by the shard that owns them, but the
+            // map is shared by all shards.
+            static std::mutex mutex;
+            std::lock_guard<std::mutex> lock{mutex};
+            by_symbol[ob.symbol()] = &ob;
+        });
+        s.register_callback([](const core::trade&) { });
+    }
+};
+
+static std::string describe(const core::order_book& ob)
+{
+    std::string s = std::to_string(ob.order_count());
+    for (size_t level = 0; level < 5; level++) {
+        s += " " + std::to_string(ob.bid_price(level)) + "x" + std::to_string(ob.bid_size(level))
+           + "/" + std::to_string(ob.ask_price(level)) + "x" + std::to_string(ob.ask_size(level));
+    }
+    return s;
+}
+
+static bool compare(const char* name, const books& expected, const books& actual, const core::session& s)
+{
+    bool ok = true;
+    for (size_t i = 1; i < core::status_count; i++) {
+        auto count = s.error_count(static_cast<core::status>(i));
+        if (count) {
+            std::cerr << name << ": " << count << " messages dropped with status '"
+                      << core::status_string(static_cast<core::status>(i)) << "'" << std::endl;
+            ok = false;
+        }
+    }
+    if (actual.by_symbol.size() != expected.by_symbol.size()) {
+        std::cerr << name << ": " << actual.by_symbol.size() << " order books, expected "
+                  << expected.by_symbol.size() << std::endl;
+        ok = false;
+    }
+    for (auto&& kv : expected.by_symbol) {
+        auto it = actual.by_symbol.find(kv.first);
+        if (it == actual.by_symbol.end()) {
+            std::cerr << name << ": " << kv.first << ": no order book" << std::endl;
+            ok = false;
+            continue;
+        }
+        auto want = describe(*kv.second);
+        auto got = describe(*it->second);
+        if (want != got) {
+            std::cerr << name << ": " << kv.first << ": " << got << ", expected " << want << std::endl;
+            ok = false;
+        }
+    }
+    std::cout << name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Replays the records between two offsets either in one packet or one
+// record per packet.
+static void replay(core::session& s, const feed& f, size_t from, size_t to, bool per_record)
+{
+    if (!per_record) {
+        s.process_packet(net::packet_view{f.data() + from, to - from});
+        return;
+    }
+    for (size_t off = from; off < to; ) {
+        uint16_t payload_len;
+        std::memcpy(&payload_len, f.data() + off, sizeof(payload_len));
+        size_t len = sizeof(payload_len) + be16toh(payload_len);
+        s.process_packet(net::packet_view{f.data() + off, len});
+        off += len;
+    }
+}
+
+// Checks that a failure in several shards is reported once and not again
+// by the next call.
+static bool test_errors(nasdaq::itch50_protocol& proto)
+{
+    feed bad;
+    for (uint16_t locate = 1; locate <= 2; locate++) {
+        auto m = bad.message<itch50_stock_directory>('R', locate);
+        std::memcpy(m.Stock, symbol_of(locate).data(), sizeof(m.Stock));
+        bad.append(m);
+    }
+    // Deletions of unknown orders fail in both shards.
+    for (uint16_t locate = 1; locate <= 2; locate++) {
+        auto m = bad.message<itch50_order_delete>('D', locate);
+        m.OrderReferenceNumber = htobe64(locate);
+        bad.append(m);
+    }
+    feed good;
+    auto event = good.message<itch50_system_event>('S', 0);
+    event.EventCode = 'O';
+    good.append(event);
+
+    std::unique_ptr<core::session> s{proto.new_sharded_session(2, nullptr)};
+    books unused;
+    unused.attach(*s);
+    s->subscribe_all(max_orders);
+    s->set_strict(true);
+    bool ok = false;
+    try {
+        s->process_packet(net::packet_view{bad.data(), bad.size()});
+    } catch (const std::invalid_argument&) {
+        ok = true;
+    }
+    try {
+        s->process_packet(net::packet_view{good.data(), good.size()});
+    } catch (const std::exception&) {
+        ok = false;
+    }
+    std::cout << "errors: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Checks that a record too short for a stock locate code is reported after
+// the records before it have been processed.
+static bool test_truncated(nasdaq::itch50_protocol& proto)
+{
+    feed bad;
+    auto dir = bad.message<itch50_stock_directory>('R', 1);
+    std::memcpy(dir.Stock, symbol_of(1).data(), sizeof(dir.Stock));
+    bad.append(dir);
+    auto add = bad.message<itch50_add_order>('A', 1);
+    add.OrderReferenceNumber = htobe64(1);
+    add.BuySellIndicator = 'B';
+    add.Shares = htobe32(100);
+    add.Price = htobe32(990000);
+    std::memcpy(add.Stock, symbol_of(1).data(), sizeof(add.Stock));
+    bad.append(add);
+    bad.append("A", 1);
+
+    std::unique_ptr<core::session> s{proto.new_sharded_session(2, nullptr)};
+    books last;
+    last.attach(*s);
+    s->subscribe_all(max_orders);
+    bool ok = false;
+    try {
+        s->process_packet(net::packet_view{bad.data(), bad.size()});
+    } catch (const std::runtime_error&) {
+        ok = true;
+    }
+    auto it = last.by_symbol.find(symbol_of(1));
+    ok &= it != last.by_symbol.end() && it->second->order_count() == 1;
+    std::cout << "truncated record: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Checks that executions and cancellations of more than the quantity of an
+// order are dropped without changing the book.
+static bool test_invalid_quantity(nasdaq::itch50_protocol& proto)
+{
+    feed f;
+    auto dir = f.message<itch50_stock_directory>('R', 1);
+    std::memcpy(dir.Stock, symbol_of(1).data(), sizeof(dir.Stock));
+    f.append(dir);
+    auto add = f.message<itch50_add_order>('A', 1);
+    add.OrderReferenceNumber = htobe64(1);
+    add.BuySellIndicator = 'B';
+    add.Shares = htobe32(100);
+    add.Price = htobe32(990000);
+    std::memcpy(add.Stock, symbol_of(1).data(), sizeof(add.Stock));
+    f.append(add);
+    auto executed = f.message<itch50_order_executed>('E', 1);
+    executed.OrderReferenceNumber = htobe64(1);
+    executed.ExecutedShares = htobe32(101);
+    f.append(executed);
+    auto executed_with_price = f.message<itch50_order_executed_with_price>('C', 1);
+    executed_with_price.OrderReferenceNumber = htobe64(1);
+    executed_with_price.ExecutedShares = htobe32(200);
+    executed_with_price.ExecutionPrice = htobe32(990000);
+    f.append(executed_with_price);
+    auto cancel = f.message<itch50_order_cancel>('X', 1);
+    cancel.OrderReferenceNumber = htobe64(1);
+    cancel.CanceledShares = htobe32(150);
+    f.append(cancel);
+    executed.ExecutedShares = htobe32(40);
+    f.append(executed);
+
+    std::unique_ptr<core::session> s{proto.new_sharded_session(2, nullptr)};
+    books last;
+    last.attach(*s);
+    s->subscribe_all(max_orders);
+    s->process_packet(net::packet_view{f.data(), f.size()});
+    bool ok = s->error_count(core::status::invalid_quantity) == 3;
+    auto it = last.by_symbol.find(symbol_of(1));
+    ok &= it != last.by_symbol.end() && it->second->order_count() == 1 && it->second->bid_size(0) == 60;
+    std::cout << "invalid quantity: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Checks that restoring a snapshot with an invalid order record fails.
+static bool test_corrupt_snapshot(nasdaq::itch50_protocol& proto)
+{
+    core::snapshot snap;
+    core::order_book ob{symbol_of(1), 0, 16};
+    ob.add(core::order{1, 990000, 100, core::side_type::buy, 0});
+    snap.add(ob, 1);
+    // Order records follow the record of their book.
+    size_t offset = sizeof(core::snapshot::header) + sizeof(core::snapshot::book);
+    struct patch {
+        size_t offset;
+        uint64_t value;
+        size_t size;
+    } patches[] = {
+        {offsetof(core::snapshot::order, price), uint64_t(core::order::max_price) + 1, sizeof(uint64_t)},
+        {offsetof(core::snapshot::order, quantity), 0, sizeof(uint32_t)},
+        {offsetof(core::snapshot::order, side), 'X', sizeof(uint8_t)},
+    };
+    bool ok = true;
+    for (auto&& p : patches) {
+        char path[] = "/tmp/itch50_sharded_test.XXXXXX";
+        int fd = ::mkstemp(path);
+        if (fd < 0) {
+            std::cerr << "error: unable to create a temporary file" << std::endl;
+            return false;
+        }
+        ::close(fd);
+        snap.write(path);
+        fd = ::open(path, O_WRONLY);
+        bool patched = fd >= 0 && ::pwrite(fd, &p.value, p.size, offset + p.offset) == ssize_t(p.size);
+        ::close(fd);
+        core::mapped_snapshot corrupt{path};
+        ::unlink(path);
+        bool thrown = false;
+        std::unique_ptr<core::session> s{proto.new_sharded_session(2, nullptr)};
+        books unused;
+        unused.attach(*s);
+        try {
+            s->restore(corrupt);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        ok &= patched && thrown;
+    }
+    std::cout << "corrupt snapshot: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Checks that symbols subscribed one by one only allocate orders in the
+// shard that owns their order book.
+static bool test_subscribe_memory(nasdaq::itch50_protocol& proto, const feed& f)
+{
+    size_t usage[2];
+    size_t shards[2] = {1, 4};
+    for (size_t i = 0; i < 2; i++) {
+        std::unique_ptr<core::session> s{proto.new_sharded_session(shards[i], nullptr)};
+        books unused;
+        unused.attach(*s);
+        for (uint16_t locate = 1; locate <= symbol_count; locate++) {
+            s->subscribe(symbol_of(locate), max_orders / symbol_count);
+        }
+        s->process_packet(net::packet_view{f.data(), f.size()});
+        usage[i] = s->memory_usage();
+    }
+    // The order index of a shard may round up to twice its share.
+    bool ok = usage[1] < usage[0] * 3 / 2;
+    if (!ok) {
+        std::cerr << "subscribe memory: " << usage[1] << " bytes with " << shards[1]
+                  << " shards, " << usage[0] << " bytes with " << shards[0] << std::endl;
+    }
+    std::cout << "subscribe memory: " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+int main()
+{
+    feed f;
+    size_t snapshot_offset = build_feed(f);
+
+    nasdaq::itch50_protocol proto{"nasdaq-binaryfile-itch50"};
+
+    books expected;
+    std::unique_ptr<core::session> reference{proto.new_session(nullptr)};
+    expected.attach(*reference);
+    reference->subscribe_all(max_orders);
+    replay(*reference, f, 0, f.size(), true);
+
+    char path[] = "/tmp/itch50_sharded_test.XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "error: unable to create a temporary file" << std::endl;
+        return 1;
+    }
+    ::close(fd);
+    {
+        std::unique_ptr<core::session> s{proto.new_session(nullptr)};
+        books unused;
+        unused.attach(*s);
+        s->subscribe_all(max_orders);
+        replay(*s, f, 0, snapshot_offset, true);
+        core::snapshot snap;
+        s->save(snap);
+        snap.write(path);
+    }
+    core::mapped_snapshot snap{path};
+    ::unlink(path);
+
+    bool ok = true;
+    for (size_t shards : {1, 2, 3, 4}) {
+        for (bool per_record : {false, true}) {
+            std::string suffix = std::to_string(shards) + " shards" + (per_record ? ", one record per packet" : "");
+
+            books full;
+            std::unique_ptr<core::session> s{proto.new_sharded_session(shards, nullptr)};
+            full.attach(*s);
+            s->subscribe_all(max_orders);
+            replay(*s, f, 0, f.size(), per_record);
+            ok &= compare(("replay, " + suffix).c_str(), expected, full, *s);
+
+            books resumed;
+            std::unique_ptr<core::session> r{proto.new_sharded_session(shards, nullptr)};
+            resumed.attach(*r);
+            r->restore(snap);
+            replay(*r, f, snapshot_offset, f.size(), per_record);
+            ok &= compare(("restore, " + suffix).c_str(), expected, resumed, *r);
+        }
+    }
+    ok &= test_errors(proto);
+    ok &= test_truncated(proto);
+    ok &= test_invalid_quantity(proto);
+    ok &= test_corrupt_snapshot(proto);
+    ok &= test_subscribe_memory(proto, f);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+// Checks MoldUDP gap handling: reordering of packets that arrive ahead of a
+// gap, dropping of duplicate messages, periodic retransmission requests,
+// giving up on a gap when the reorder buffer fills up, and A/B arbitration
+// that only requests messages that are missing on both lines or that the
+// lagging line is too far behind to deliver.
+//
+// Every message is a four-byte sequence number, so the messages that reach
+// the parser show the order in which they were processed.
+
+#include "moldudp.hh"
+
+#include <helix/nasdaq/moldudp_messages.h>
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace helix;
+
+using seq_list = std::vector<uint32_t>;
+using request_list = std::vector<std::pair<uint64_t, uint64_t>>;
+
+struct recorder : net::message_parser {
+    seq_list seq_nums;
+
+    size_t parse(const net::packet_view& packet) override {
+        uint32_t seq_num;
+        std::memcpy(&seq_num, packet.buf(), sizeof(seq_num));
+        seq_nums.push_back(seq_num);
+        return packet.len();
+    }
+};
+
+// Returns a packet of \p count messages starting at \p seq_num.
+static std::vector<char> packet(uint32_t seq_num, uint16_t count = 1)
+{
+    moldudp_header header;
+    std::memset(&header, ' ', sizeof(header));
+    header.SequenceNumber = seq_num;
+    header.MessageCount = count;
+    std::vector<char> data(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+    for (uint32_t i = 0; i < count; i++) {
+        moldudp_message_block block;
+        block.MessageLength = sizeof(uint32_t);
+        uint32_t msg = seq_num + i;
+        data.insert(data.end(), reinterpret_cast<const char*>(&block), reinterpret_cast<const char*>(&block) + sizeof(block));
+        data.insert(data.end(), reinterpret_cast<const char*>(&msg), reinterpret_cast<const char*>(&msg) + sizeof(msg));
+    }
+    return data;
+}
+
+struct session_test {
+    std::shared_ptr<recorder> parser = std::make_shared<recorder>();
+    nasdaq::moldudp_session session;
+    request_list requests;
+    seq_list lost;
+
+    explicit session_test(size_t buffer_size, uint32_t retransmit_interval = nasdaq::moldudp_session::default_retransmit_interval)
+        : session{parser, buffer_size, retransmit_interval}
+    {
+        session.set_retransmit_callback([this](uint64_t seq_num, uint64_t count) {
+            requests.emplace_back(seq_num, count);
+        });
+        session.set_error_callback([this](core::status s, uint64_t value) {
+            if (s == core::status::messages_lost) {
+                lost.push_back(value);
+            }
+        });
+    }
+
+    void feed(uint32_t seq_num, uint16_t count = 1) {
+        auto p = packet(seq_num, count);
+        session.parse(net::packet_view{p.data(), p.size()});
+    }
+};
+
+static bool report(const char* name, bool ok)
+{
+    std::cout << name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+static bool test_reorder()
+{
+    session_test t{4};
+    t.feed(1);
+    t.feed(3);
+    t.feed(4);
+    bool ok = t.parser->seq_nums == seq_list{1};
+    ok &= t.requests == request_list{{2, 1}};
+    t.feed(2);
+    ok &= t.parser->seq_nums == (seq_list{1, 2, 3, 4});
+    ok &= t.session.seq_num() == 5;
+    ok &= t.lost.empty();
+    return report("reorder", ok);
+}
+
+// Messages that were already processed, from a duplicate or an overlapping
+// packet, are dropped whether the packet is processed or buffered.
+static bool test_duplicates()
+{
+    session_test t{4};
+    t.feed(1, 2);
+    t.feed(2, 2);
+    t.feed(1);
+    t.feed(6, 2);
+    t.feed(6, 1);
+    t.feed(4, 3);
+    bool ok = t.parser->seq_nums == (seq_list{1, 2, 3, 4, 5, 6, 7});
+    ok &= t.session.seq_num() == 8;
+    return report("duplicates", ok);
+}
+
+// The messages that are still missing are requested again every third
+// packet, except for the ones that are in the reorder buffer.
+static bool test_retransmit_interval()
+{
+    session_test t{8, 3};
+    t.feed(1);
+    t.feed(3);
+    t.feed(6);
+    bool ok = t.requests == (request_list{{2, 1}, {4, 2}});
+    t.feed(7);
+    ok &= t.requests == (request_list{{2, 1}, {4, 2}, {2, 1}, {4, 2}});
+    t.feed(2);
+    t.feed(4, 2);
+    ok &= t.parser->seq_nums == (seq_list{1, 2, 3, 4, 5, 6, 7});
+    t.feed(8);
+    t.feed(9);
+    t.feed(10);
+    ok &= t.requests.size() == 4;
+    return report("retransmit interval", ok);
+}
+
+// A full reorder buffer gives up on the oldest gap and a late copy of the
+// skipped messages is then dropped.
+static bool test_skip_gap()
+{
+    session_test t{2};
+    t.feed(1);
+    t.feed(3);
+    t.feed(4);
+    t.feed(5);
+    bool ok = t.parser->seq_nums == (seq_list{1, 3, 4, 5});
+    ok &= t.lost == seq_list{1};
+    ok &= t.session.error_count(core::status::messages_lost) == 1;
+    ok &= t.session.seq_num() == 6;
+    t.feed(2);
+    ok &= t.parser->seq_nums == (seq_list{1, 3, 4, 5});
+    return report("skip gap", ok);
+}
+
+// A packet that does not fit into the buffer but precedes the buffered ones
+// only skips the messages before it.
+static bool test_skip_gap_before_buffered()
+{
+    session_test t{1};
+    t.feed(1);
+    t.feed(6);
+    t.feed(3);
+    bool ok = t.parser->seq_nums == (seq_list{1, 3});
+    ok &= t.lost == seq_list{1};
+    t.feed(4, 2);
+    ok &= t.parser->seq_nums == (seq_list{1, 3, 4, 5, 6});
+    ok &= t.lost == seq_list{1};
+    ok &= t.session.seq_num() == 7;
+    return report("skip gap before buffered packets", ok);
+}
+
+static bool test_reset()
+{
+    session_test t{4};
+    t.feed(1);
+    t.feed(3);
+    t.session.reset(10);
+    t.feed(2);
+    t.feed(10);
+    bool ok = t.parser->seq_nums == (seq_list{1, 10});
+    ok &= t.session.seq_num() == 11;
+    return report("reset", ok);
+}
+
+struct arbiter_test {
+    std::shared_ptr<recorder> parser = std::make_shared<recorder>();
+    nasdaq::moldudp_arbiter arbiter;
+    request_list requests;
+
+    explicit arbiter_test(uint32_t max_lag = nasdaq::moldudp_arbiter::default_max_lag)
+        : arbiter{parser, max_lag}
+    {
+        arbiter.set_retransmit_callback([this](uint64_t seq_num, uint64_t count) {
+            requests.emplace_back(seq_num, count);
+        });
+    }
+
+    void feed(core::feed_line line, uint32_t seq_num, uint16_t count = 1) {
+        auto p = packet(seq_num, count);
+        arbiter.parse(net::packet_view{p.data(), p.size()}, line);
+    }
+};
+
+static constexpr auto line_a = core::feed_line::a;
+static constexpr auto line_b = core::feed_line::b;
+
+// A gap on one line that the other line fills is not requested.
+static bool test_arbiter_fill()
+{
+    arbiter_test t;
+    t.feed(line_a, 1);
+    t.feed(line_b, 1);
+    t.feed(line_a, 3);
+    t.feed(line_a, 4);
+    t.feed(line_b, 2);
+    t.feed(line_b, 3);
+    t.feed(line_b, 4);
+    bool ok = t.parser->seq_nums == (seq_list{1, 2, 3, 4});
+    ok &= t.requests.empty();
+    return report("arbiter, gap filled by the other line", ok);
+}
+
+// A gap on both lines is requested once the second line passes it.
+static bool test_arbiter_both_lines()
+{
+    arbiter_test t;
+    t.feed(line_a, 1);
+    t.feed(line_b, 1);
+    t.feed(line_a, 3);
+    bool ok = t.requests.empty();
+    t.feed(line_b, 4);
+    ok &= t.requests == request_list{{2, 1}};
+    ok &= t.parser->seq_nums == seq_list{1};
+    return report("arbiter, gap on both lines", ok);
+}
+
+// A gap is requested once the leading line is max_lag messages past it,
+// even though the lagging line has not passed it.
+static bool test_arbiter_max_lag()
+{
+    arbiter_test t{4};
+    t.feed(line_a, 1);
+    t.feed(line_b, 1);
+    t.feed(line_a, 3);
+    t.feed(line_a, 4);
+    t.feed(line_a, 5);
+    bool ok = t.requests.empty();
+    t.feed(line_a, 6);
+    ok &= t.requests == request_list{{2, 1}};
+    // A request is only for the part of the gap that is still missing.
+    arbiter_test u{4};
+    u.feed(line_a, 1);
+    u.feed(line_b, 1);
+    u.feed(line_a, 4);
+    u.feed(line_a, 5);
+    u.feed(line_b, 2);
+    u.feed(line_a, 6);
+    u.feed(line_a, 7);
+    ok &= u.requests == request_list{{3, 1}};
+    return report("arbiter, max lag", ok);
+}
+
+// A line that has not received any packets does not hold back requests.
+static bool test_arbiter_single_line()
+{
+    arbiter_test t;
+    t.feed(line_a, 1);
+    t.feed(line_a, 3);
+    bool ok = t.requests == request_list{{2, 1}};
+    t.feed(line_a, 2);
+    ok &= t.parser->seq_nums == (seq_list{1, 2, 3});
+    return report("arbiter, single line", ok);
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= test_reorder();
+    ok &= test_duplicates();
+    ok &= test_retransmit_interval();
+    ok &= test_skip_gap();
+    ok &= test_skip_gap_before_buffered();
+    ok &= test_reset();
+    ok &= test_arbiter_fill();
+    ok &= test_arbiter_both_lines();
+    ok &= test_arbiter_max_lag();
+    ok &= test_arbiter_single_line();
+    return ok ? 0 : 1;
+}
@@ -39,16 +39,27 @@ auto test_remove(order_book& ob, unsigned long count)
     return end - start;
 }
 
-int main()
+void test(const char* name, const level_config& levels, unsigned long count)
 {
-    unsigned long count = 20000000;
-
-    order_book ob{"AXP", 0, count};
+    order_book ob{"AXP", 0, count, levels};
     auto add_duration = test_add(ob, count);
     auto cancel_duration = test_cancel(ob, count);
     auto remove_duration = test_remove(ob, count);
 
-    std::cout << "order_book::add()    " << std::chrono::duration_cast<std::chrono::nanoseconds>(add_duration).count() / count << " ns/op" << std::endl;
-    std::cout << "order_book::cancel() " << std::chrono::duration_cast<std::chrono::nanoseconds>(cancel_duration).count() / count << " ns/op" << std::endl;
-    std::cout << "order_book::remove() " << std::chrono::duration_cast<std::chrono::nanoseconds>(remove_duration).count() / count << " ns/op" << std::endl;
+    std::cout << "order_book::add()    " << name << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(add_duration).count() / count << " ns/op" << std::endl;
+    std::cout << "order_book::cancel() " << name << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(cancel_duration).count() / count << " ns/op" << std::endl;
+    std::cout << "order_book::remove() " << name << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(remove_duration).count() / count << " ns/op" << std::endl;
+}
+
+int main()
+{
+    unsigned long count = 20000000;
+
+    level_config tree;
+    tree.storage = level_storage::tree;
+    test("tree  ", tree, count);
+
+    level_config ladder;
+    ladder.storage = level_storage::ladder;
+    test("ladder", ladder, count);
 }
@@ -0,0 +1,294 @@
+// Checks order books that keep their price levels in a ladder: re-centring
+// the window on a new best price, falling back to the overflow tree for
+// prices outside of the window or off the tick grid, and keeping orders
+// attached to their levels as the levels move. A random workload is then
+// checked against a book that keeps every level in the tree. Finally,
+// quantities that exceed that of an order are checked to be rejected, and
+// the changes that depth_changed() reports to match copies of the top
+// levels.
+
+#include <helix/order_book.hh>
+
+#include <unordered_map>
+#include <stdexcept>
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace helix::core;
+
+static level_config ladder_config(size_t window)
+{
+    level_config levels;
+    levels.storage = level_storage::ladder;
+    levels.tick_size = 100;
+    levels.window = window;
+    return levels;
+}
+
+static bool report(const char* name, bool ok)
+{
+    std::cout << name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Checks the bid levels of a book from the best price down.
+static bool bids_are(const order_book& ob, const std::vector<depth_level>& expected)
+{
+    bool ok = ob.bid_levels() == expected.size();
+    for (size_t i = 0; i < expected.size(); i++) {
+        ok &= ob.bid_price(i) == expected[i].price && ob.bid_size(i) == expected[i].size;
+    }
+    return ok;
+}
+
+static bool asks_are(const order_book& ob, const std::vector<depth_level>& expected)
+{
+    bool ok = ob.ask_levels() == expected.size();
+    for (size_t i = 0; i < expected.size(); i++) {
+        ok &= ob.ask_price(i) == expected[i].price && ob.ask_size(i) == expected[i].size;
+    }
+    return ok;
+}
+
+// An eight-level window leaves two ticks above the best bid and below the
+// best ask, so a bid at 10000 opens a window from 10200 down to 9500.
+static bool test_recentre(order_book& ob)
+{
+    bool ok = ob.add(order{1, 10000, 100, side_type::buy, 1}) == status::ok;
+    ok &= ob.add(order{2, 9500, 200, side_type::buy, 2}) == status::ok;
+    // A better bid outside of the window re-centres it on 10500, which
+    // leaves 10000 in the window and moves 9500 out of it.
+    ok &= ob.add(order{3, 10500, 300, side_type::buy, 3}) == status::ok;
+    ok &= bids_are(ob, {{10500, 300}, {10000, 100}, {9500, 200}});
+    // Orders at moved levels update the levels they are at.
+    ok &= ob.cancel(1, 40) == status::ok;
+    ok &= ob.cancel(2, 50) == status::ok;
+    ok &= ob.add(order{4, 10000, 10, side_type::buy, 4}) == status::ok;
+    ok &= bids_are(ob, {{10500, 300}, {10000, 70}, {9500, 150}});
+    // A bid far above the window moves every other level to the tree.
+    ok &= ob.add(order{5, 20000, 500, side_type::buy, 5}) == status::ok;
+    ok &= bids_are(ob, {{20000, 500}, {10500, 300}, {10000, 70}, {9500, 150}});
+    ok &= ob.remove(5) == status::ok;
+    ok &= ob.remove(3) == status::ok;
+    ok &= ob.cancel(4, 10) == status::ok;
+    ok &= bids_are(ob, {{10000, 60}, {9500, 150}});
+
+    // The window of the ask side is independent of the bid side.
+    ok &= ob.add(order{6, 11000, 100, side_type::sell, 6}) == status::ok;
+    ok &= ob.add(order{7, 10600, 200, side_type::sell, 7}) == status::ok;
+    ok &= asks_are(ob, {{10600, 200}, {11000, 100}});
+    ok &= ob.cancel(6, 100) == status::ok;
+    ok &= ob.cancel(7, 150) == status::ok;
+    ok &= asks_are(ob, {{10600, 50}});
+    ok &= ob.order_count() == 3;
+    return ok;
+}
+
+// Prices that are not a multiple of the tick size and prices worse than
+// the window are kept in the tree and merged in price order.
+static bool test_fallback(order_book& ob)
+{
+    bool ok = ob.add(order{1, 10000, 100, side_type::buy, 1}) == status::ok;
+    ok &= ob.add(order{2, 10050, 200, side_type::buy, 2}) == status::ok;
+    ok &= ob.add(order{3, 9000, 300, side_type::buy, 3}) == status::ok;
+    ok &= ob.add(order{4, 9900, 400, side_type::buy, 4}) == status::ok;
+    ok &= ob.add(order{5, 10150, 500, side_type::buy, 5}) == status::ok;
+    ok &= bids_are(ob, {{10150, 500}, {10050, 200}, {10000, 100}, {9900, 400}, {9000, 300}});
+    // An off-grid price does not re-centre the window however good it is.
+    ok &= ob.add(order{6, 30001, 600, side_type::buy, 6}) == status::ok;
+    ok &= ob.bid_price(0) == 30001 && ob.bid_price(1) == 10150;
+    ok &= ob.remove(6) == status::ok;
+    ok &= ob.remove(2) == status::ok;
+    ok &= ob.cancel(5, 500) == status::ok;
+    ok &= bids_are(ob, {{10000, 100}, {9900, 400}, {9000, 300}});
+    ok &= ob.add(order{7, 9050, 700, side_type::sell, 7}) == status::ok;
+    ok &= ob.add(order{8, 9000, 800, side_type::sell, 8}) == status::ok;
+    ok &= asks_are(ob, {{9000, 800}, {9050, 700}});
+    return ok;
+}
+
+// Checks that re-centring keeps the time priority of the orders at a level.
+static bool test_queues()
+{
+    auto levels = ladder_config(8);
+    levels.order_queues = true;
+    order_book ob{"TEST", 0, 16, levels};
+    bool ok = true;
+    for (uint64_t id = 1; id <= 3; id++) {
+        ok &= ob.add(order{id, 10000, static_cast<uint32_t>(id * 100), side_type::buy, id}) == status::ok;
+    }
+    ok &= ob.add(order{4, 12000, 100, side_type::buy, 4}) == status::ok;
+    std::vector<uint64_t> ids;
+    ob.for_each_queued(side_type::buy, 1, [&ids](const order& o) {
+        ids.push_back(o.id);
+    });
+    ok &= ids == std::vector<uint64_t>{1, 2, 3};
+    queue_position pos;
+    ok &= ob.position(3, pos) == status::ok && pos.orders == 2 && pos.quantity == 300;
+    return report("order queues", ok);
+}
+
+static bool same_depth(const order_book& a, const order_book& b)
+{
+    constexpr size_t levels = 16;
+    depth_level a_bids[levels], a_asks[levels], b_bids[levels], b_asks[levels];
+    a.depth(a_bids, a_asks, levels);
+    b.depth(b_bids, b_asks, levels);
+    bool ok = a.bid_levels() == b.bid_levels() && a.ask_levels() == b.ask_levels();
+    ok &= a.order_count() == b.order_count();
+    for (size_t i = 0; i < levels; i++) {
+        ok &= a_bids[i].price == b_bids[i].price && a_bids[i].size == b_bids[i].size;
+        ok &= a_asks[i].price == b_asks[i].price && a_asks[i].size == b_asks[i].size;
+    }
+    return ok;
+}
+
+// Prices drift so that the window is re-centred often, and some prices are
+// off the tick grid.
+static bool test_random(order_book& ladder, const char* name)
+{
+    order_book tree{"TEST", 0, 1024};
+    std::mt19937 rng{7};
+    std::vector<uint64_t> ids;
+    std::unordered_map<uint64_t, uint32_t> quantities;
+    uint64_t mid = 100000;
+    bool ok = true;
+    for (uint64_t id = 1; id < 50000 && ok; id++) {
+        mid += (rng() % 5) * 100;
+        mid -= (rng() % 5) * 100;
+        unsigned action = rng() % 4;
+        if (action < 2 || ids.empty()) {
+            side_type side = rng() % 2 ? side_type::buy : side_type::sell;
+            uint64_t offset = (rng() % 20) * 100 + (rng() % 10 ? 0 : 50);
+            uint32_t price = side == side_type::buy ? mid - offset - 100 : mid + offset + 100;
+            uint32_t quantity = 1 + rng() % 100;
+            ok &= ladder.add(order{id, price, quantity, side, id}) == status::ok;
+            ok &= tree.add(order{id, price, quantity, side, id}) == status::ok;
+            ids.push_back(id);
+            quantities[id] = quantity;
+        } else {
+            size_t idx = rng() % ids.size();
+            uint64_t order_id = ids[idx];
+            if (action == 2) {
+                ok &= ladder.remove(order_id) == status::ok;
+                ok &= tree.remove(order_id) == status::ok;
+                ids[idx] = ids.back();
+                ids.pop_back();
+            } else {
+                ok &= ladder.cancel(order_id, 1) == status::ok;
+                ok &= tree.cancel(order_id, 1) == status::ok;
+                if (!--quantities[order_id]) {
+                    ids[idx] = ids.back();
+                    ids.pop_back();
+                }
+            }
+        }
+        ok &= same_depth(ladder, tree);
+    }
+    return report(name, ok);
+}
+
+// Executions and cancellations of more than the quantity of an order fail
+// without changing the book.
+static bool test_invalid_quantity()
+{
+    order_book ob{"TEST", 0, 16};
+    bool ok = ob.add(order{1, 10000, 100, side_type::buy, 1}) == status::ok;
+    uint64_t price = 0;
+    side_type side = side_type::sell;
+    ok &= ob.cancel(1, 101) == status::invalid_quantity;
+    ok &= ob.execute(1, 200, price, side) == status::invalid_quantity;
+    ok &= price == 0 && side == side_type::sell;
+    ok &= bids_are(ob, {{10000, 100}});
+    bool thrown = false;
+    try {
+        ob.execute_at(0, 101);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ok &= thrown && bids_are(ob, {{10000, 100}});
+    ok &= ob.execute(1, 100, price, side) == status::ok;
+    ok &= price == 10000 && side == side_type::buy && ob.order_count() == 0;
+    return report("invalid quantity", ok);
+}
+
+// Every update to a level among the top level_config::depth levels, and no
+// other update, changes the copy of the top levels.
+static bool test_depth_changed(level_config levels, const char* name)
+{
+    constexpr size_t depth = 4;
+    levels.depth = depth;
+    order_book ob{"TEST", 0, 1024, levels};
+    std::mt19937 rng{11};
+    std::vector<uint64_t> ids;
+    bool ok = true;
+    size_t changes = 0;
+    for (uint64_t id = 1; id < 20000 && ok; id++) {
+        depth_level bids[depth], asks[depth];
+        ob.depth(bids, asks, depth);
+        ob.clear_depth_changed();
+        if (rng() % 2 || ids.empty()) {
+            side_type side = rng() % 2 ? side_type::buy : side_type::sell;
+            uint32_t offset = (rng() % 12) * 100;
+            uint32_t price = side == side_type::buy ? 100000 - offset : 100100 + offset;
+            ok &= ob.add(order{id, price, 1 + static_cast<uint32_t>(rng() % 3), side, id}) == status::ok;
+            ids.push_back(id);
+        } else {
+            size_t idx = rng() % ids.size();
+            ok &= ob.remove(ids[idx]) == status::ok;
+            ids[idx] = ids.back();
+            ids.pop_back();
+        }
+        depth_level new_bids[depth], new_asks[depth];
+        ob.depth(new_bids, new_asks, depth);
+        bool changed = false;
+        for (size_t i = 0; i < depth; i++) {
+            changed |= bids[i].price != new_bids[i].price || bids[i].size != new_bids[i].size;
+            changed |= asks[i].price != new_asks[i].price || asks[i].size != new_asks[i].size;
+        }
+        ok &= ob.depth_changed() == changed;
+        changes += changed;
+    }
+    // Both kinds of update must have been common.
+    ok &= changes > 2000 && changes < 18000;
+    return report(name, ok);
+}
+
+int main()
+{
+    bool ok = true;
+    {
+        order_book ob{"TEST", 0, 16, ladder_config(8)};
+        ok &= report("recentre", test_recentre(ob));
+    }
+    {
+        order_pool pool;
+        order_book ob{"TEST", 0, pool, ladder_config(8)};
+        ok &= report("recentre, shared pool", test_recentre(ob));
+    }
+    {
+        order_book ob{"TEST", 0, 16, ladder_config(8)};
+        ok &= report("tree fallback", test_fallback(ob));
+    }
+    {
+        order_book ob{"TEST", 0, 16, ladder_config(0)};
+        ok &= report("tree fallback, empty window", test_fallback(ob));
+    }
+    ok &= test_queues();
+    {
+        order_book ob{"TEST", 0, 1024, ladder_config(32)};
+        ok &= test_random(ob, "random");
+    }
+    {
+        order_pool pool;
+        order_book ob{"TEST", 0, pool, ladder_config(32)};
+        ok &= test_random(ob, "random, shared pool");
+    }
+    ok &= test_invalid_quantity();
+    ok &= test_depth_changed(level_config{}, "depth changed");
+    ok &= test_depth_changed(ladder_config(8), "depth changed, ladder");
+    return ok ? 0 : 1;
+}
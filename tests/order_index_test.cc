@@ -0,0 +1,179 @@
+// Checks the order index: Robin Hood placement on insertion, backward-shift
+// deletion, probe sequences that wrap around the end of the table, growth,
+// and rejection of duplicate order IDs. A random workload is finally checked
+// against std::unordered_map.
+
+#include <helix/order_index.hh>
+
+#include <unordered_map>
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace helix;
+
+using index_type = core::order_index<uint64_t>;
+
+// Returns the slot of an order relative to the slot of another.
+static std::ptrdiff_t offset(index_type& index, uint64_t id, uint64_t base)
+{
+    return index.find(id) - index.find(base);
+}
+
+static bool contains(index_type& index, const std::vector<uint64_t>& ids)
+{
+    for (auto id : ids) {
+        auto* e = index.find(id);
+        if (!e || e->value != id * 10) {
+            return false;
+        }
+    }
+    return index.size() == ids.size();
+}
+
+static bool report(const char* name, bool ok)
+{
+    std::cout << name << ": " << (ok ? "OK" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Orders 3, 19 and 35 share home slot 3 of a 16-entry table. Order 4, whose
+// home slot is 4, is pushed past 35 because 35 is further from home.
+static bool test_insert()
+{
+    index_type index;
+    bool ok = index.capacity() == 16;
+    for (uint64_t id : {3, 19, 4, 35}) {
+        ok &= index.insert(id, id * 10);
+    }
+    ok &= contains(index, {3, 19, 4, 35});
+    ok &= offset(index, 19, 3) == 1;
+    ok &= offset(index, 35, 3) == 2;
+    ok &= offset(index, 4, 3) == 3;
+    ok &= index.find(20) == nullptr;
+    ok &= index.find(51) == nullptr;
+    return report("insert", ok);
+}
+
+// Removing 19 shifts 35 and 4 one slot back. Removing 3 then shifts both
+// again, after which 4 is in its home slot.
+static bool test_erase()
+{
+    index_type index;
+    for (uint64_t id : {3, 19, 4, 35}) {
+        index.insert(id, id * 10);
+    }
+    bool ok = index.erase(19);
+    ok &= !index.erase(19);
+    ok &= contains(index, {3, 4, 35});
+    ok &= offset(index, 35, 3) == 1;
+    ok &= offset(index, 4, 3) == 2;
+    ok &= index.erase(3);
+    ok &= contains(index, {4, 35});
+    ok &= offset(index, 4, 35) == 1;
+    return report("erase", ok);
+}
+
+// Orders 15, 31 and 47 share the last slot, so 31 and 47 wrap around to the
+// start of the table and push order 0 out of its home slot.
+static bool test_wrap_around()
+{
+    index_type index;
+    for (uint64_t id : {15, 31, 47, 0}) {
+        index.insert(id, id * 10);
+    }
+    bool ok = contains(index, {15, 31, 47, 0});
+    ok &= offset(index, 31, 15) == -15;
+    ok &= offset(index, 47, 31) == 1;
+    ok &= offset(index, 0, 47) == 1;
+    ok &= index.find(63) == nullptr;
+    ok &= index.erase(15);
+    ok &= contains(index, {31, 47, 0});
+    ok &= offset(index, 47, 31) == -15;
+    ok &= offset(index, 0, 47) == 1;
+    return report("wrap-around", ok);
+}
+
+// The table doubles before it is more than three quarters full, and
+// reserve() sizes it for twice the expected number of orders.
+static bool test_rehash()
+{
+    index_type index;
+    std::vector<uint64_t> ids;
+    bool ok = true;
+    for (uint64_t id = 0; id < 12; id++) {
+        ok &= index.insert(id * 16, id * 160);
+        ids.push_back(id * 16);
+    }
+    ok &= index.capacity() == 16;
+    ok &= index.insert(1, 10);
+    ids.push_back(1);
+    ok &= index.capacity() == 32;
+    ok &= contains(index, ids);
+    index.reserve(100);
+    ok &= index.capacity() == 256;
+    ok &= contains(index, ids);
+    index.reserve(10);
+    ok &= index.capacity() == 256;
+    return report("rehash", ok);
+}
+
+static bool test_duplicate()
+{
+    index_type index;
+    bool ok = index.insert(7, 70);
+    ok &= !index.insert(7, 71);
+    ok &= index.size() == 1;
+    ok &= index.find(7)->value == 70;
+    // A duplicate that is displaced from its home slot is found as well.
+    ok &= index.insert(23, 230);
+    ok &= !index.insert(23, 231);
+    ok &= index.size() == 2;
+    ok &= index.find(23)->value == 230;
+    return report("duplicate", ok);
+}
+
+static bool test_random()
+{
+    std::mt19937_64 rng{42};
+    // A narrow ID range makes collisions, duplicates and misses common.
+    std::uniform_int_distribution<uint64_t> id_dist{0, 20000};
+    index_type index{1000};
+    std::unordered_map<uint64_t, uint64_t> expected;
+    bool ok = true;
+    for (int i = 0; i < 200000 && ok; i++) {
+        uint64_t id = id_dist(rng);
+        if (rng() % 3) {
+            ok &= index.insert(id, i) == expected.emplace(id, i).second;
+        } else {
+            ok &= index.erase(id) == (expected.erase(id) == 1);
+        }
+    }
+    ok &= index.size() == expected.size();
+    for (auto&& kv : expected) {
+        auto* e = index.find(kv.first);
+        ok &= e && e->value == kv.second;
+    }
+    size_t visited = 0;
+    index.for_each([&](uint64_t id, uint64_t value) {
+        auto it = expected.find(id);
+        ok &= it != expected.end() && it->second == value;
+        visited++;
+    });
+    ok &= visited == expected.size();
+    return report("random", ok);
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= test_insert();
+    ok &= test_erase();
+    ok &= test_wrap_around();
+    ok &= test_rehash();
+    ok &= test_duplicate();
+    ok &= test_random();
+    return ok ? 0 : 1;
+}
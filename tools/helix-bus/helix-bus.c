@@ -0,0 +1,227 @@
+#include <helix-c/helix.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <uv.h>
+
+static const char *program;
+
+static helix_udp_receiver_t rx;
+
+static helix_bus_t bus;
+
+#define MAX_SYMBOLS 1024
+
+struct config {
+	const char *symbols[MAX_SYMBOLS];
+	size_t nr_symbols;
+	size_t max_orders;
+	const char *name;
+	size_t capacity;
+	size_t depth;
+	const char *proto;
+	const char *multicast_addr;
+	int multicast_port;
+};
+
+static void process_ob_event(helix_session_t session, helix_order_book_t ob)
+{
+	if (helix_bus_publish_order_book(bus, ob) < 0) {
+		fprintf(stderr, "error: %s: %s\n", helix_order_book_symbol(ob), strerror(errno));
+		exit(1);
+	}
+}
+
+static void process_trade_event(helix_session_t session, helix_trade_t trade)
+{
+	if (helix_bus_publish_trade(bus, trade) < 0) {
+		fprintf(stderr, "error: %s: %s\n", helix_trade_symbol(trade), strerror(errno));
+		exit(1);
+	}
+}
+
+static void libuv_error(const char *s, int err)
+{
+	fprintf(stderr, "error: %s: %s (%s)\n", s, uv_strerror(err), uv_err_name(err));
+	exit(1);
+}
+
+static void recv_packets(uv_poll_t* handle, int status, int events)
+{
+	if (status < 0) {
+		libuv_error("uv_poll", status);
+	}
+	while (helix_udp_receiver_process(rx, handle->data, 0) > 0)
+		;
+}
+
+static void usage(void)
+{
+	fprintf(stdout,
+		"usage: %s [options]\n"
+		"  options:\n"
+		"    -n, --name name              Name of the market data bus to publish to.\n"
+		"    -s, --symbol symbol          Ticker symbol to publish (can be specified multiple times).\n"
+		"    -m, --max-orders number      Maximum number of orders per symbol (for pre-allocation).\n"
+		"    -c, --capacity number        Number of events in the bus (default: 65536).\n"
+		"    -d, --depth number           Number of price levels per side to publish (default: 5).\n"
+		"    -P, --proto proto            Market data protocol listen to.\n"
+		"    -a, --multicast-addr addr    UDP multicast address to listen to.\n"
+		"    -p, --multicast-port port    UDP multicast port to listen to.\n"
+		"    -h, --help                   display this help and exit\n",
+		program);
+	exit(1);
+}
+
+static struct option bus_options[] = {
+	{"name",            required_argument, 0, 'n'},
+	{"symbol",          required_argument, 0, 's'},
+	{"max-orders",      required_argument, 0, 'm'},
+	{"capacity",        required_argument, 0, 'c'},
+	{"depth",           required_argument, 0, 'd'},
+	{"proto",           required_argument, 0, 'P'},
+	{"multicast-addr",  required_argument, 0, 'a'},
+	{"multicast-port",  required_argument, 0, 'p'},
+	{"help",            no_argument,       0, 'h'},
+	{0, 0, 0, 0}
+};
+
+static void parse_options(struct config *cfg, int argc, char *argv[])
+{
+	for (;;) {
+		int opt_idx = 0;
+		int c;
+
+		c = getopt_long(argc, argv, "n:s:m:c:d:P:a:p:h", bus_options, &opt_idx);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'n':
+			cfg->name = optarg;
+			break;
+		case 's':
+			if (cfg->nr_symbols == MAX_SYMBOLS) {
+				fprintf(stderr, "error: too many symbols, the maximum is %d\n", MAX_SYMBOLS);
+				exit(1);
+			}
+			cfg->symbols[cfg->nr_symbols++] = optarg;
+			break;
+		case 'm':
+			cfg->max_orders = strtol(optarg, NULL, 10);
+			break;
+		case 'c':
+			cfg->capacity = strtol(optarg, NULL, 10);
+			break;
+		case 'd':
+			cfg->depth = strtol(optarg, NULL, 10);
+			break;
+		case 'P':
+			cfg->proto = optarg;
+			break;
+		case 'a':
+			cfg->multicast_addr = optarg;
+			break;
+		case 'p':
+			cfg->multicast_port = strtol(optarg, NULL, 10);
+			break;
+		case 'h':
+			usage();
+		default:
+			usage();
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	helix_udp_config_t rx_cfg = {};
+	helix_session_t session;
+	helix_protocol_t proto;
+	struct config cfg = {
+		.capacity = 64 * 1024,
+		.depth = 5,
+	};
+	uv_poll_t poll;
+	int err;
+
+	program = basename(argv[0]);
+
+	parse_options(&cfg, argc, argv);
+
+	if (!cfg.name) {
+		fprintf(stderr, "error: bus name is not specified. Use the '-n' option to specify it.\n");
+		exit(1);
+	}
+
+	if (!cfg.nr_symbols) {
+		fprintf(stderr, "error: symbol is not specified. Use the '-s' option to specify it.\n");
+		exit(1);
+	}
+
+	if (!cfg.proto) {
+		fprintf(stderr, "error: multicast protocol is not specified. Use the '-P' option to specify it.\n");
+		exit(1);
+	}
+
+	if (!cfg.multicast_addr) {
+		fprintf(stderr, "error: multicast address is not specified. Use the '-a' option to specify it.\n");
+		exit(1);
+	}
+
+	if (!cfg.multicast_port) {
+		fprintf(stderr, "error: multicast port is not specified. Use the '-p' option to specify it.\n");
+		exit(1);
+	}
+
+	proto = helix_protocol_lookup(cfg.proto);
+	if (!proto) {
+		fprintf(stderr, "error: protocol '%s' is not supported\n", cfg.proto);
+		exit(1);
+	}
+
+	bus = helix_bus_create(cfg.name, cfg.capacity, cfg.nr_symbols, cfg.depth);
+	if (!bus) {
+		fprintf(stderr, "error: %s: %s\n", cfg.name, strerror(errno));
+		exit(1);
+	}
+
+	session = helix_session_create(proto, process_ob_event, process_trade_event, NULL);
+	if (!session) {
+		fprintf(stderr, "error: unable to create new session\n");
+		exit(1);
+	}
+
+	for (size_t i = 0; i < cfg.nr_symbols; i++) {
+		helix_session_subscribe_depth(session, cfg.symbols[i], cfg.max_orders, cfg.depth);
+	}
+
+	rx_cfg.multicast_addr = cfg.multicast_addr;
+	rx_cfg.port = cfg.multicast_port;
+
+	rx = helix_udp_receiver_open(&rx_cfg);
+	if (!rx) {
+		fprintf(stderr, "error: %s:%d: %s\n", cfg.multicast_addr, cfg.multicast_port, strerror(errno));
+		exit(1);
+	}
+
+	err = uv_poll_init(uv_default_loop(), &poll, helix_udp_receiver_fd(rx));
+	if (err) {
+		libuv_error("uv_poll_init", err);
+	}
+	poll.data = session;
+
+	err = uv_poll_start(&poll, UV_READABLE, recv_packets);
+	if (err) {
+		libuv_error("uv_poll_start", err);
+	}
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	helix_bus_destroy(bus);
+
+	return 0;
+}
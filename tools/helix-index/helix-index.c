@@ -0,0 +1,106 @@
+#include <helix-c/helix.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+static const char *program;
+
+struct config {
+	const char *input;
+	const char *output;
+	uint64_t interval_msec;
+};
+
+static void usage(void)
+{
+	fprintf(stdout,
+		"usage: %s [options]\n"
+		"  options:\n"
+		"    -i, --input filename         NASDAQ TotalView-ITCH 5.0 BinaryFILE to index.\n"
+		"    -o, --output filename        Index filename (default: input filename with '.idx' appended).\n"
+		"    -t, --interval msec          Interval between time checkpoints (default 1000).\n"
+		"    -h, --help                   display this help and exit\n",
+		program);
+	exit(1);
+}
+
+static struct option index_options[] = {
+	{"input",           required_argument, 0, 'i'},
+	{"output",          required_argument, 0, 'o'},
+	{"interval",        required_argument, 0, 't'},
+	{"help",            no_argument,       0, 'h'},
+	{0, 0, 0, 0}
+};
+
+static void parse_options(struct config *cfg, int argc, char *argv[])
+{
+	cfg->interval_msec = 1000;
+
+	for (;;) {
+		int opt_idx = 0;
+		int c;
+
+		c = getopt_long(argc, argv, "i:o:t:h", index_options, &opt_idx);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'i':
+			cfg->input = optarg;
+			break;
+		case 'o':
+			cfg->output = optarg;
+			break;
+		case 't':
+			cfg->interval_msec = strtoull(optarg, NULL, 10);
+			break;
+		case 'h':
+			usage();
+		default:
+			usage();
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct config cfg = {};
+	char *output = NULL;
+
+	program = basename(argv[0]);
+
+	parse_options(&cfg, argc, argv);
+
+	if (!cfg.input) {
+		fprintf(stderr, "error: input file is not specified. Use the '-i' option to specify it.\n");
+		exit(1);
+	}
+
+	if (!cfg.interval_msec) {
+		fprintf(stderr, "error: invalid checkpoint interval: 0\n");
+		exit(1);
+	}
+
+	if (!cfg.output) {
+		output = malloc(strlen(cfg.input) + strlen(".idx") + 1);
+		if (!output) {
+			fprintf(stderr, "error: %s\n", strerror(errno));
+			exit(1);
+		}
+		strcpy(output, cfg.input);
+		strcat(output, ".idx");
+		cfg.output = output;
+	}
+
+	if (helix_index_build(cfg.input, cfg.output, cfg.interval_msec * 1000000) < 0) {
+		fprintf(stderr, "error: %s: %s\n", cfg.input, strerror(errno));
+		exit(1);
+	}
+
+	free(output);
+
+	return 0;
+}
@@ -31,6 +31,8 @@ using namespace std;
 
 static const char *program;
 
+static helix_udp_receiver_t rx;
+
 struct config {
 	const char *symbol;
 	size_t max_orders;
@@ -108,16 +110,21 @@ public:
 private:
 	features extract(helix_order_book_t ob) {
 		features result{};
+		helix_price_level_t bids[nr_levels];
+		helix_price_level_t asks[nr_levels];
+		double midprices[nr_levels];
 		double sum_bid_price = 0.0;
 		double sum_ask_price = 0.0;
 		double sum_bid_size = 0.0;
 		double sum_ask_size = 0.0;
+		helix_order_book_depth(ob, bids, asks, nr_levels);
 		for (size_t i = 0; i < nr_levels; i++) {
-			auto bid_price = helix_order_book_bid_price(ob, i) / 10000.0;
-			auto ask_price = helix_order_book_ask_price(ob, i) / 10000.0;
-			auto bid_size = helix_order_book_bid_size(ob, i);
-			auto ask_size = helix_order_book_ask_size(ob, i);
-			auto midprice = helix_order_book_midprice(ob, i) / 10000.0;
+			auto bid_price = bids[i].price / 10000.0;
+			auto ask_price = asks[i].price / 10000.0;
+			auto bid_size = bids[i].size;
+			auto ask_size = asks[i].size;
+			auto midprice = ((bids[i].price + asks[i].price) / 2) / 10000.0;
+			midprices[i] = midprice;
 			// Price and volume (n levels):
 			result.add(ask_price);
 			result.add(ask_size);
@@ -139,10 +146,10 @@ private:
 		result.add(sum_ask_size / nr_levels);
 		for (size_t i = 1; i < nr_levels; i++) {
 			// Price differences:
-			auto bid0 = helix_order_book_midprice(ob, i-1) / 10000.0;
-			auto bid1 = helix_order_book_midprice(ob, i) / 10000.0;
-			auto ask0 = helix_order_book_midprice(ob, i-1) / 10000.0;
-			auto ask1 = helix_order_book_midprice(ob, i) / 10000.0;
+			auto bid0 = midprices[i-1];
+			auto bid1 = midprices[i];
+			auto ask0 = midprices[i-1];
+			auto ask1 = midprices[i];
 			result.add(abs(ask1-ask0));
 			result.add(abs(bid1-bid0));
 		}
@@ -168,14 +175,6 @@ private:
 	}
 };
 
-static void alloc_packet(uv_handle_t* handle, size_t size, uv_buf_t* buf)
-{
-	static char rx_buffer[65536];
-
-	buf->base = rx_buffer;
-	buf->len = sizeof(rx_buffer);
-}
-
 struct svm_fmt_ops *fmt_ops;
 
 static void process_ob_event(helix_session_t session, helix_order_book_t ob)
@@ -189,19 +188,21 @@ static void process_trade_event(helix_session_t session, helix_trade_t trade)
 {
 }
 
-static void recv_packet(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
-{
-	if (nread > 0) {
-		helix_session_process_packet(reinterpret_cast<helix_session_t>(handle->data), buf->base, nread);
-	}
-}
-
 static void libuv_error(const char *s, int err)
 {
 	fprintf(stderr, "error: %s: %s (%s)\n", s, uv_strerror(err), uv_err_name(err));
 	exit(1);
 }
 
+static void recv_packets(uv_poll_t* handle, int status, int events)
+{
+	if (status < 0) {
+		libuv_error("uv_poll", status);
+	}
+	while (helix_udp_receiver_process(rx, reinterpret_cast<helix_session_t>(handle->data), 0) > 0)
+		;
+}
+
 static void usage(void)
 {
 	fprintf(stdout,
@@ -274,13 +275,13 @@ static void parse_options(struct config *cfg, int argc, char *argv[])
 int main(int argc, char *argv[])
 {
 	unique_ptr<svm_session> svm;
+	helix_udp_config_t rx_cfg = {};
 	helix_session_t session;
-	struct sockaddr_in addr;
 	helix_protocol_t proto;
 	struct config cfg = {};
 	struct stat input_st;
 	void *input_mmap;
-	uv_udp_t socket;
+	uv_poll_t poll;
 	ostream* output;
 	int input_fd;
 	int err;
@@ -374,30 +375,24 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 
-		err = uv_udp_init(uv_default_loop(), &socket);
-		if (err) {
-			libuv_error("uv_udp_init", err);
-		}
-		socket.data = session;
-
-		err = uv_ip4_addr("0.0.0.0", cfg.multicast_port, &addr);
-		if (err) {
-			libuv_error("uv_ip4_addr", err);
-		}
+		rx_cfg.multicast_addr = cfg.multicast_addr;
+		rx_cfg.port = cfg.multicast_port;
 
-		err = uv_udp_bind(&socket, (const struct sockaddr *)&addr, UV_UDP_REUSEADDR);
-		if (err) {
-			libuv_error("uv_udp_bind", err);
+		rx = helix_udp_receiver_open(&rx_cfg);
+		if (!rx) {
+			fprintf(stderr, "error: %s:%d: %s\n", cfg.multicast_addr, cfg.multicast_port, strerror(errno));
+			exit(1);
 		}
 
-		err = uv_udp_set_membership(&socket, cfg.multicast_addr, NULL, UV_JOIN_GROUP);
+		err = uv_poll_init(uv_default_loop(), &poll, helix_udp_receiver_fd(rx));
 		if (err) {
-			libuv_error("uv_udp_set_membership", err);
+			libuv_error("uv_poll_init", err);
 		}
+		poll.data = session;
 
-		err = uv_udp_recv_start(&socket, alloc_packet, recv_packet);
+		err = uv_poll_start(&poll, UV_READABLE, recv_packets);
 		if (err) {
-			libuv_error("uv_udp_recv_start", err);
+			libuv_error("uv_poll_start", err);
 		}
 
 		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
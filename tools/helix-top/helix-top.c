@@ -3,11 +3,15 @@
 #include <getopt.h>
 #include <libgen.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
+#include <errno.h>
 #include <uv.h>
 
 static const char *program;
 
+static helix_udp_receiver_t rx;
+
 struct config {
 	const char *symbol;
 	size_t max_orders;
@@ -16,16 +20,69 @@ struct config {
 	int multicast_port;
 };
 
-static void alloc_packet(uv_handle_t* handle, size_t size, uv_buf_t* buf)
+#define TOP_LEVELS 5
+
+/* Rows of the latency table: wire-to-callback latency followed by the
+   processing time of message types 'A' to 'Z'. */
+#define LATENCY_ROWS (1 + 'Z' - 'A' + 1)
+
+struct latency_row {
+	char name[8];
+	helix_latency_t latency;
+};
+
+static int latency_enabled;
+static struct latency_row latency_rows[LATENCY_ROWS];
+static unsigned nr_latency_rows;
+
+static void print_latency(void)
+{
+	unsigned row = TOP_LEVELS + 2;
+
+	if (!latency_enabled)
+		return;
+
+	move(row++, 0);
+	printw("%-8s %10s %10s %10s %10s %10s\n", "latency", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+	for (unsigned i = 0; i < nr_latency_rows; i++) {
+		struct latency_row *r = &latency_rows[i];
+
+		move(row++, 0);
+		printw("%-8s %10lu %10lu %10lu %10lu %10lu\n",
+			r->name,
+			r->latency.count,
+			r->latency.p50,
+			r->latency.p99,
+			r->latency.p999,
+			r->latency.max
+			);
+	}
+}
+
+static void update_latency(uv_timer_t *timer)
 {
-	static char rx_buffer[65536];
+	helix_session_t session = timer->data;
+	unsigned nr = 0;
 
-	buf->base = rx_buffer;
-	buf->len  = sizeof(rx_buffer);
+	if (!helix_session_wire_latency(session, &latency_rows[nr].latency)) {
+		strcpy(latency_rows[nr].name, "wire");
+		nr++;
+	}
+	for (char type = 'A'; type <= 'Z'; type++) {
+		if (!helix_session_latency(session, type, &latency_rows[nr].latency)) {
+			snprintf(latency_rows[nr].name, sizeof(latency_rows[nr].name), "msg %c", type);
+			nr++;
+		}
+	}
+	nr_latency_rows = nr;
+	print_latency();
+	refresh();
 }
 
 static void print_top(helix_order_book_t ob)
 {
+	helix_price_level_t bids[TOP_LEVELS];
+	helix_price_level_t asks[TOP_LEVELS];
 	uint64_t timestamp = helix_order_book_timestamp(ob);
 	uint64_t timestamp_in_sec = timestamp / 1000;
 	uint64_t hours   = timestamp_in_sec / 60 / 60;
@@ -40,15 +97,17 @@ static void print_top(helix_order_book_t ob)
 			helix_order_book_symbol(ob),
 			hours, minutes, seconds, msecs
 			);
-		for (unsigned i = 0; i < 5; i++) {
+		helix_order_book_depth(ob, bids, asks, TOP_LEVELS);
+		for (unsigned i = 0; i < TOP_LEVELS; i++) {
 			move(i+1, 0);
 			printw("| %6lu  %.3f  %.3f  %-6lu |\n",
-				helix_order_book_bid_size(ob, i),
-				(double)helix_order_book_bid_price(ob, i)/10000.0,
-				(double)helix_order_book_ask_price(ob, i)/10000.0,
-				helix_order_book_ask_size(ob, i)
+				bids[i].size,
+				(double)bids[i].price/10000.0,
+				(double)asks[i].price/10000.0,
+				asks[i].size
 				);
 		}
+		print_latency();
 		refresh();
 	}
 }
@@ -62,19 +121,21 @@ static void process_trade_event(helix_session_t session, helix_trade_t trade)
 {
 }
 
-static void recv_packet(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
-{
-	if (nread > 0) {
-		helix_session_process_packet(handle->data, buf->base, nread);
-	}
-}
-
 static void libuv_error(const char *s, int err)
 {
 	fprintf(stderr, "error: %s: %s (%s)\n", s, uv_strerror(err), uv_err_name(err));
 	exit(1);
 }
 
+static void recv_packets(uv_poll_t* handle, int status, int events)
+{
+	if (status < 0) {
+		libuv_error("uv_poll", status);
+	}
+	while (helix_udp_receiver_process(rx, handle->data, 0) > 0)
+		;
+}
+
 static void usage(void)
 {
 	fprintf(stdout,
@@ -136,11 +197,13 @@ static void parse_options(struct config *cfg, int argc, char *argv[])
 
 int main(int argc, char *argv[])
 {
+	helix_udp_config_t rx_cfg = {};
 	helix_session_t session;
-	struct sockaddr_in addr;
 	helix_protocol_t proto;
+	helix_latency_t latency;
 	struct config cfg = {};
-	uv_udp_t socket;
+	uv_timer_t timer;
+	uv_poll_t poll;
 	int err;
 
 	program = basename(argv[0]);
@@ -179,32 +242,42 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	helix_session_subscribe(session, cfg.symbol, cfg.max_orders);
+	helix_session_subscribe_depth(session, cfg.symbol, cfg.max_orders, TOP_LEVELS);
 
-	err = uv_udp_init(uv_default_loop(), &socket);
-	if (err) {
-		libuv_error("uv_udp_init", err);
-	}
-	socket.data = session;
+	latency_enabled = helix_session_wire_latency(session, &latency) == 0 || errno != EOPNOTSUPP;
 
-	err = uv_ip4_addr("0.0.0.0", cfg.multicast_port, &addr);
-	if (err) {
-		libuv_error("uv_ip4_addr", err);
+	rx_cfg.multicast_addr = cfg.multicast_addr;
+	rx_cfg.port = cfg.multicast_port;
+	rx_cfg.timestamps = latency_enabled;
+
+	rx = helix_udp_receiver_open(&rx_cfg);
+	if (!rx) {
+		fprintf(stderr, "error: %s:%d: %s\n", cfg.multicast_addr, cfg.multicast_port, strerror(errno));
+		exit(1);
 	}
 
-	err = uv_udp_bind(&socket, (const struct sockaddr *)&addr, UV_UDP_REUSEADDR);
+	err = uv_poll_init(uv_default_loop(), &poll, helix_udp_receiver_fd(rx));
 	if (err) {
-		libuv_error("uv_udp_bind", err);
+		libuv_error("uv_poll_init", err);
 	}
+	poll.data = session;
 
-	err = uv_udp_set_membership(&socket, cfg.multicast_addr, NULL, UV_JOIN_GROUP);
+	err = uv_poll_start(&poll, UV_READABLE, recv_packets);
 	if (err) {
-		libuv_error("uv_udp_set_membership", err);
+		libuv_error("uv_poll_start", err);
 	}
 
-	err = uv_udp_recv_start(&socket, alloc_packet, recv_packet);
-	if (err) {
-		libuv_error("uv_udp_recv_start", err);
+	if (latency_enabled) {
+		err = uv_timer_init(uv_default_loop(), &timer);
+		if (err) {
+			libuv_error("uv_timer_init", err);
+		}
+		timer.data = session;
+
+		err = uv_timer_start(&timer, update_latency, 1000, 1000);
+		if (err) {
+			libuv_error("uv_timer_start", err);
+		}
 	}
 
 	initscr();
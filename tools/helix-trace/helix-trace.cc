@@ -1,4 +1,5 @@
 #include <helix-c/helix.h>
+#include <helix/nasdaq/itch50_messages.h>
 #include <sys/mman.h>
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
@@ -10,16 +11,32 @@
 #include <errno.h>
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
+#include <endian.h>
 #include <uv.h>
 
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 static const char *program;
 
+#define MAX_LINES 2
+
+static helix_udp_receiver_t rx[MAX_LINES];
+static uv_poll_t rx_poll[MAX_LINES];
+static size_t nr_lines;
+
 FILE* output;
 bool flush;
 
+/* Events are not traced while replay is before the start time.  */
+bool quiet;
+
+/* Serializes callbacks that are invoked from replay worker threads.  */
+pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+
 size_t max_price_levels	= 0;
 size_t max_order_count	= 0;
 uint64_t quotes			= 0;
@@ -32,12 +49,26 @@ double low				= +INFINITY;
 struct config {
 	std::vector<std::string> symbols;
 	size_t max_orders;
+	size_t depth;
 	const char *proto;
 	const char *multicast_addr;
+	const char *multicast_addr_b;
 	int multicast_port;
 	const char *format;
 	const char *input;
 	const char *output;
+	bool conflate;
+	size_t threads;
+	int busy_poll_usec;
+	const char *index;
+	uint64_t start;
+	uint64_t end;
+	const char *restore;
+	const char *save_snapshot;
+	bool paced;
+	double speed;
+	const char *mirror_addr;
+	int mirror_port;
 };
 
 struct trace_fmt_ops {
@@ -46,14 +77,6 @@ struct trace_fmt_ops {
 	void (*fmt_trade)(helix_session_t session, helix_trade_t trade);
 };
 
-static void alloc_packet(uv_handle_t* handle, size_t size, uv_buf_t* buf)
-{
-	static char rx_buffer[65536];
-
-	buf->base = rx_buffer;
-	buf->len  = sizeof(rx_buffer);
-}
-
 static void fmt_pretty_header(void)
 {
 }
@@ -144,10 +167,148 @@ struct trace_fmt_ops fmt_csv_ops = {
 	.fmt_trade	= fmt_csv_trade,
 };
 
+/*
+ * Binary output format.
+ *
+ * The output starts with a header and a table of the traced symbols, which
+ * is followed by fixed-width records, one for every order book update and
+ * trade, in little-endian byte order. Records refer to symbols by their
+ * index in the table and prices are integers in units of 1/price_scale,
+ * like in the C API, so records are written without any formatting.
+ */
+#define BIN_MAGIC		"HLXTRACE"
+#define BIN_VERSION		1
+#define BIN_PRICE_SCALE	10000
+#define BIN_SYMBOL_LEN	16
+#define BIN_BUFFER_SIZE	(4 * 1024 * 1024)
+
+struct bin_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	record_size;
+	uint32_t	price_scale;
+	uint32_t	symbol_count;
+	uint8_t		reserved[8];
+	/* Followed by symbol_count NUL-padded symbols of BIN_SYMBOL_LEN bytes.  */
+};
+
+struct bin_record {
+	uint64_t	timestamp;
+	uint32_t	bid_price;
+	uint32_t	bid_size;
+	uint32_t	ask_price;
+	uint32_t	ask_size;
+	uint32_t	last_price;
+	uint32_t	last_size;
+	uint16_t	symbol;
+	char		type;		/* 'Q' for order book updates, 'T' for trades */
+	char		last_sign;
+	uint8_t		reserved[4];
+};
+
+static_assert(sizeof(struct bin_header) == 32, "binary header layout");
+static_assert(sizeof(struct bin_record) == 40, "binary record layout");
+
+/* Traced symbols, in the order of the binary symbol table.  */
+static const std::vector<std::string> *trace_symbols;
+
+/* Maps the symbol strings of order books to their binary symbol index.  */
+static std::unordered_map<const char *, uint16_t> bin_symbol_cache;
+
+static void bin_write(const void *buf, size_t len)
+{
+	if (fwrite(buf, len, 1, output) != 1) {
+		fprintf(stderr, "error: %s\n", strerror(errno));
+		exit(1);
+	}
+}
+
+static uint16_t bin_symbol(const char *symbol)
+{
+	auto it = bin_symbol_cache.find(symbol);
+	if (it != bin_symbol_cache.end())
+		return it->second;
+
+	/* Order book symbols can be padded with spaces.  */
+	size_t len = strlen(symbol);
+	while (len > 0 && symbol[len - 1] == ' ')
+		len--;
+
+	uint16_t idx = 0;
+	while (idx < trace_symbols->size() && (*trace_symbols)[idx].compare(0, std::string::npos, symbol, len))
+		idx++;
+
+	bin_symbol_cache.emplace(symbol, idx);
+	return idx;
+}
+
+static void fmt_bin_header(void)
+{
+	struct bin_header h = {};
+
+	/* Records are only written out once the large buffer fills up.  */
+	setvbuf(output, NULL, _IOFBF, BIN_BUFFER_SIZE);
+
+	memcpy(h.magic, BIN_MAGIC, sizeof(h.magic));
+	h.version = htole32(BIN_VERSION);
+	h.record_size = htole32(sizeof(struct bin_record));
+	h.price_scale = htole32(BIN_PRICE_SCALE);
+	h.symbol_count = htole32(trace_symbols->size());
+	bin_write(&h, sizeof(h));
+
+	for (auto&& symbol : *trace_symbols) {
+		char name[BIN_SYMBOL_LEN] = {};
+
+		strncpy(name, symbol.c_str(), sizeof(name) - 1);
+		bin_write(name, sizeof(name));
+	}
+}
+
+static void fmt_bin_ob(helix_session_t session, helix_order_book_t ob)
+{
+	struct bin_record r = {};
+
+	if (helix_order_book_state(ob) != HELIX_TRADING_STATE_TRADING)
+		return;
+
+	r.timestamp = htole64(helix_order_book_timestamp(ob));
+	r.bid_price = htole32(helix_order_book_bid_price(ob, 0));
+	r.bid_size = htole32(helix_order_book_bid_size(ob, 0));
+	r.ask_price = htole32(helix_order_book_ask_price(ob, 0));
+	r.ask_size = htole32(helix_order_book_ask_size(ob, 0));
+	r.symbol = htole16(bin_symbol(helix_order_book_symbol(ob)));
+	r.type = 'Q';
+	bin_write(&r, sizeof(r));
+}
+
+static void fmt_bin_trade(helix_session_t session, helix_trade_t trade)
+{
+	struct bin_record r = {};
+
+	r.timestamp = htole64(helix_trade_timestamp(trade));
+	r.last_price = htole32(helix_trade_price(trade));
+	r.last_size = htole32(helix_trade_size(trade));
+	r.symbol = htole16(bin_symbol(helix_trade_symbol(trade)));
+	r.type = 'T';
+	r.last_sign = trade_sign(helix_trade_sign(trade));
+	bin_write(&r, sizeof(r));
+}
+
+struct trace_fmt_ops fmt_bin_ops = {
+	.fmt_header	= fmt_bin_header,
+	.fmt_ob		= fmt_bin_ob,
+	.fmt_trade	= fmt_bin_trade,
+};
+
 struct trace_fmt_ops *fmt_ops;
 
 static void process_ob_event(helix_session_t session, helix_order_book_t ob)
 {
+	if (quiet)
+		return;
+
+	pthread_mutex_lock(&event_lock);
+
 	size_t bid_levels = helix_order_book_bid_levels(ob);
 	size_t ask_levels = helix_order_book_ask_levels(ob);
 	size_t order_count = helix_order_book_order_count(ob);
@@ -158,10 +319,17 @@ static void process_ob_event(helix_session_t session, helix_order_book_t ob)
 	quotes++;
 
 	fmt_ops->fmt_ob(session, ob);
+
+	pthread_mutex_unlock(&event_lock);
 }
 
 static void process_trade_event(helix_session_t session, helix_trade_t trade)
 {
+	if (quiet)
+		return;
+
+	pthread_mutex_lock(&event_lock);
+
 	double trade_price = helix_trade_price(trade)/10000.0;
 	uint64_t trade_size = helix_trade_size(trade);
 	volume_shs += trade_size;
@@ -171,13 +339,8 @@ static void process_trade_event(helix_session_t session, helix_trade_t trade)
 	trades++;
 
 	fmt_ops->fmt_trade(session, trade);
-}
 
-static void recv_packet(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags)
-{
-	if (nread > 0) {
-		helix_session_process_packet(reinterpret_cast<helix_session_t>(handle->data), buf->base, nread);
-	}
+	pthread_mutex_unlock(&event_lock);
 }
 
 static void libuv_error(const char *s, int err)
@@ -186,6 +349,100 @@ static void libuv_error(const char *s, int err)
 	exit(1);
 }
 
+static void recv_packets(uv_poll_t* handle, int status, int events)
+{
+	if (status < 0) {
+		libuv_error("uv_poll", status);
+	}
+	size_t line = handle - rx_poll;
+	while (helix_udp_receiver_process(rx[line], reinterpret_cast<helix_session_t>(handle->data), 0) > 0)
+		;
+}
+
+/* Returns the timestamp of an ITCH 5.0 BinaryFILE record.  */
+static uint64_t record_timestamp(const char *record)
+{
+	auto *m = reinterpret_cast<const struct itch50_system_event *>(record + sizeof(uint16_t));
+
+	return be64toh((uint64_t)m->Timestamp << 16);
+}
+
+static size_t record_size(const char *record)
+{
+	return sizeof(uint16_t) + be16toh(*reinterpret_cast<const uint16_t *>(record));
+}
+
+/* Replays the records of the traced symbols using an input file index.  */
+static void replay_index(helix_session_t session, helix_index_t index, const char *input, struct config *cfg)
+{
+	std::vector<uint64_t> offsets;
+	uint64_t clock = 0;
+	uint64_t from = 0;
+
+	if (cfg->restore) {
+		clock = helix_session_clock(session);
+		from = helix_index_seek(index, clock);
+	}
+
+	for (auto&& symbol : cfg->symbols) {
+		const uint64_t *symbol_offsets;
+		size_t count = 0;
+		size_t n;
+
+		symbol_offsets = helix_index_symbol_offsets(index, symbol.c_str(), &count);
+		if (!symbol_offsets) {
+			fprintf(stderr, "warning: %s: symbol does not appear in input\n", symbol.c_str());
+			continue;
+		}
+		n = offsets.size();
+		offsets.insert(offsets.end(), std::lower_bound(symbol_offsets, symbol_offsets + count, from), symbol_offsets + count);
+		std::inplace_merge(offsets.begin(), offsets.begin() + n, offsets.end());
+	}
+
+	for (auto offset : offsets) {
+		const char *record = input + offset;
+		uint64_t timestamp = record_timestamp(record);
+
+		/* The snapshot already contains every message up to its clock.  */
+		if (cfg->restore && timestamp <= clock)
+			continue;
+		if (cfg->end && timestamp >= cfg->end)
+			break;
+
+		quiet = timestamp < cfg->start;
+
+		helix_session_process_packet(session, record, record_size(record));
+	}
+	quiet = false;
+}
+
+/* Parses a time of day in HH:MM:SS[.fraction] format to nanoseconds.  */
+static uint64_t parse_time(const char *s)
+{
+	unsigned int hours, minutes, seconds;
+	uint64_t nsec = 0;
+	int nr = 0;
+
+	if (sscanf(s, "%u:%u:%u%n", &hours, &minutes, &seconds, &nr) != 3 || minutes > 59 || seconds > 59) {
+		fprintf(stderr, "error: %s: invalid time, expected HH:MM:SS[.fraction]\n", s);
+		exit(1);
+	}
+	s += nr;
+	if (*s == '.') {
+		uint64_t scale = 100000000;
+
+		for (s++; *s >= '0' && *s <= '9'; s++) {
+			nsec += (*s - '0') * scale;
+			scale /= 10;
+		}
+	}
+	if (*s) {
+		fprintf(stderr, "error: %s: invalid time, expected HH:MM:SS[.fraction]\n", s);
+		exit(1);
+	}
+	return ((uint64_t)hours * 3600 + minutes * 60 + seconds) * 1000000000 + nsec;
+}
+
 static void usage(void)
 {
 	fprintf(stdout,
@@ -193,16 +450,33 @@ static void usage(void)
 		"  options:\n"
 		"    -s, --symbol symbol          Ticker symbol to listen to.\n"
 		"    -m, --max-orders number      Maximum number of orders per symbol (for pre-allocation).\n"
+		"    -d, --depth number           Number of top price levels whose changes are traced\n"
+		"          (default 1, 0 traces every order book update).\n"
 		"    -P, --proto proto            Market data protocol to listen to\n"
 		"          or read from. Supported values:\n"
 		"              nasdaq-nordic-moldudp-itch\n"
 		"              nasdaq-nordic-soupfile-itch\n"
 		"              nasdaq-binaryfile-itch50\n"
 		"    -a, --multicast-addr addr    UDP multicast address to listen to.\n"
+		"    -B, --multicast-addr-b addr  UDP multicast address of the redundant B feed line.\n"
 		"    -p, --multicast-port port    UDP multicast port to listen to.\n"
-		"    -i, --input filename         Input filename.\n"
+		"    -b, --busy-poll usec         Busy poll the multicast socket instead of waiting for it.\n"
+		"    -i, --input filename         Input filename, optionally gzip or zstd compressed.\n"
 		"    -o, --output filename        Output filename.\n"
-		"    -f, --format format          Output format (pretty, csv).\n"
+		"    -f, --format format          Output format (pretty, csv, binary).\n"
+		"    -c, --conflate               Conflate order book updates within a packet or timestamp.\n"
+		"    -t, --threads number         Number of threads to replay the input file on\n"
+		"          (nasdaq-binaryfile-itch50 only).\n"
+		"    -I, --index filename         Index of the input file built with helix-index.\n"
+		"          Only the records of the traced symbols are replayed.\n"
+		"    -S, --start time             Start tracing at time of day HH:MM:SS[.fraction] (requires an index).\n"
+		"    -E, --end time               Stop replay at time of day HH:MM:SS[.fraction] (requires an index).\n"
+		"    -r, --restore filename       Restore order book state from a snapshot before replay.\n"
+		"    -w, --save-snapshot filename Write a snapshot of order book state after replay.\n"
+		"    -x, --speed factor           Replay the input file at factor times the recorded rate\n"
+		"          (0 is as fast as possible).\n"
+		"    -M, --mirror-addr addr       Re-emit processed messages as MoldUDP to multicast address.\n"
+		"    -u, --mirror-port port       UDP multicast port to re-emit messages to.\n"
 		"    -h, --help                   display this help and exit\n",
 		program);
 	exit(1);
@@ -211,12 +485,25 @@ static void usage(void)
 static struct option trace_options[] = {
 	{"symbol",          required_argument, 0, 's'},
 	{"max-orders",      required_argument, 0, 'm'},
+	{"depth",           required_argument, 0, 'd'},
 	{"proto",           required_argument, 0, 'P'},
 	{"multicast-addr",  required_argument, 0, 'a'},
+	{"multicast-addr-b",required_argument, 0, 'B'},
 	{"multicast-port",  required_argument, 0, 'p'},
+	{"busy-poll",       required_argument, 0, 'b'},
 	{"input",           required_argument, 0, 'i'},
 	{"output",          required_argument, 0, 'o'},
 	{"format",          required_argument, 0, 'f'},
+	{"conflate",        no_argument,       0, 'c'},
+	{"threads",         required_argument, 0, 't'},
+	{"index",           required_argument, 0, 'I'},
+	{"start",           required_argument, 0, 'S'},
+	{"end",             required_argument, 0, 'E'},
+	{"restore",         required_argument, 0, 'r'},
+	{"save-snapshot",   required_argument, 0, 'w'},
+	{"speed",           required_argument, 0, 'x'},
+	{"mirror-addr",     required_argument, 0, 'M'},
+	{"mirror-port",     required_argument, 0, 'u'},
 	{"help",            no_argument,       0, 'h'},
 	{0, 0, 0, 0}
 };
@@ -224,12 +511,13 @@ static struct option trace_options[] = {
 static void parse_options(struct config *cfg, int argc, char *argv[])
 {
 	cfg->format = "pretty";
+	cfg->depth = 1;
 
 	for (;;) {
 		int opt_idx = 0;
 		int c;
 
-		c = getopt_long(argc, argv, "s:m:P:a:i:o:p:f:h", trace_options, &opt_idx);
+		c = getopt_long(argc, argv, "s:m:d:P:a:B:i:o:p:b:f:ct:I:S:E:r:w:x:M:u:h", trace_options, &opt_idx);
 		if (c == -1)
 			break;
 
@@ -240,12 +528,18 @@ static void parse_options(struct config *cfg, int argc, char *argv[])
 		case 'm':
 			cfg->max_orders = strtol(optarg, NULL, 10);
 			break;
+		case 'd':
+			cfg->depth = strtol(optarg, NULL, 10);
+			break;
 		case 'P':
 			cfg->proto = optarg;
 			break;
 		case 'a':
 			cfg->multicast_addr = optarg;
 			break;
+		case 'B':
+			cfg->multicast_addr_b = optarg;
+			break;
 		case 'i':
 			cfg->input = optarg;
 			break;
@@ -255,9 +549,43 @@ static void parse_options(struct config *cfg, int argc, char *argv[])
 		case 'p':
 			cfg->multicast_port = strtol(optarg, NULL, 10);
 			break;
+		case 'b':
+			cfg->busy_poll_usec = strtol(optarg, NULL, 10);
+			break;
 		case 'f':
 			cfg->format = optarg;
 			break;
+		case 'c':
+			cfg->conflate = true;
+			break;
+		case 't':
+			cfg->threads = strtol(optarg, NULL, 10);
+			break;
+		case 'I':
+			cfg->index = optarg;
+			break;
+		case 'S':
+			cfg->start = parse_time(optarg);
+			break;
+		case 'E':
+			cfg->end = parse_time(optarg);
+			break;
+		case 'r':
+			cfg->restore = optarg;
+			break;
+		case 'w':
+			cfg->save_snapshot = optarg;
+			break;
+		case 'x':
+			cfg->paced = true;
+			cfg->speed = strtod(optarg, NULL);
+			break;
+		case 'M':
+			cfg->mirror_addr = optarg;
+			break;
+		case 'u':
+			cfg->mirror_port = strtol(optarg, NULL, 10);
+			break;
 		case 'h':
 			usage();
 		default:
@@ -268,13 +596,13 @@ static void parse_options(struct config *cfg, int argc, char *argv[])
 
 int main(int argc, char *argv[])
 {
+	const char *line_addrs[MAX_LINES];
+	helix_moldudp_sender_t mirror = NULL;
 	helix_session_t session;
-	struct sockaddr_in addr;
 	helix_protocol_t proto;
 	struct config cfg = {};
 	struct stat input_st;
 	void *input_mmap;
-	uv_udp_t socket;
 	int input_fd;
 	int err;
 
@@ -296,6 +624,9 @@ int main(int argc, char *argv[])
 		fmt_ops = &fmt_pretty_ops;
 	} else if (!strcmp(cfg.format, "csv")) {
 		fmt_ops = &fmt_csv_ops;
+	} else if (!strcmp(cfg.format, "binary")) {
+		fmt_ops = &fmt_bin_ops;
+		trace_symbols = &cfg.symbols;
 	} else {
 		fprintf(stderr, "error: %s: unsupported format\n", cfg.format);
 		exit(1);
@@ -319,19 +650,92 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	session = helix_session_create(proto, process_ob_event, process_trade_event, NULL);
+	if (cfg.threads > 1) {
+		if (!cfg.input) {
+			fprintf(stderr, "error: multi-threaded replay requires an input file. Use the '-i' option to specify it.\n");
+			exit(1);
+		}
+		session = helix_session_create_sharded(proto, cfg.threads, process_ob_event, process_trade_event, NULL);
+	} else {
+		session = helix_session_create(proto, process_ob_event, process_trade_event, NULL);
+	}
 	if (!session) {
 		fprintf(stderr, "error: unable to create new session\n");
 		exit(1);
 	}
 
+	helix_session_set_conflation(session, cfg.conflate);
+
 	for (auto&& symbol : cfg.symbols) {
-		helix_session_subscribe(session, symbol.c_str(), cfg.max_orders);
+		helix_session_subscribe_depth(session, symbol.c_str(), cfg.max_orders, cfg.depth);
 	}
 
-	if (cfg.input) {
-		const char* p;
-		size_t size;
+	if ((cfg.start || cfg.end) && !cfg.index) {
+		fprintf(stderr, "error: replay time range requires an index. Use the '-I' option to specify it.\n");
+		exit(1);
+	}
+
+	if (cfg.index) {
+		if (!cfg.input) {
+			fprintf(stderr, "error: indexed replay requires an input file. Use the '-i' option to specify it.\n");
+			exit(1);
+		}
+		if (strcmp(cfg.proto, "nasdaq-binaryfile-itch50")) {
+			fprintf(stderr, "error: indexed replay is only supported for nasdaq-binaryfile-itch50\n");
+			exit(1);
+		}
+		if (cfg.threads > 1) {
+			fprintf(stderr, "error: indexed replay is single-threaded\n");
+			exit(1);
+		}
+	} else if (cfg.restore && cfg.input) {
+		fprintf(stderr, "error: resuming replay from a snapshot requires an index. Use the '-I' option to specify it.\n");
+		exit(1);
+	}
+
+	if (cfg.paced && (!cfg.input || cfg.index)) {
+		fprintf(stderr, "error: paced replay requires an input file without an index\n");
+		exit(1);
+	}
+
+	if (cfg.paced && cfg.threads > 1) {
+		fprintf(stderr, "error: paced replay is single-threaded\n");
+		exit(1);
+	}
+
+	if (cfg.paced && cfg.speed < 0) {
+		fprintf(stderr, "error: %g: invalid replay speed\n", cfg.speed);
+		exit(1);
+	}
+
+	if (cfg.mirror_addr) {
+		helix_moldudp_sender_config_t tx_cfg = {};
+
+		if (!cfg.mirror_port) {
+			fprintf(stderr, "error: mirror port is not specified. Use the '-u' option to specify it.\n");
+			exit(1);
+		}
+		tx_cfg.multicast_addr = cfg.mirror_addr;
+		tx_cfg.port = cfg.mirror_port;
+		tx_cfg.loopback = 1;
+		mirror = helix_moldudp_sender_open(&tx_cfg);
+		if (!mirror) {
+			fprintf(stderr, "error: %s:%d: %s\n", cfg.mirror_addr, cfg.mirror_port, strerror(errno));
+			exit(1);
+		}
+		if (helix_session_set_mirror(session, mirror) < 0) {
+			fprintf(stderr, "error: unable to re-emit messages: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+
+	if (cfg.restore && helix_session_restore(session, cfg.restore) < 0) {
+		fprintf(stderr, "error: %s: %s\n", cfg.restore, strerror(errno));
+		exit(1);
+	}
+
+	if (cfg.input && cfg.index) {
+		helix_index_t index;
 
 		input_fd = open(cfg.input, O_RDONLY);
 		if (input_fd < 0) {
@@ -348,25 +752,65 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 
+		index = helix_index_open(cfg.index);
+		if (!index) {
+			fprintf(stderr, "error: %s: %s\n", cfg.index, strerror(errno));
+			exit(1);
+		}
+		if (helix_index_file_size(index) != (uint64_t)input_st.st_size) {
+			fprintf(stderr, "error: %s: index does not match input file %s\n", cfg.index, cfg.input);
+			exit(1);
+		}
+
 		fmt_ops->fmt_header();
 
-		p = reinterpret_cast<char*>(input_mmap);
-		size = input_st.st_size;
-		while (size > 0) {
-			size_t nr;
+		replay_index(session, index, reinterpret_cast<char*>(input_mmap), &cfg);
 
-			nr = helix_session_process_packet(session, p, size);
-			if (!nr)
-				break;
+		helix_index_close(index);
 
-			p += nr;
-			size -= nr;
+		if (munmap(input_mmap, input_st.st_size) < 0) {
+			fprintf(stderr, "error: %s: %s\n", cfg.input, strerror(errno));
+			exit(1);
 		}
+	} else if (cfg.input) {
+		fmt_ops->fmt_header();
 
-		if (munmap(input_mmap, input_st.st_size) < 0) {
+		if (cfg.paced) {
+			helix_replay_stats_t stats;
+
+			if (helix_session_replay_file_paced(session, cfg.input, cfg.speed, 0, &stats) < 0) {
+				fprintf(stderr, "error: %s: %s\n", cfg.input, strerror(errno));
+				exit(1);
+			}
+			fprintf(stderr, "late packets: %" PRIu64 ", lag p50: %" PRIu64 " ns, p99: %" PRIu64 " ns, max: %" PRIu64 " ns\n",
+				stats.late, stats.lag_p50, stats.lag_p99, stats.lag_max);
+		} else if (helix_session_replay_file(session, cfg.input) < 0) {
 			fprintf(stderr, "error: %s: %s\n", cfg.input, strerror(errno));
 			exit(1);
 		}
+	}
+
+	if (mirror && cfg.input) {
+		helix_session_set_mirror(session, NULL);
+		if (helix_moldudp_sender_end_session(mirror) < 0) {
+			fprintf(stderr, "error: %s:%d: %s\n", cfg.mirror_addr, cfg.mirror_port, strerror(errno));
+			exit(1);
+		}
+		fprintf(stderr, "mirrored packets: %" PRIu64 "\n", helix_moldudp_sender_packet_count(mirror));
+		helix_moldudp_sender_close(mirror);
+	}
+
+	if (cfg.input) {
+		if (cfg.save_snapshot) {
+			helix_snapshot_t snapshot;
+
+			snapshot = helix_session_snapshot(session);
+			if (!snapshot || helix_snapshot_write(snapshot, cfg.save_snapshot) < 0) {
+				fprintf(stderr, "error: %s: %s\n", cfg.save_snapshot, strerror(errno));
+				exit(1);
+			}
+			helix_snapshot_free(snapshot);
+		}
 	} else {
 		if (!cfg.multicast_addr) {
 			fprintf(stderr, "error: multicast address is not specified. Use the '-a' option to specify it.\n");
@@ -378,33 +822,51 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 
-		err = uv_udp_init(uv_default_loop(), &socket);
-		if (err) {
-			libuv_error("uv_udp_init", err);
+		line_addrs[nr_lines++] = cfg.multicast_addr;
+		if (cfg.multicast_addr_b) {
+			line_addrs[nr_lines++] = cfg.multicast_addr_b;
 		}
-		socket.data = session;
 
-		err = uv_ip4_addr("0.0.0.0", cfg.multicast_port, &addr);
-		if (err) {
-			libuv_error("uv_ip4_addr", err);
-		}
+		for (size_t i = 0; i < nr_lines; i++) {
+			helix_udp_config_t rx_cfg = {};
 
-		err = uv_udp_bind(&socket, (const struct sockaddr *)&addr, UV_UDP_REUSEADDR);
-		if (err) {
-			libuv_error("uv_udp_bind", err);
-		}
+			rx_cfg.multicast_addr = line_addrs[i];
+			rx_cfg.port = cfg.multicast_port;
+			rx_cfg.busy_poll_usec = cfg.busy_poll_usec;
+			rx_cfg.line = i ? HELIX_FEED_LINE_B : HELIX_FEED_LINE_A;
 
-		err = uv_udp_set_membership(&socket, cfg.multicast_addr, NULL, UV_JOIN_GROUP);
-		if (err) {
-			libuv_error("uv_udp_set_membership", err);
+			rx[i] = helix_udp_receiver_open(&rx_cfg);
+			if (!rx[i]) {
+				fprintf(stderr, "error: %s:%d: %s\n", line_addrs[i], cfg.multicast_port, strerror(errno));
+				exit(1);
+			}
 		}
 
-		err = uv_udp_recv_start(&socket, alloc_packet, recv_packet);
-		if (err) {
-			libuv_error("uv_udp_recv_start", err);
+		fmt_ops->fmt_header();
+
+		if (cfg.busy_poll_usec) {
+			for (;;) {
+				for (size_t i = 0; i < nr_lines; i++) {
+					if (helix_udp_receiver_process(rx[i], session, 0) < 0) {
+						fprintf(stderr, "error: %s\n", strerror(errno));
+						exit(1);
+					}
+				}
+			}
 		}
 
-		fmt_ops->fmt_header();
+		for (size_t i = 0; i < nr_lines; i++) {
+			err = uv_poll_init(uv_default_loop(), &rx_poll[i], helix_udp_receiver_fd(rx[i]));
+			if (err) {
+				libuv_error("uv_poll_init", err);
+			}
+			rx_poll[i].data = session;
+
+			err = uv_poll_start(&rx_poll[i], UV_READABLE, recv_packets);
+			if (err) {
+				libuv_error("uv_poll_start", err);
+			}
+		}
 
 		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
 	}
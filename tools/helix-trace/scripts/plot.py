@@ -4,15 +4,72 @@ import matplotlib.pyplot as plt
 import numpy as np
 import argparse
 
+# Binary trace format written by 'helix-trace -f binary'.
+BINARY_MAGIC = b'HLXTRACE'
+
+binary_header = np.dtype([
+    ('Magic',       'S8'),
+    ('Version',     '<u4'),
+    ('RecordSize',  '<u4'),
+    ('PriceScale',  '<u4'),
+    ('SymbolCount', '<u4'),
+    ('Reserved',    'V8'),
+])
+
+binary_symbol = np.dtype('S16')
+
+binary_record = np.dtype([
+    ('Timestamp', '<u8'),
+    ('BidPrice',  '<u4'),
+    ('BidSize',   '<u4'),
+    ('AskPrice',  '<u4'),
+    ('AskSize',   '<u4'),
+    ('LastPrice', '<u4'),
+    ('LastSize',  '<u4'),
+    ('Symbol',    '<u2'),
+    ('Type',      'S1'),
+    ('LastSign',  'S1'),
+    ('Reserved',  'V4'),
+])
+
+def read_binary(filename):
+    header = np.fromfile(filename, dtype=binary_header, count=1)[0]
+    if header['Version'] != 1 or header['RecordSize'] != binary_record.itemsize:
+        raise ValueError("%s: unsupported binary trace version" % filename)
+    count = int(header['SymbolCount'])
+    symbols = np.fromfile(filename, dtype=binary_symbol, count=count, offset=binary_header.itemsize)
+    records = np.memmap(filename, dtype=binary_record, mode='r',
+                        offset=binary_header.itemsize + count * binary_symbol.itemsize)
+    scale = float(header['PriceScale'])
+    quote = records['Type'] == b'Q'
+    trade = records['Type'] == b'T'
+    return {
+        'Symbol':    symbols[records['Symbol']],
+        'Timestamp': records['Timestamp'],
+        'BidPrice':  np.where(quote, records['BidPrice'] / scale, np.nan),
+        'BidSize':   np.where(quote, records['BidSize'], np.nan),
+        'AskPrice':  np.where(quote, records['AskPrice'] / scale, np.nan),
+        'AskSize':   np.where(quote, records['AskSize'], np.nan),
+        'LastPrice': np.where(trade, records['LastPrice'] / scale, np.nan),
+        'LastSign':  records['LastSign'],
+    }
+
+def read_trace(filename):
+    with open(filename, 'rb') as f:
+        magic = f.read(len(BINARY_MAGIC))
+    if magic == BINARY_MAGIC:
+        return read_binary(filename)
+    return np.genfromtxt(filename, delimiter=',', names=True)
+
 def fill_missing(data):
     mask = np.isnan(data)
     data[mask] = np.interp(np.flatnonzero(mask), np.flatnonzero(~mask), data[~mask])
 
 parser = argparse.ArgumentParser()
-parser.add_argument("input", help="input filename")
+parser.add_argument("input", help="input filename (CSV or binary trace)")
 args = parser.parse_args()
 
-data = np.genfromtxt(args.input, delimiter=',', names=True)
+data = read_trace(args.input)
 fig = plt.figure()
 ax = fig.add_subplot(111)
 